@@ -9,7 +9,7 @@
 #ifndef BoatState_h
 #define BoatState_h
 
-#include "types.h"
+#include "Types.h"
 
 class BoatState
 {
@@ -19,19 +19,19 @@ public:
         windSpeed = 0;
         windAngle = 0;
     }
-    float magneticVariation;
-    float windSpeed;
-    float windAngle;
+    DeciDegrees magneticVariation;
+    CentiKnots windSpeed;
+    DeciDegrees windAngle;
     Heading headingToMagnetic(Heading heading) {
         if (!heading.isMagnetic) {
-            heading.degrees -= this->magneticVariation;
+            heading.deciDegrees -= this->magneticVariation;
             heading.isMagnetic = true;
         }
         return heading;
     }
     Heading headingToTrue(Heading heading) {
         if (heading.isMagnetic) {
-            heading.degrees += this->magneticVariation;
+            heading.deciDegrees += this->magneticVariation;
             heading.isMagnetic = false;
         }
         return heading;
@@ -0,0 +1,240 @@
+#include "Capture.h"
+#include <cstring>
+#include "Arduino.h"
+
+static size_t writeVarint(uint32_t value, uint8_t *output) {
+    size_t length = 0;
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        output[length++] = byte | (value ? 0x80 : 0);
+    } while (value);
+    return length;
+}
+
+CaptureWriter::CaptureWriter(uint8_t *buffer, size_t size) {
+    _buffer = buffer;
+    _size = size;
+    reset();
+}
+
+void CaptureWriter::reset() {
+    memcpy(_buffer, CAPTURE_MAGIC, CAPTURE_MAGIC_LENGTH);
+    _start = 0;
+    _length = CAPTURE_MAGIC_LENGTH;
+    _lastTime = 0;
+    _droppedCount = 0;
+    _unreportedDropCount = 0;
+}
+
+size_t CaptureWriter::space() {
+    size_t needed = length() + CAPTURE_RECORD_HEADER_MAX_LENGTH;
+    return needed < _size ? _size - needed : 0;
+}
+
+bool CaptureWriter::hasRoom(size_t length) {
+    if (_length + length <= _size) {
+        return true;
+    }
+    if (this->length() + length > _size) {
+        return false;
+    }
+    memmove(_buffer, &_buffer[_start], _length - _start);
+    _length -= _start;
+    _start = 0;
+    return true;
+}
+
+bool CaptureWriter::write(uint32_t time, Port port, CaptureDirection direction, bool command, const uint8_t *data, uint16_t length) {
+    // Room for the loss record too, so the reader always knows where data went missing
+    size_t lossRecordLength = _unreportedDropCount ? CAPTURE_RECORD_HEADER_MAX_LENGTH + 4 : 0;
+    if (!hasRoom(lossRecordLength + CAPTURE_RECORD_HEADER_MAX_LENGTH + length)) {
+        _droppedCount++;
+        _unreportedDropCount++;
+        return false;
+    }
+    if (_unreportedDropCount) {
+        uint8_t count[4] = {(uint8_t)_unreportedDropCount, (uint8_t)(_unreportedDropCount >> 8), (uint8_t)(_unreportedDropCount >> 16), (uint8_t)(_unreportedDropCount >> 24)};
+        writeRecord(time, CAPTURE_CONTROL_PORT, count, 4);
+        _unreportedDropCount = 0;
+    }
+    return writeRecord(time, (port & 0x07) | (direction == CaptureDirectionWrite ? 0x08 : 0) | (command ? 0x10 : 0), data, length);
+}
+
+bool CaptureWriter::end(uint32_t time) {
+    if (!hasRoom(CAPTURE_RECORD_HEADER_MAX_LENGTH)) {
+        return false;
+    }
+    return writeRecord(time, CAPTURE_CONTROL_PORT, NULL, 0);
+}
+
+bool CaptureWriter::writeRecord(uint32_t time, uint8_t flags, const uint8_t *data, uint16_t length) {
+    _buffer[_length++] = flags;
+    _length += writeVarint(time - _lastTime, &_buffer[_length]);
+    _length += writeVarint(length, &_buffer[_length]);
+    if (length) {
+        memcpy(&_buffer[_length], data, length);
+        _length += length;
+    }
+    _lastTime = time;
+    return true;
+}
+
+void CaptureWriter::consume(size_t length) {
+    _start += length < this->length() ? length : this->length();
+    if (_start == _length) {
+        _start = 0;
+        _length = 0;
+    }
+}
+
+CaptureReader::CaptureReader(const uint8_t *capture, size_t length) {
+    _capture = capture;
+    _length = length;
+    _offset = CAPTURE_MAGIC_LENGTH;
+    _time = 0;
+    _isValid = length >= CAPTURE_MAGIC_LENGTH && memcmp(capture, CAPTURE_MAGIC, CAPTURE_MAGIC_LENGTH) == 0;
+}
+
+bool CaptureReader::readVarint(uint32_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (_offset >= _length) {
+            return false;
+        }
+        uint8_t byte = _capture[_offset++];
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CaptureReader::next(CaptureRecord *record) {
+    if (!_isValid || _offset >= _length) {
+        return false;
+    }
+    uint8_t flags = _capture[_offset++];
+    uint32_t timeDelta, length;
+    if (!readVarint(&timeDelta) || !readVarint(&length) || _offset + length > _length) {
+        return false;
+    }
+    _time += timeDelta;
+    record->lostCount = 0;
+    if ((flags & 0x07) == CAPTURE_CONTROL_PORT) {
+        if (length != 4) {
+            // End of capture
+            _offset = _length;
+            return false;
+        }
+        const uint8_t *count = &_capture[_offset];
+        _offset += length;
+        record->time = _time;
+        record->port = PortCount;
+        record->direction = CaptureDirectionRead;
+        record->command = false;
+        record->length = 0;
+        record->data = NULL;
+        record->lostCount = count[0] | ((uint32_t)count[1] << 8) | ((uint32_t)count[2] << 16) | ((uint32_t)count[3] << 24);
+        return true;
+    }
+    if ((flags & 0x07) >= PortCount) {
+        return false;
+    }
+    record->time = _time;
+    record->port = (Port)(flags & 0x07);
+    record->direction = (flags & 0x08) ? CaptureDirectionWrite : CaptureDirectionRead;
+    record->command = flags & 0x10;
+    record->length = length;
+    record->data = &_capture[_offset];
+    _offset += length;
+    return true;
+}
+
+CaptureSerialPort::CaptureSerialPort() {
+    attach(NULL, PortOutput, NULL);
+}
+
+CaptureSerialPort::CaptureSerialPort(SerialPort *serial, Port port, CaptureWriter *writer) {
+    attach(serial, port, writer);
+}
+
+void CaptureSerialPort::attach(SerialPort *serial, Port port, CaptureWriter *writer) {
+    _serial = serial;
+    _port = port;
+    _writer = writer;
+    _enabled = true;
+    _passThroughWrites = true;
+    _chunkLength = 0;
+    _chunkTime = 0;
+    _chunkDirection = CaptureDirectionRead;
+    _chunkCommand = false;
+}
+
+void CaptureSerialPort::setEnabled(bool enabled) {
+    flush();
+    _enabled = enabled;
+}
+
+void CaptureSerialPort::flush() {
+    if (_chunkLength) {
+        _writer->write(_chunkTime, _port, _chunkDirection, _chunkCommand, _chunk, _chunkLength);
+        _chunkLength = 0;
+    }
+}
+
+void CaptureSerialPort::append(CaptureDirection direction, uint16_t data) {
+    if (!_enabled) {
+        return;
+    }
+    bool command = data & 0x100;
+    if (_chunkLength && (direction != _chunkDirection || command || _chunkLength >= CAPTURE_CHUNK_SIZE)) {
+        flush();
+    }
+    if (!_chunkLength) {
+        _chunkTime = micros();
+        _chunkDirection = direction;
+        _chunkCommand = command;
+    }
+    _chunk[_chunkLength++] = data & 0xFF;
+}
+
+int CaptureSerialPort::available() {
+    // The router asks at the start of every pass, so whatever was collected in the last one is complete
+    if (_chunkLength && micros() != _chunkTime) {
+        flush();
+    }
+    return _serial->available();
+}
+
+int CaptureSerialPort::read() {
+    int c = _serial->read();
+    if (c >= 0) {
+        append(CaptureDirectionRead, c);
+    }
+    return c;
+}
+
+int CaptureSerialPort::availableForWrite() {
+    if (_passThroughWrites) {
+        return _serial->availableForWrite();
+    }
+    return _writer->space() > CAPTURE_CHUNK_SIZE ? _writer->space() - CAPTURE_CHUNK_SIZE : 0;
+}
+
+size_t CaptureSerialPort::write(const uint8_t *buffer, size_t size) {
+    size_t written = _passThroughWrites ? _serial->write(buffer, size) : size;
+    for (size_t i = 0; i < written; i++) {
+        append(CaptureDirectionWrite, buffer[i]);
+    }
+    return written;
+}
+
+size_t CaptureSerialPort::write9bit(uint32_t data) {
+    size_t written = _passThroughWrites ? _serial->write9bit(data) : 1;
+    if (written) {
+        append(CaptureDirectionWrite, data & 0x1FF);
+    }
+    return written;
+}
@@ -0,0 +1,129 @@
+#ifndef Capture_h
+#define Capture_h
+
+#include "inttypes.h"
+#include <stddef.h>
+#include "Types.h"
+#include "SerialPort.h"
+
+/*
+Capture format. A 4 byte header "HLM1" followed by records:
+
+    uint8_t  flags       bits 0-2 port, bit 3 set for bytes the router wrote, bit 4 set if the first byte had its 9th bit set
+    varint   timeDelta   micros since the previous record, LEB128
+    varint   length      LEB128
+    uint8_t  data[length]
+
+Only the first byte of a record can have its 9th bit set, a new record is started at every SeaTalk command byte.
+
+Records with port 7 are control records. With 4 bytes of data (little endian) they count records lost because the buffer
+was full since the previous one. With no data they mark the end of the capture.
+*/
+#define CAPTURE_MAGIC "HLM1"
+#define CAPTURE_MAGIC_LENGTH 4
+// Bytes read or written in a row are collected into records of at most this size
+#define CAPTURE_CHUNK_SIZE 32
+// Worst case size of a record header
+#define CAPTURE_RECORD_HEADER_MAX_LENGTH 11
+#define CAPTURE_CONTROL_PORT 7
+
+typedef enum {
+    CaptureDirectionRead = 0,
+    CaptureDirectionWrite
+} CaptureDirection;
+
+typedef struct {
+    uint32_t time;
+    Port port;
+    CaptureDirection direction;
+    //! The first byte had its 9th bit set
+    bool command;
+    uint16_t length;
+    const uint8_t *data;
+    //! Records lost just before this point, only set on loss records, which have no data
+    uint32_t lostCount;
+} CaptureRecord;
+
+//! Appends records to a buffer. Records that don't fit are dropped and counted, and a loss record is written once there's room again.
+class CaptureWriter
+{
+public:
+    CaptureWriter(uint8_t *buffer, size_t size);
+    //! Empties the buffer and writes the header
+    void reset();
+    bool write(uint32_t time, Port port, CaptureDirection direction, bool command, const uint8_t *data, uint16_t length);
+    //! Writes the end of capture record
+    bool end(uint32_t time);
+    //! Largest record that fits right now
+    size_t space();
+    const uint8_t *data() { return &_buffer[_start]; }
+    size_t length() { return _length - _start; }
+    //! Removes bytes from the start of the buffer, once they've been saved or sent somewhere. Cheap, the rest is only moved up when a record doesn't fit.
+    void consume(size_t length);
+    uint32_t droppedCount() { return _droppedCount; }
+private:
+    bool hasRoom(size_t length);
+    bool writeRecord(uint32_t time, uint8_t flags, const uint8_t *data, uint16_t length);
+    uint8_t *_buffer;
+    size_t _size;
+    size_t _start;
+    size_t _length;
+    uint32_t _lastTime;
+    uint32_t _droppedCount;
+    uint32_t _unreportedDropCount;
+};
+
+//! Reads records back out of a capture
+class CaptureReader
+{
+public:
+    CaptureReader(const uint8_t *capture, size_t length);
+    //! False if the capture doesn't start with the header
+    bool isValid() { return _isValid; }
+    //! Returns false at the end of the capture or if it's truncated. Loss records are returned with port set to PortCount.
+    bool next(CaptureRecord *record);
+private:
+    bool readVarint(uint32_t *value);
+    const uint8_t *_capture;
+    size_t _length;
+    size_t _offset;
+    uint32_t _time;
+    bool _isValid;
+};
+
+/*!
+SerialPort that passes everything through to another port and records it. Reads are collected into one record per pass
+of the router, which starts each pass by asking how much is available. Call flush() before saving the capture.
+*/
+class CaptureSerialPort : public SerialPort
+{
+public:
+    CaptureSerialPort();
+    CaptureSerialPort(SerialPort *serial, Port port, CaptureWriter *writer);
+    void attach(SerialPort *serial, Port port, CaptureWriter *writer);
+    int available();
+    int read();
+    int availableForWrite();
+    size_t write(const uint8_t *buffer, size_t size);
+    size_t write9bit(uint32_t data);
+    SerialErrorCounts errorCounts() { return _serial->errorCounts(); }
+    //! Writes out the record being collected
+    void flush();
+    void setEnabled(bool enabled);
+    //! When off, writes are only recorded. For the port the capture itself is streamed out of.
+    void setPassThroughWrites(bool passThroughWrites) { _passThroughWrites = passThroughWrites; }
+private:
+    void append(CaptureDirection direction, uint16_t data);
+    SerialPort *_serial;
+    Port _port;
+    CaptureWriter *_writer;
+    bool _enabled;
+    bool _passThroughWrites;
+    uint8_t _chunk[CAPTURE_CHUNK_SIZE];
+    uint16_t _chunkLength;
+    uint32_t _chunkTime;
+    CaptureDirection _chunkDirection;
+    bool _chunkCommand;
+};
+
+#endif
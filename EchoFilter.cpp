@@ -0,0 +1,61 @@
+#include "EchoFilter.h"
+#include <cstring>
+
+
+//! 16 bit FNV-1a hash of the datagram
+static uint16_t fingerprint(const uint8_t *message, int messageLength) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < messageLength; i++) {
+        hash ^= message[i];
+        hash *= 16777619u;
+    }
+    return (hash >> 16) ^ (hash & 0xFFFF);
+}
+
+EchoFilter::EchoFilter() {
+    reset();
+}
+
+void EchoFilter::reset() {
+    memset(_entries, 0, sizeof(_entries));
+    _nextEntry = 0;
+    _echoCount = 0;
+    memset(_originEchoCounts, 0, sizeof(_originEchoCounts));
+}
+
+void EchoFilter::transmitted(const uint8_t *message, int messageLength, Port origin, uint32_t now) {
+    // Overwrite the oldest entry. If the table wraps within the timeout we just miss an echo.
+    Entry *entry = &_entries[_nextEntry];
+    entry->fingerprint = fingerprint(message, messageLength);
+    entry->length = messageLength;
+    entry->origin = origin;
+    entry->timestamp = now;
+    _nextEntry = (_nextEntry + 1) % ECHO_FILTER_SIZE;
+}
+
+bool EchoFilter::isEcho(const uint8_t *message, int messageLength, uint32_t now, Port *origin) {
+    if (messageLength <= 0) {
+        return false;
+    }
+    uint16_t hash = fingerprint(message, messageLength);
+    for (int i = 0; i < ECHO_FILTER_SIZE; i++) {
+        Entry *entry = &_entries[i];
+        // Zero length marks an empty or already matched entry
+        if (entry->length != messageLength || entry->fingerprint != hash) {
+            continue;
+        }
+        if (now - entry->timestamp > ECHO_FILTER_TIMEOUT_MS) {
+            continue;
+        }
+        entry->length = 0;
+        if (origin) {
+            *origin = (Port)entry->origin;
+        }
+        _echoCount++;
+        if (entry->origin < PortCount) {
+            _originEchoCounts[entry->origin]++;
+        }
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,41 @@
+#ifndef EchoFilter_h
+#define EchoFilter_h
+
+#include "inttypes.h"
+#include <stddef.h>
+#include "Types.h"
+
+#define ECHO_FILTER_SIZE 8
+//! How long a transmitted datagram is remembered. 18 bytes at 4800 baud take ~41ms on the wire, the rest is slack for queueing and collisions.
+#define ECHO_FILTER_TIMEOUT_MS 250
+
+/*!
+Remembers fingerprints of recently transmitted SeaTalk datagrams so their echo on RX can be recognized.
+SeaTalk is a single wire bus, so everything we write comes right back to us.
+*/
+class EchoFilter
+{
+public:
+    EchoFilter();
+    //! Records a datagram that was just put on the bus, tagged with the port it originally came from
+    void transmitted(const uint8_t *message, int messageLength, Port origin, uint32_t now);
+    //! Returns true if the datagram is the echo of something we transmitted. Each transmission matches at most one echo.
+    bool isEcho(const uint8_t *message, int messageLength, uint32_t now, Port *origin = NULL);
+    int echoCount() { return _echoCount; }
+    //! Echoes of datagrams that originally came from the port
+    int echoCount(Port origin) { return _originEchoCounts[origin]; }
+    void reset();
+private:
+    typedef struct {
+        uint16_t fingerprint;
+        uint8_t length;
+        uint8_t origin;
+        uint32_t timestamp;
+    } Entry;
+    Entry _entries[ECHO_FILTER_SIZE];
+    int _nextEntry;
+    int _echoCount;
+    int _originEchoCounts[PortCount];
+};
+
+#endif
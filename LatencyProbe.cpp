@@ -0,0 +1,116 @@
+#include "LatencyProbe.h"
+#include <cstring>
+#include <stdio.h>
+#include "Arduino.h"
+
+#if defined(ARM_DWT_CYCCNT)
+
+void latencyClockBegin() {
+    ARM_DEMCR |= ARM_DEMCR_TRCENA;
+    ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+}
+
+uint32_t latencyTimestamp() {
+    return ARM_DWT_CYCCNT;
+}
+
+uint32_t latencyTicksPerMicro() {
+    return F_CPU / 1000000;
+}
+
+#else
+
+void latencyClockBegin() {
+}
+
+uint32_t latencyTimestamp() {
+    return micros();
+}
+
+uint32_t latencyTicksPerMicro() {
+    return 1;
+}
+
+#endif
+
+uint32_t latencyTicksToMicros(uint32_t ticks) {
+    return ticks / latencyTicksPerMicro();
+}
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+void LatencyHistogram::reset() {
+    memset(_buckets, 0, sizeof(_buckets));
+    _count = 0;
+    _max = 0;
+}
+
+void LatencyHistogram::record(uint32_t micros) {
+    int index = 0;
+    while (index < LATENCY_HISTOGRAM_BUCKETS - 1 && (micros >> (index + 1))) {
+        index++;
+    }
+    _buckets[index]++;
+    _count++;
+    if (micros > _max) {
+        _max = micros;
+    }
+}
+
+uint32_t LatencyHistogram::percentile(float fraction) {
+    uint32_t total = 0;
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS && _count; i++) {
+        total += _buckets[i];
+        if (total >= fraction * _count) {
+            uint32_t bound = (uint32_t)2 << i;
+            return bound < _max ? bound : _max;
+        }
+    }
+    return 0;
+}
+
+LatencyProbe::LatencyProbe(const char *name, Port destination, uint32_t type) {
+    _name = name;
+    _destination = destination;
+    _type = type;
+    _state = LatencyProbeIdle;
+    _startTimestamp = 0;
+    _bytesAhead = 0;
+}
+
+void LatencyProbe::started(uint32_t timestamp) {
+    if (_state != LatencyProbeWritten) {
+        _startTimestamp = timestamp;
+        _state = LatencyProbeStarted;
+    }
+}
+
+void LatencyProbe::written(uint32_t bytesAhead) {
+    if (_state == LatencyProbeStarted) {
+        _bytesAhead = bytesAhead;
+        _state = LatencyProbeWritten;
+    }
+}
+
+void LatencyProbe::describe(char *buffer, size_t size) {
+    size_t length = snprintf(buffer, size, "$PHLM,LATENCY,%s,%lu,%lu,%lu,%lu", _name, (unsigned long)_histogram.count(), (unsigned long)_histogram.percentile(0.5), (unsigned long)_histogram.percentile(0.99), (unsigned long)_histogram.max());
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS && length < size; i++) {
+        if (_histogram.bucket(i)) {
+            length += snprintf(&buffer[length], size - length, ",%d:%lu", i, (unsigned long)_histogram.bucket(i));
+        }
+    }
+}
+
+void LatencyProbe::drained(uint32_t bytes, uint32_t timestamp) {
+    if (_state != LatencyProbeWritten) {
+        return;
+    }
+    if (bytes < _bytesAhead) {
+        _bytesAhead -= bytes;
+        return;
+    }
+    _histogram.record(latencyTicksToMicros(timestamp - _startTimestamp));
+    _state = LatencyProbeIdle;
+}
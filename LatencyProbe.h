@@ -0,0 +1,73 @@
+#ifndef LatencyProbe_h
+#define LatencyProbe_h
+
+#include "inttypes.h"
+#include <stddef.h>
+#include "Types.h"
+
+// Bucket i counts latencies of [2^i, 2^(i+1)) micros, bucket 0 also counts anything under 1us. The last one is ~8s and up.
+#define LATENCY_HISTOGRAM_BUCKETS 24
+
+//! Starts the clock latencyTimestamp() reads. Call once from setup().
+void latencyClockBegin();
+//! High resolution timestamp for latency measurements. The CPU cycle counter on Teensy, the (simulated) micros() on the host.
+uint32_t latencyTimestamp();
+uint32_t latencyTicksPerMicro();
+uint32_t latencyTicksToMicros(uint32_t ticks);
+
+//! Latency histogram with fixed log2 buckets, so recording is cheap and it never needs tuning
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+    void record(uint32_t micros);
+    void reset();
+    uint32_t count() { return _count; }
+    uint32_t max() { return _max; }
+    uint32_t bucket(int index) { return _buckets[index]; }
+    //! Smallest bucket boundary at least the given fraction of the samples are under, or the max if that's lower, in micros. 0 if there are none.
+    uint32_t percentile(float fraction);
+private:
+    uint32_t _buckets[LATENCY_HISTOGRAM_BUCKETS];
+    uint32_t _count;
+    uint32_t _max;
+};
+
+/*!
+Measures one route end to end, from the first byte of a message arriving to the last byte of what it was translated into
+leaving the destination port. The router can't see the wire, so it counts bytes draining out of the destination's TX buffer
+until everything that was ahead of the message, and the message itself, is gone. One message is measured at a time.
+*/
+class LatencyProbe
+{
+public:
+    LatencyProbe(const char *name, Port destination, uint32_t type);
+    const char *name() { return _name; }
+    Port destination() { return _destination; }
+    //! Type of the outgoing message, as in MessageQueue: SeaTalk command byte or nmeaMessageType()
+    uint32_t type() { return _type; }
+    //! A message that will be translated into one of ours arrived. A newer one replaces it until it has been written.
+    void started(uint32_t timestamp);
+    //! Our message was handed to the port, with bytesAhead bytes, its own included, in the TX buffer
+    void written(uint32_t bytesAhead);
+    //! Bytes that left the destination's TX buffer since the last call
+    void drained(uint32_t bytes, uint32_t timestamp);
+    LatencyHistogram *histogram() { return &_histogram; }
+    //! $PHLM,LATENCY sentence without the checksum: name, count, p50, p99 and max in micros, then bucket:count for every bucket in use
+    void describe(char *buffer, size_t size);
+private:
+    typedef enum {
+        LatencyProbeIdle = 0,
+        LatencyProbeStarted,
+        LatencyProbeWritten
+    } State;
+    const char *_name;
+    Port _destination;
+    uint32_t _type;
+    State _state;
+    uint32_t _startTimestamp;
+    uint32_t _bytesAhead;
+    LatencyHistogram _histogram;
+};
+
+#endif
@@ -0,0 +1,13 @@
+#include "MemoryBudget.h"
+
+static_assert(MEMORY_BUDGET_TOTAL_BYTES <= MEMORY_BUDGET_CEILING_BYTES, "Static buffers leave less than MEMORY_BUDGET_RESERVE_BYTES for the stack and heap, see MemoryBudget.h");
+
+#define MEMORY_BUDGET_ENTRY(name, bytes) {name, (uint32_t)(bytes), false},
+#define MEMORY_BUDGET_ROUTER_PART(name, bytes) {name, (uint32_t)(bytes), true},
+
+const MemoryBudgetEntry memoryBudgetEntries[] = {
+    MEMORY_BUDGET_ENTRIES(MEMORY_BUDGET_ENTRY)
+    MEMORY_BUDGET_ROUTER_PARTS(MEMORY_BUDGET_ROUTER_PART)
+};
+
+const int memoryBudgetEntryCount = sizeof(memoryBudgetEntries) / sizeof(memoryBudgetEntries[0]);
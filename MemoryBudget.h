@@ -0,0 +1,74 @@
+#ifndef MemoryBudget_h
+#define MemoryBudget_h
+
+#include "inttypes.h"
+#include "Router.h"
+#include "Trace.h"
+#include "SerialBuffers.h"
+
+/*
+Every statically allocated buffer and what it costs. MemoryBudget.cpp checks the total at compile time, so a buffer
+that grows past MEMORY_BUDGET_CEILING_BYTES breaks the build instead of running the stack into the heap at sea. Anything
+that adds a static buffer or a Router member adds a line to MEMORY_BUDGET_ENTRIES or MEMORY_BUDGET_ROUTER_PARTS.
+
+Sizes come from sizeof, so on the host they're a little bigger where there are pointers. make simulate prints them.
+*/
+
+// The MK20DX256's RAM. The host trace build raises this for its much bigger trace ring.
+#ifndef MEMORY_BUDGET_RAM_BYTES
+#define MEMORY_BUDGET_RAM_BYTES (64 * 1024)
+#endif
+// Kept free for the stack, the heap and the Teensy core's other statics, like its USB packet buffers
+#ifndef MEMORY_BUDGET_RESERVE_BYTES
+#define MEMORY_BUDGET_RESERVE_BYTES (24 * 1024)
+#endif
+#define MEMORY_BUDGET_CEILING_BYTES (MEMORY_BUDGET_RAM_BYTES - MEMORY_BUDGET_RESERVE_BYTES)
+
+#ifdef HELM_TRACE
+#define MEMORY_BUDGET_TRACE_BYTES (TRACE_RING_SIZE * sizeof(TraceEntry))
+#else
+#define MEMORY_BUDGET_TRACE_BYTES 0
+#endif
+
+// X(name, bytes) for each static, these add up to the total
+#define MEMORY_BUDGET_ENTRIES(X) \
+    X("Router", sizeof(Router)) \
+    X("Port adapters", PortCount * 2 * sizeof(void *)) \
+    X("AltSoftSerial RX", ALTSS_RX_BUFFER_SIZE) \
+    X("AltSoftSerial TX", ALTSS_TX_BUFFER_SIZE) \
+    X("Serial1 RX+TX", TEENSY_SERIAL1_RX_BUFFER_SIZE + TEENSY_SERIAL1_TX_BUFFER_SIZE) \
+    X("Serial2 RX+TX", TEENSY_SERIAL2_RX_BUFFER_SIZE + TEENSY_SERIAL2_TX_BUFFER_SIZE) \
+    X("Serial3 RX+TX", TEENSY_SERIAL3_RX_BUFFER_SIZE + TEENSY_SERIAL3_TX_BUFFER_SIZE) \
+    X("Trace ring", MEMORY_BUDGET_TRACE_BYTES)
+
+// X(name, bytes) for the bigger parts of the Router, which are already counted in its entry
+#define MEMORY_BUDGET_ROUTER_PARTS(X) \
+    X("GPS parser", sizeof(SizedNMEAParser<ROUTER_GPS_MESSAGE_CAPACITY>)) \
+    X("AIS parser", sizeof(SizedNMEAParser<ROUTER_AIS_MESSAGE_CAPACITY>)) \
+    X("Input parser", sizeof(SizedNMEAParser<ROUTER_INPUT_MESSAGE_CAPACITY>)) \
+    X("NMEA parser", sizeof(SizedNMEAParser<ROUTER_NMEA_MESSAGE_CAPACITY>)) \
+    X("SeaTalk parser", sizeof(SeaTalkParser)) \
+    X("SeaTalk echo filter", sizeof(EchoFilter)) \
+    X("Output TX queue", sizeof(MessageQueue<NMEA_MESSAGE_MAX_LENGTH, ROUTER_OUTPUT_TX_QUEUE_COUNT>)) \
+    X("NMEAHS TX queue", sizeof(MessageQueue<NMEA_MESSAGE_MAX_LENGTH, ROUTER_NMEA_HIGH_SPEED_TX_QUEUE_COUNT>)) \
+    X("NMEA TX queue", sizeof(MessageQueue<NMEA_MESSAGE_MAX_LENGTH, ROUTER_NMEA_TX_QUEUE_COUNT>)) \
+    X("SeaTalk TX queue", sizeof(MessageQueue<SEATALK_MESSAGE_MAX_LENGTH, ROUTER_SEATALK_TX_QUEUE_COUNT>)) \
+    X("Routing table", sizeof(RoutingTable)) \
+    X("Capture buffer", ROUTER_CAPTURE_BUFFER_SIZE) \
+    X("Capture ports", PortCount * sizeof(CaptureSerialPort)) \
+    X("Latency probes", RouterLatencyRouteCount * sizeof(LatencyProbe))
+
+#define MEMORY_BUDGET_SUM(name, bytes) + (bytes)
+#define MEMORY_BUDGET_TOTAL_BYTES (0 MEMORY_BUDGET_ENTRIES(MEMORY_BUDGET_SUM))
+
+typedef struct {
+    const char *name;
+    uint32_t bytes;
+    //! Already counted in the Router's entry
+    bool isRouterPart;
+} MemoryBudgetEntry;
+
+extern const MemoryBudgetEntry memoryBudgetEntries[];
+extern const int memoryBudgetEntryCount;
+
+#endif
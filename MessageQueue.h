@@ -0,0 +1,157 @@
+#ifndef MessageQueue_h
+#define MessageQueue_h
+
+#include "inttypes.h"
+#include <stddef.h>
+#include <cstring>
+
+//! What a MessageQueue does with a new message when it's full
+typedef enum {
+    //! Keep what's queued, the new message is dropped
+    MessageQueueDropNewest = 0,
+    //! Make room by dropping the oldest message that hasn't started transmitting
+    MessageQueueDropOldest,
+    //! Overwrite a queued message of the same type in place, otherwise drop the new message. Good for periodic data where only the latest value matters.
+    //! Types set with setNeverReplacedType() are dropped like MessageQueueDropNewest instead.
+    MessageQueueReplaceSameType
+} MessageQueueDropPolicy;
+
+// No message type is this, command bytes and NMEA_TYPE() both fit in 24 bits
+#define MESSAGE_QUEUE_NO_TYPE 0xFFFFFFFF
+
+/*!
+Fixed size FIFO of whole messages waiting to be transmitted. A message is either queued completely or not at all, so a
+slow port never blocks the router. Messages can be built in place with reserve() and commit() so nothing has to be
+copied on the way to the wire, and can be transmitted a few bytes at a time with consumeFront(). There's always one
+more slot than the queue holds for reserve() to hand out, so the drop policy only acts once a message is committed.
+*/
+template <int SlotSize, int SlotCount>
+class MessageQueue
+{
+public:
+    MessageQueue(MessageQueueDropPolicy dropPolicy = MessageQueueDropNewest) {
+        _head = 0;
+        _count = 0;
+        _frontOffset = 0;
+        _dropCount = 0;
+        _dropPolicy = dropPolicy;
+        _neverReplacedType = MESSAGE_QUEUE_NO_TYPE;
+    }
+    //! Returns the slot the next message can be written into, even when the queue is full. Nothing changes until commit() is called, so a message that's never committed costs nothing.
+    uint8_t *reserve() {
+        return _slots[(_head + _count) % RingSize].data;
+    }
+    //! Queues the message written into the slot returned by reserve(), applying the drop policy if the queue is full. Returns false if it was dropped.
+    bool commit(int length, uint8_t origin, uint32_t type = 0) {
+        Slot *slot = &_slots[(_head + _count) % RingSize];
+        if (_count >= SlotCount) {
+            _dropCount++;
+            if (_dropPolicy == MessageQueueReplaceSameType && type != _neverReplacedType) {
+                Slot *queued = findType(type);
+                if (!queued) {
+                    return false;
+                }
+                memcpy(queued->data, slot->data, length);
+                queued->length = length;
+                queued->origin = origin;
+                return true;
+            }
+            // Dropping the oldest leaves the reserved slot where it is
+            if (_dropPolicy != MessageQueueDropOldest || !dropOldest()) {
+                return false;
+            }
+        }
+        slot->length = length;
+        slot->origin = origin;
+        slot->type = type;
+        _count++;
+        return true;
+    }
+    //! Copies a message into the queue. Returns false if it was dropped.
+    bool push(const uint8_t *message, int length, uint8_t origin, uint32_t type = 0) {
+        if (length > SlotSize) {
+            _dropCount++;
+            return false;
+        }
+        memcpy(reserve(), message, length);
+        return commit(length, origin, type);
+    }
+    bool isEmpty() { return _count == 0; }
+    int count() { return _count; }
+    int freeCount() { return SlotCount - _count; }
+    //! The oldest message in the queue
+    uint8_t *front() { return _slots[_head].data; }
+    int frontLength() { return _slots[_head].length; }
+    //! The port the oldest message originally came from
+    uint8_t frontOrigin() { return _slots[_head].origin; }
+    uint32_t frontType() { return _slots[_head].type; }
+    //! Bytes of the oldest message already handed to the port
+    int frontOffset() { return _frontOffset; }
+    //! Marks bytes of the oldest message as transmitted, and pops it once they all are
+    void consumeFront(int length) {
+        _frontOffset += length;
+        if (_frontOffset >= frontLength()) {
+            pop();
+        }
+    }
+    void pop() {
+        if (_count) {
+            _head = (_head + 1) % RingSize;
+            _count--;
+        }
+        _frontOffset = 0;
+    }
+    //! Messages dropped or replaced because the queue was full
+    uint32_t dropCount() { return _dropCount; }
+    MessageQueueDropPolicy dropPolicy() { return _dropPolicy; }
+    void setDropPolicy(MessageQueueDropPolicy dropPolicy) { _dropPolicy = dropPolicy; }
+    //! Messages of this type are never replaced under MessageQueueReplaceSameType, for messages where every one counts, like keystrokes
+    void setNeverReplacedType(uint32_t type) { _neverReplacedType = type; }
+private:
+    // One more than the queue holds, the slot after the last message is always free for reserve()
+    static const int RingSize = SlotCount + 1;
+
+    typedef struct {
+        uint8_t length;
+        uint8_t origin;
+        uint32_t type;
+        uint8_t data[SlotSize];
+    } Slot;
+
+    bool dropOldest() {
+        if (_count < 2 && _frontOffset) {
+            return false;
+        }
+        if (_frontOffset) {
+            // The front is half way out the door, drop the one behind it instead
+            Slot *second = &_slots[(_head + 1) % RingSize];
+            memcpy(second, &_slots[_head], sizeof(Slot));
+            _head = (_head + 1) % RingSize;
+            _count--;
+        } else {
+            pop();
+        }
+        return true;
+    }
+
+    Slot *findType(uint32_t type) {
+        // Never the front if it has started transmitting
+        for (int i = _frontOffset ? 1 : 0; i < _count; i++) {
+            Slot *slot = &_slots[(_head + i) % RingSize];
+            if (slot->type == type) {
+                return slot;
+            }
+        }
+        return NULL;
+    }
+
+    Slot _slots[RingSize];
+    int _head;
+    int _count;
+    int _frontOffset;
+    uint32_t _dropCount;
+    MessageQueueDropPolicy _dropPolicy;
+    uint32_t _neverReplacedType;
+};
+
+#endif
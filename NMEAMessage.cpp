@@ -1,4 +1,5 @@
 #include "NMEAMessage.h"
+#include "Trace.h"
 #include <cstring>
 #include "NMEAShared.h"
 #include <stdio.h>
@@ -10,9 +11,11 @@ void closeMessage(char *message) {
     size_t messageLength = strlen(message);
     int checksum = calculateChecksum(&(message[1]), messageLength - 1);
     message[messageLength++] = '*';
-    sprintf(&(message[messageLength]), "%02X", checksum);
-    messageLength += 2;
-    sprintf(&(message[messageLength]), "\r\n");
+    uint8_t checksumByte = checksum;
+    messageLength += binaryToAsciiHex(&checksumByte, 1, &(message[messageLength]));
+    message[messageLength++] = '\r';
+    message[messageLength++] = '\n';
+    message[messageLength] = 0;
 }
 
 
@@ -26,137 +29,152 @@ const char *BaseNMEAMessage::message() {
 }
 
 
-NMEAMessageWind::NMEAMessageWind(float windAngle, float windSpeed) : BaseNMEAMessage() {
-    sprintf(_message, "$WIMWV,%.1f,R,%.1f,N,A", windAngle, windSpeed);
+NMEAMessageWind::NMEAMessageWind(DeciDegrees windAngle, CentiKnots windSpeed) : BaseNMEAMessage() {
+    TRACE_SCOPE(TraceEventNMEAEncode, 0);
+    char angle[12];
+    char speed[12];
+    fixedToString(windAngle, 1, angle);
+    fixedToString(divideRounded(windSpeed, 10), 1, speed);
+    sprintf(_message, "$WIMWV,%s,R,%s,N,A", angle, speed);
     closeMessage(_message);
 }
 
 
-NMEAMessageGLL::NMEAMessageGLL(const char *message) : BaseNMEAMessage() {
-    char *fragments[10];
+NMEAMessageGLL::NMEAMessageGLL(const char *message) {
+    TRACE_SCOPE(TraceEventNMEADecode, 0);
+    NMEAFragment fragments[10];
     int fragmentCount = 0;
-    splitMessageIntoFragments(message, strlen(message), fragments, &fragmentCount);
+    splitMessageIntoFragments(message, strlen(message), fragments, sizeof(fragments) / sizeof(fragments[0]), &fragmentCount);
 
-    _latitude = degreesFromCoordinateString(fragments[1], fragments[2][0]);
-    _longitude = degreesFromCoordinateString(fragments[3], fragments[4][0]);
-    _time = timeFromString(fragments[5]);
-
-    for (int i = 0; i < fragmentCount; i++) {
-      free(fragments[i]);
-    }
+    _latitude = coordinateFromString(fragments[1].start, fragments[2].start[0]);
+    _longitude = coordinateFromString(fragments[3].start, fragments[4].start[0]);
+    _time = timeFromString(fragments[5].start);
 }
 
 
-NMEAMessageRMB::NMEAMessageRMB(const char *message) : BaseNMEAMessage() {
-    char *fragments[15];
+NMEAMessageRMB::NMEAMessageRMB(const char *message) {
+    TRACE_SCOPE(TraceEventNMEADecode, 0);
+    NMEAFragment fragments[15];
     int fragmentCount = 0;
-    splitMessageIntoFragments(message, strlen(message), fragments, &fragmentCount);
-
-    _status = statusFromFragment(fragments[1]);
-    _xte = atof(fragments[2]);
-    _directionToSteer = lateralityFromFragment(fragments[3]);
-    COPY_STRING(_toWaypointID, fragments[4]);
-    COPY_STRING(_fromWaypointID, fragments[5]);
-    _destinationLatitude = degreesFromCoordinateString(fragments[6], fragments[7][0]);
-    _destinationLongitude = degreesFromCoordinateString(fragments[8], fragments[9][0]);
-    _rangeToDestiation = atof(fragments[10]);
-    _bearingToDestination = headingFromFragments(fragments[11], "T");
-    _destinationClosingVelocity = atof(fragments[12]);
-    _isArrived = fragments[13][0] == 'A' ? true : false;
-
-    for (int i = 0; i < fragmentCount; i++) {
-        free(fragments[i]);
-    }
+    splitMessageIntoFragments(message, strlen(message), fragments, sizeof(fragments) / sizeof(fragments[0]), &fragmentCount);
+
+    _status = statusFromFragment(fragments[1].start);
+    _xte = fixedFromString(fragments[2].start, 2);
+    _directionToSteer = lateralityFromFragment(fragments[3].start);
+    _toWaypointID = fragments[4];
+    _fromWaypointID = fragments[5];
+    _destinationLatitude = coordinateFromString(fragments[6].start, fragments[7].start[0]);
+    _destinationLongitude = coordinateFromString(fragments[8].start, fragments[9].start[0]);
+    _rangeToDestiation = fixedFromString(fragments[10].start, 2);
+    _bearingToDestination = headingFromFragments(fragments[11].start, "T");
+    _destinationClosingVelocity = fixedFromString(fragments[12].start, 2);
+    _isArrived = fragments[13].start[0] == 'A' ? true : false;
 }
 
 
-NMEAMessageRMC::NMEAMessageRMC(const char *message) : BaseNMEAMessage() {
-    char *fragments[12];
+NMEAMessageRMC::NMEAMessageRMC(const char *message) {
+    TRACE_SCOPE(TraceEventNMEADecode, 0);
+    NMEAFragment fragments[12];
     int fragmentCount = 0;
-    splitMessageIntoFragments(message, strlen(message), fragments, &fragmentCount);
-
-    _time = timeFromString(fragments[1]);
-    _status = statusFromFragment(fragments[2]);
-    _latitude = degreesFromCoordinateString(fragments[3], fragments[4][0]);
-    _longitude = degreesFromCoordinateString(fragments[5], fragments[6][0]);
-    _speedOverGround = atof(fragments[7]);
-    _trackMadeGood = headingFromFragments(fragments[8], "T");
-    sscanf(fragments[9], "%2d%2d%2d", &(_date.day), &(_date.month), &(_date.year));
-    _magneticVariation = atof(fragments[10]);
-    if (fragments[11][0] == 'W') {
-        _magneticVariation = _magneticVariation * -1;
-    }
-
-    for (int i = 0; i < fragmentCount; i++) {
-      free(fragments[i]);
+    splitMessageIntoFragments(message, strlen(message), fragments, sizeof(fragments) / sizeof(fragments[0]), &fragmentCount);
+
+    _time = timeFromString(fragments[1].start);
+    _status = statusFromFragment(fragments[2].start);
+    _latitude = coordinateFromString(fragments[3].start, fragments[4].start[0]);
+    _longitude = coordinateFromString(fragments[5].start, fragments[6].start[0]);
+    _speedOverGround = fixedFromString(fragments[7].start, 2);
+    _trackMadeGood = headingFromFragments(fragments[8].start, "T");
+    _date = dateFromString(fragments[9].start);
+    _magneticVariation = fixedFromString(fragments[10].start, 1);
+    if (fragments[11].start[0] == 'W') {
+        _magneticVariation = -_magneticVariation;
     }
 }
 
 
-NMEAMessageDBT::NMEAMessageDBT(float depth) : BaseNMEAMessage() {
-    sprintf(_message, "$STDBT,%.1f,f,,M,,F", depth);
+NMEAMessageDBT::NMEAMessageDBT(DeciFeet depth) : BaseNMEAMessage() {
+    TRACE_SCOPE(TraceEventNMEAEncode, 0);
+    char feet[12];
+    fixedToString(depth, 1, feet);
+    sprintf(_message, "$STDBT,%s,f,,M,,F", feet);
     closeMessage(_message);
 }
 
 
-NMEAMessageVHW::NMEAMessageVHW(float knots) : BaseNMEAMessage() {
-    sprintf(_message, "$STVHW,,T,,M,%.1f,N,,K", knots);
+NMEAMessageVHW::NMEAMessageVHW(CentiKnots speed) : BaseNMEAMessage() {
+    TRACE_SCOPE(TraceEventNMEAEncode, 0);
+    char knots[12];
+    fixedToString(divideRounded(speed, 10), 1, knots);
+    sprintf(_message, "$STVHW,,T,,M,%s,N,,K", knots);
     closeMessage(_message);
 }
 
 
-NMEAMessageHDM::NMEAMessageHDM(float heading) : BaseNMEAMessage() {
-    sprintf(_message, "$STHDM,%.1f,M", heading);
+NMEAMessageHDM::NMEAMessageHDM(DeciDegrees heading) : BaseNMEAMessage() {
+    TRACE_SCOPE(TraceEventNMEAEncode, 0);
+    char degrees[12];
+    fixedToString(heading, 1, degrees);
+    sprintf(_message, "$STHDM,%s,M", degrees);
     closeMessage(_message);
 }
 
 
-NMEAMessageAPB::NMEAMessageAPB(const char *message) : BaseNMEAMessage() {
-    char *fragments[15];
+NMEAMessageAPB::NMEAMessageAPB(const char *message) {
+    TRACE_SCOPE(TraceEventNMEADecode, 0);
+    NMEAFragment fragments[15];
     int fragmentCount = 0;
-    splitMessageIntoFragments(message, strlen(message), fragments, &fragmentCount);
+    splitMessageIntoFragments(message, strlen(message), fragments, sizeof(fragments) / sizeof(fragments[0]), &fragmentCount);
 
-    _isUnreliableFix = fragments[1][0] == 'V' ? true : false;
-    _isCycleLockWarning = fragments[2][0] == 'V' ? true : false;
-    _xte = atof(fragments[3]);
-    _directionToSteer = lateralityFromFragment(fragments[4]);
+    _isUnreliableFix = fragments[1].start[0] == 'V' ? true : false;
+    _isCycleLockWarning = fragments[2].start[0] == 'V' ? true : false;
+    _xte = fixedFromString(fragments[3].start, 2);
+    _directionToSteer = lateralityFromFragment(fragments[4].start);
     // TODO: Do XTE units ever change? If so, implement units for XTE
-    _isArrived = fragments[6][0] == 'A' ? true : false;
-    _isPerpendicularPassed = fragments[7][0] == 'A' ? true : false;
-    _bearingOriginToDestination = headingFromFragments(fragments[8], fragments[9]);
-    COPY_STRING(_destinationWaypointID, fragments[10]);
-    _bearingPresentToDestination = headingFromFragments(fragments[11], fragments[12]);
-    _headingToSteerToWaypoint = headingFromFragments(fragments[13], fragments[14]);
-
-    for (int i = 0; i < fragmentCount; i++) {
-        free(fragments[i]);
-    }
+    _isArrived = fragments[6].start[0] == 'A' ? true : false;
+    _isPerpendicularPassed = fragments[7].start[0] == 'A' ? true : false;
+    _bearingOriginToDestination = headingFromFragments(fragments[8].start, fragments[9].start);
+    _destinationWaypointID = fragments[10];
+    _bearingPresentToDestination = headingFromFragments(fragments[11].start, fragments[12].start);
+    _headingToSteerToWaypoint = headingFromFragments(fragments[13].start, fragments[14].start);
 }
 
 
 NMEAMessageSEA::NMEAMessageSEA(const char *message) : BaseNMEAMessage() {
-    char *fragments[3];
-    int fragmentCount = 0;
-    splitMessageIntoFragments(message, strlen(message), fragments, &fragmentCount);
+    TRACE_SCOPE(TraceEventNMEADecode, 0);
+    _seaTalkMessageLength = decodeSeaTalkMessage(message, _seaTalkMessage, sizeof(_seaTalkMessage));
+}
+
 
-    // Convert ascii hex to binary
-    _seaTalkMessageLength = strlen(fragments[1]) / 2;
-    for (int i = 0; i < _seaTalkMessageLength; i++) {
-        _seaTalkMessage[i] = (asciiHexToBinary(fragments[1][2 * i]) << 4) + asciiHexToBinary(fragments[1][2 * i + 1]);
+int NMEAMessageSEA::decodeSeaTalkMessage(const char *message, uint8_t *seaTalkMessage, int maxLength) {
+    TRACE_SCOPE(TraceEventNMEADecode, 0);
+    // The payload is the only field, between the first ',' and the '*'
+    const char *payload = strchr(message, ',');
+    if (!payload) {
+        return 0;
+    }
+    payload++;
+    const char *end = payload;
+    while (*end && *end != '*' && *end != '\r') {
+        end++;
+    }
+    int hexLength = end - payload;
+    if (hexLength % 2 || hexLength / 2 > maxLength) {
+        return 0;
     }
+    // Any non hex digit stops the decode short
+    int length = asciiHexToBinary(payload, hexLength, seaTalkMessage);
+    return length == hexLength / 2 ? length : 0;
 }
 
 
 NMEAMessageSEA::NMEAMessageSEA(const uint8_t *seaTalkMessage, uint8_t seaTalkMessageLength) {
+    TRACE_SCOPE(TraceEventNMEAEncode, 0);
     memcpy(&_seaTalkMessage, seaTalkMessage, seaTalkMessageLength);
     _seaTalkMessageLength = seaTalkMessageLength;
-    
-    sprintf(_message, "$STSEA,");
-    uint8_t headerLength = 7;
 
+    memcpy(_message, "$STSEA,", 7);
+    uint8_t headerLength = 7;
     // Convert binary to ascii hex
-    for (int i = 0; i < seaTalkMessageLength; i++) {
-        sprintf(&(_message[headerLength + 2 * i]), "%02X", seaTalkMessage[i]);
-    }
+    binaryToAsciiHex(seaTalkMessage, seaTalkMessageLength, &(_message[headerLength]));
     closeMessage(_message);
 }
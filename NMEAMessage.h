@@ -1,12 +1,12 @@
 #ifndef NMEAMessage_h
 #define NMEAMessage_h
 
-#include "types.h"
+#include "Types.h"
 #include "NMEAShared.h"
 #include "inttypes.h"
 
-#define COPY_STRING(instance_var, string) do { strncpy(instance_var, string, min(sizeof(instance_var) - 1, strlen(string)) + 1); } while (0);
-
+//! Appends the checksum and line ending to a NULL terminated sentence
+void closeMessage(char *message);
 
 class BaseNMEAMessage
 {
@@ -14,80 +14,86 @@ public:
     BaseNMEAMessage();
     const char *message();
     // TODO: This should be private but I forget how friend classes work in C++
-    char _message[100];
+    char _message[NMEA_MESSAGE_MAX_LENGTH];
 };
 
 class NMEAMessageWind : public BaseNMEAMessage
 {
 public:
-    NMEAMessageWind(float windAngle, float windSpeed);
+    NMEAMessageWind(DeciDegrees windAngle, CentiKnots windSpeed);
 };
 
-class NMEAMessageGLL : public BaseNMEAMessage
+/*
+The parsed sentences below are only the decoded values, not BaseNMEAMessage's buffer. String fields are fragments of the
+sentence they were parsed from, so that has to outlive them. They're built on the stack for every sentence the router
+translates, so keep them small.
+*/
+
+class NMEAMessageGLL
 {
 public:
     NMEAMessageGLL(const char *message);
-    double latitude() { return _latitude; }
-    double longitude() { return _longitude; }
+    Coordinate latitude() { return _latitude; }
+    Coordinate longitude() { return _longitude; }
     Time time() { return _time; }
 private:
-    double _latitude;
-    double _longitude;
+    Coordinate _latitude;
+    Coordinate _longitude;
     Time _time;
 };
 
 
-class NMEAMessageRMB : public BaseNMEAMessage
+class NMEAMessageRMB
 {
 public:
     NMEAMessageRMB(const char *message);
     Status status() { return _status; }
-    float xte() { return _xte; }
+    CentiNauticalMiles xte() { return _xte; }
     Laterality directionToSteer() { return _directionToSteer; }
-    char *toWaypointID() { return _toWaypointID; }
-    char *fromWaypointID() { return _fromWaypointID; }
-    double destinationLatitude() { return _destinationLatitude; }
-    double destinationLongitude() { return _destinationLongitude; }
-    float rangeToDestiation() { return _rangeToDestiation; }
+    NMEAFragment toWaypointID() { return _toWaypointID; }
+    NMEAFragment fromWaypointID() { return _fromWaypointID; }
+    Coordinate destinationLatitude() { return _destinationLatitude; }
+    Coordinate destinationLongitude() { return _destinationLongitude; }
+    CentiNauticalMiles rangeToDestiation() { return _rangeToDestiation; }
     Heading bearingToDestination() { return _bearingToDestination; }
-    float destinationClosingVelocity() { return _destinationClosingVelocity; }
+    CentiKnots destinationClosingVelocity() { return _destinationClosingVelocity; }
     bool isArrived() { return _isArrived; }
 private:
     Status _status;
-    float _xte;
+    CentiNauticalMiles _xte;
     Laterality _directionToSteer;
-    char _toWaypointID[20];
-    char _fromWaypointID[20];
-    double _destinationLatitude;
-    double _destinationLongitude;
-    float _rangeToDestiation;
+    NMEAFragment _toWaypointID;
+    NMEAFragment _fromWaypointID;
+    Coordinate _destinationLatitude;
+    Coordinate _destinationLongitude;
+    CentiNauticalMiles _rangeToDestiation;
     Heading _bearingToDestination;
-    float _destinationClosingVelocity;
+    CentiKnots _destinationClosingVelocity;
     bool _isArrived;
 };
 
-class NMEAMessageRMC : public BaseNMEAMessage
+class NMEAMessageRMC
 {
 public:
     NMEAMessageRMC(const char *message);
     Time time() { return _time; }
     Status status() { return _status; }
-    double latitude() { return _latitude; }
-    double longitude() { return _longitude; }
-    double speedOverGround() { return _speedOverGround; }
+    Coordinate latitude() { return _latitude; }
+    Coordinate longitude() { return _longitude; }
+    CentiKnots speedOverGround() { return _speedOverGround; }
     Heading trackMadeGood() { return _trackMadeGood; }
     Date date() { return _date; }
     //! West is negative
-    double magneticVariation() { return _magneticVariation; }
+    DeciDegrees magneticVariation() { return _magneticVariation; }
 private:
     Time _time;
     Status _status;
-    double _latitude;
-    double _longitude;
-    double _speedOverGround;
+    Coordinate _latitude;
+    Coordinate _longitude;
+    CentiKnots _speedOverGround;
     Heading _trackMadeGood;
     Date _date;
-    double _magneticVariation;
+    DeciDegrees _magneticVariation;
 };
 
 
@@ -95,8 +101,7 @@ private:
 class NMEAMessageDBT : public BaseNMEAMessage
 {
 public:
-    //! Depth in feet
-    NMEAMessageDBT(float depth);
+    NMEAMessageDBT(DeciFeet depth);
 };
 
 
@@ -106,7 +111,7 @@ class NMEAMessageVHW : public BaseNMEAMessage
 public:
     //! Water speed in Knots
     // TODO: There is all sorts of other data in this message. Leaving it out for now since I don't need it.
-    NMEAMessageVHW(float knots);
+    NMEAMessageVHW(CentiKnots speed);
 };
 
 
@@ -114,12 +119,11 @@ public:
 class NMEAMessageHDM : public BaseNMEAMessage
 {
 public:
-    //! Magnetic heading in degrees
-    NMEAMessageHDM(float degrees);
+    NMEAMessageHDM(DeciDegrees heading);
 };
 
 
-class NMEAMessageAPB : public BaseNMEAMessage
+class NMEAMessageAPB
 {
 public:
     NMEAMessageAPB(const char *message);
@@ -128,7 +132,7 @@ public:
     //! Loran-C Cycle Lock warning flag
     bool isCycleLockWarning() { return _isCycleLockWarning; }
     //! Cross Track Error Magnitude
-    float xte() { return _xte; }
+    CentiNauticalMiles xte() { return _xte; }
     //! Direction to steer, Left or Right
     Laterality directionToSteer() { return _directionToSteer; }
     //! Arrival Circle Entered
@@ -138,7 +142,7 @@ public:
     //! Bearing origin to destination
     Heading bearingOriginToDestination() { return _bearingOriginToDestination; }
     //! Destination Waypoint ID
-    char *destinationWaypointID() { return _destinationWaypointID; }
+    NMEAFragment destinationWaypointID() { return _destinationWaypointID; }
     //! Bearing, present position to Destination
     Heading bearingPresentToDestination() { return _bearingPresentToDestination; }
     //! Heading to steer to destination waypoint
@@ -146,12 +150,12 @@ public:
 private:
     bool _isUnreliableFix;
     bool _isCycleLockWarning;
-    float _xte;
+    CentiNauticalMiles _xte;
     Laterality _directionToSteer;
     bool _isArrived;
     bool _isPerpendicularPassed;
     Heading _bearingOriginToDestination;
-    char _destinationWaypointID[20];
+    NMEAFragment _destinationWaypointID;
     Heading _bearingPresentToDestination;
     Heading _headingToSteerToWaypoint;
 };
@@ -162,6 +166,8 @@ class NMEAMessageSEA : public BaseNMEAMessage
 public:
     NMEAMessageSEA(const char *message);
     NMEAMessageSEA(const uint8_t *seaTalkMessage, uint8_t seaTalkMessageLength);
+    //! Decodes the hex payload of a $STSEA sentence straight into seaTalkMessage. Returns the SeaTalk message length, or 0 if the payload is malformed or longer than maxLength.
+    static int decodeSeaTalkMessage(const char *message, uint8_t *seaTalkMessage, int maxLength);
     uint8_t *seaTalkMessage() { return _seaTalkMessage; }
     uint8_t seaTalkMessageLength() { return _seaTalkMessageLength; }
 private:
@@ -1,6 +1,7 @@
 #include "NMEAParser.h"
 #include <cstring>
 #include "NMEAShared.h"
+#include "Trace.h"
 #include "Arduino.h"
 #include "ctype.h"
 
@@ -17,25 +18,28 @@ int hexAsciiToInt(char hexCharacter) {
     return output;
 }
 
-NMEAParser::NMEAParser() {
+BaseNMEAParser::BaseNMEAParser(char *message, int capacity) {
+    _message = message;
+    _capacity = capacity;
     _index = 0;
     _state = NMEAParserStateReset;
+    _logsErrors = true;
     _invalidChecksumCount = 0;
     _messagesParsedCount = 0;
 }
 
-bool NMEAParser::parse(char c) {
-    // Sanity check: messages shouldn't be too long
-    if (_index >= 100) {
+bool BaseNMEAParser::parse(char c) {
+    // Sanity check: messages shouldn't be too long. Leave room for this char and the line ending and NULL terminator
+    // added after the checksum.
+    if (_index >= _capacity - 3) {
         _state = NMEAParserStateReset;
     }
     // LF and CR always reset parser
     if ((c == 0x0A) || (c == 0x0D)) {
         _state = NMEAParserStateReset;
     }
-    // '$' starts an NMEA message, '!' starts a AIVDM message
-    if (c == '$' || c == '!') {
-        memset(_message, 0, sizeof(_message));
+    if (nmeaIsSentenceStart(c)) {
+        memset(_message, 0, _capacity);
         _message[0] = c;
         _index = 1;
         _state = NMEAParserStateParsingContent;
@@ -71,13 +75,15 @@ bool NMEAParser::parse(char c) {
                 _message[_index++] = '\0';
 
                 if (actualChecksum != calculatedChecksum) {
-                    Serial.println("ERROR: NMEA Checksum Failed");
-                    Serial.print("Calculated: ");
-                    Serial.print(calculatedChecksum);
-                    Serial.print(" Actual: ");
-                    Serial.print(actualChecksum);
-                    Serial.println(" for message:");
-                    Serial.println(_message);
+                    if (_logsErrors) {
+                        Serial.println("ERROR: NMEA Checksum Failed");
+                        Serial.print("Calculated: ");
+                        Serial.print(calculatedChecksum);
+                        Serial.print(" Actual: ");
+                        Serial.print(actualChecksum);
+                        Serial.println(" for message:");
+                        Serial.println(_message);
+                    }
                     _state = NMEAParserStateReset;
                     _invalidChecksumCount++;
                     return false;
@@ -95,7 +101,39 @@ bool NMEAParser::parse(char c) {
     return false;
 }
 
-const char *NMEAParser::message() {
+int BaseNMEAParser::parse(const char *buffer, int length, bool *complete) {
+    TRACE_SCOPE(TraceEventNMEAParse, 0);
+    *complete = false;
+    int i = 0;
+    while (i < length) {
+        // Fast path: copy runs of plain content straight into the message, leaving the byte at a time parser to
+        // handle delimiters and the length sanity check
+        if (_state == NMEAParserStateParsingContent) {
+            int run = 0;
+            int space = _capacity - 3 - _index;
+            while (run < space && i + run < length) {
+                char c = buffer[i + run];
+                if (c == '*' || nmeaIsSentenceStart(c) || c == 0x0A || c == 0x0D) {
+                    break;
+                }
+                run++;
+            }
+            memcpy(&_message[_index], &buffer[i], run);
+            _index += run;
+            i += run;
+            if (i >= length) {
+                break;
+            }
+        }
+        if (parse(buffer[i++])) {
+            *complete = true;
+            break;
+        }
+    }
+    return i;
+}
+
+const char *BaseNMEAParser::message() {
     if (_state == NMEAParserStateComplete) {
         return _message;
     } else {
@@ -103,7 +141,7 @@ const char *NMEAParser::message() {
     }
 }
 
-int NMEAParser::messageLength() {
+int BaseNMEAParser::messageLength() {
     if (_state == NMEAParserStateComplete) {
         return _messageLength;
     } else {
@@ -1,27 +1,69 @@
 #ifndef NMEAParser_h
 #define NMEAParser_h
 
+#include "NMEAShared.h"
+
+//! '$' starts an NMEA sentence, '!' an encapsulated one like AIVDM
+inline bool nmeaIsSentenceStart(char c) {
+    return c == '$' || c == '!';
+}
+
 /*!
-Parses a bytestream into a full NMEA message
+Parses a bytestream into a full NMEA message. The message buffer belongs to the subclass, use SizedNMEAParser.
 */
-class NMEAParser
+class BaseNMEAParser
 {
     public:
-        NMEAParser();
+        //! Longest message this parser will keep, including the line ending and NULL terminator
+        int capacity() { return _capacity; }
         //! Accepts the next byte in the stream, returns true if a full sentence was received
         bool parse(char c);
+        //! Accepts a run of bytes from the stream. Stops right after a full sentence so it can be handled before the next one overwrites it. Returns the number of bytes consumed.
+        int parse(const char *buffer, int length, bool *complete);
         //! The most recently received complete message. Will be NULL if no full message has been received.
         const char* message();
         int messageLength();
+        //! Checksum failures are printed to Serial unless this is turned off, which it is while the computer is receiving a capture
+        void setLogsErrors(bool logsErrors) { _logsErrors = logsErrors; }
+    protected:
+        BaseNMEAParser(char *message, int capacity);
+        char *_message;
+        int _capacity;
     private:
-        char _message[100];
         int _messageLength;
         int _contentLength;
         int _state;
         int _index;
+        bool _logsErrors;
 
         int _invalidChecksumCount;
         int _messagesParsedCount;
 };
 
+/*!
+An NMEAParser holding messages up to MessageCapacity bytes, including the line ending and NULL terminator. Longer
+sentences are dropped. Size each parser for the traffic on its port, 83 fits anything the standard allows.
+*/
+template <int MessageCapacity>
+class SizedNMEAParser : public BaseNMEAParser
+{
+    public:
+        SizedNMEAParser() : BaseNMEAParser(_buffer, MessageCapacity) { }
+        // The base class points at _buffer, so copies have to point at their own
+        SizedNMEAParser(const SizedNMEAParser &other) : BaseNMEAParser(other) {
+            memcpy(_buffer, other._buffer, sizeof(_buffer));
+            _message = _buffer;
+        }
+        SizedNMEAParser &operator=(const SizedNMEAParser &other) {
+            BaseNMEAParser::operator=(other);
+            memcpy(_buffer, other._buffer, sizeof(_buffer));
+            _message = _buffer;
+            return *this;
+        }
+    private:
+        char _buffer[MessageCapacity];
+};
+
+typedef SizedNMEAParser<NMEA_MESSAGE_MAX_LENGTH> NMEAParser;
+
 #endif
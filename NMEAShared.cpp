@@ -3,7 +3,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <cstring>
-#include "types.h"
+#include "Types.h"
 #include <ctype.h>
 
 
@@ -17,69 +17,138 @@ int calculateChecksum(char *message, size_t length) {
 
 //! NMEA degrees are of the format 3751.98291 where the first 2-3 characters are the degrees,
 //  Then the rest is minutes
-double degreesFromCoordinateString(const char *string, char direction) {
+Coordinate coordinateFromString(const char *string, char direction) {
+    int integerLength = 0;
+    while (isdigit(string[integerLength])) {
+        integerLength++;
+    }
     // Edge case, don't process strings that are too short
-    size_t length = strlen(string);
-    if (length < 3) {
-        return 0.0;
-    }
-    int decimalIndex = (int)(strchr(string, '.') - string);
-    double minutes = atof(&(string[decimalIndex - 2]));
-    int i = decimalIndex - 3;
-    int degrees = 0;
-    int multiplier = 1;
-    while (i >= 0) {
-      degrees += (string[i] - '0') * multiplier;
-      i--;
-      multiplier *= 10;
-    }
-    double coordinate = (double)degrees + (minutes/60.0);
+    if (integerLength < 2) {
+        return 0;
+    }
+    int32_t degrees = 0;
+    for (int i = 0; i < integerLength - 2; i++) {
+        degrees = degrees * 10 + (string[i] - '0');
+    }
+    // Millionths of a minute, and a minute is 1/60 of a degree, so that's 1e-7 degrees times 6
+    int32_t minutes = fixedFromString(&string[integerLength - 2], 6);
+    Coordinate coordinate = degrees * COORDINATE_UNITS_PER_DEGREE + divideRounded(minutes, 6);
     if (direction == 'S' || direction == 'W') {
-        coordinate = coordinate * -1;
+        coordinate = -coordinate;
     }
     return coordinate;
 }
 
-void splitMessageIntoFragments(const char *message, size_t messageLength, char **fragments, int *fragmentCount) {
+int32_t fixedFromString(const char *string, int decimals) {
+    bool isNegative = *string == '-';
+    if (*string == '-' || *string == '+') {
+        string++;
+    }
+    int32_t value = 0;
+    while (isdigit(*string)) {
+        value = value * 10 + (*string++ - '0');
+    }
+    if (*string == '.') {
+        string++;
+    }
+    for (int i = 0; i < decimals; i++) {
+        value *= 10;
+        if (isdigit(*string)) {
+            value += *string++ - '0';
+        }
+    }
+    if (*string >= '5' && *string <= '9') {
+        value++;
+    }
+    return isNegative ? -value : value;
+}
+
+int fixedToString(int32_t value, int decimals, char *output) {
+    char *start = output;
+    uint32_t magnitude = value;
+    if (value < 0) {
+        *output++ = '-';
+        magnitude = -(uint32_t)value;
+    }
+    // Digits come out least significant first
+    char digits[12];
+    int digitCount = 0;
+    do {
+        digits[digitCount++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude || digitCount <= decimals);
+    while (digitCount) {
+        if (digitCount-- == decimals) {
+            *output++ = '.';
+        }
+        *output++ = digits[digitCount];
+    }
+    *output = 0;
+    return output - start;
+}
+
+void splitMessageIntoFragments(const char *message, size_t messageLength, NMEAFragment *fragments, int maxFragmentCount, int *fragmentCount) {
     *fragmentCount = 0;
     int fragmentStartIndex = 0;
 
     // Split into fragments by commas
-    // TODO: This could maybe be significantly refactored with strtok
-    for (int i = 0; i < (int)messageLength; i++) {
+    for (int i = 0; i < (int)messageLength && *fragmentCount < maxFragmentCount; i++) {
         if (message[i] == ',' || message[i] == '*') {
-            int fragmentLength = i - fragmentStartIndex;
-            char *fragment;
-            if (fragmentLength > 0) {
-                fragment = (char *)malloc((fragmentLength + 1) * sizeof(char));
-                memcpy(fragment, &message[fragmentStartIndex], fragmentLength);
-                // Null terminate for easy printing
-                fragment[fragmentLength] = 0;
-            } else {
-                // Fill empty fragments with the empty string
-                fragment = (char *)malloc(2 * sizeof(char));
-                strcpy(fragment, "");
-            }
-            fragments[(*fragmentCount)++] = fragment;
+            fragments[*fragmentCount].start = &message[fragmentStartIndex];
+            fragments[*fragmentCount].length = i - fragmentStartIndex;
+            (*fragmentCount)++;
             fragmentStartIndex = i + 1;
         }
         if (message[i] == '*') {
             break;
         }
     }
+    for (int i = *fragmentCount; i < maxFragmentCount; i++) {
+        fragments[i].start = "";
+        fragments[i].length = 0;
+    }
+}
+
+bool fragmentEquals(NMEAFragment fragment, const char *string) {
+    return strlen(string) == fragment.length && memcmp(fragment.start, string, fragment.length) == 0;
+}
+
+static int twoDigits(const char *string) {
+    return (string[0] - '0') * 10 + (string[1] - '0');
+}
+
+static bool startsWithDigits(const char *string, int count) {
+    for (int i = 0; i < count; i++) {
+        if (!isdigit(string[i])) {
+            return false;
+        }
+    }
+    return true;
 }
 
 Time timeFromString(const char *timeString) {
-    Time time;
-    sscanf(timeString, "%2d%2d", &(time.hour), &(time.minute));
-    // TODO: Can't figure out how to read floats with sscanf
-    time.second = atof(&timeString[4]);
+    Time time = {0, 0, 0};
+    if (startsWithDigits(timeString, 6)) {
+        time.hour = twoDigits(timeString);
+        time.minute = twoDigits(&timeString[2]);
+        time.millisecond = fixedFromString(&timeString[4], 3);
+    }
     return time;
 }
 
+Date dateFromString(const char *dateString) {
+    Date date = {0, 0, 0};
+    if (startsWithDigits(dateString, 6)) {
+        date.day = twoDigits(dateString);
+        date.month = twoDigits(&dateString[2]);
+        date.year = twoDigits(&dateString[4]);
+    }
+    return date;
+}
+
 Heading headingFromFragments(const char *degrees, const char *trueOrMagnetic) {
     Heading heading;
-    heading.degrees = atof(degrees);
+    heading.deciDegrees = fixedFromString(degrees, 1);
     heading.isMagnetic = toupper(trueOrMagnetic[0]) == 'M' ? true : false;
     return heading;
 }
@@ -104,14 +173,52 @@ Status statusFromFragment(const char *fragment) {
     }
 }
 
+static const char hexDigits[16] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
+
+// Value of each ascii hex digit, 0xFF for everything else
+#define XX 0xFF
+static const uint8_t hexValues[256] = {
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, XX, XX, XX, XX, XX, XX,
+    XX, 10, 11, 12, 13, 14, 15, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, 10, 11, 12, 13, 14, 15, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+};
+#undef XX
+
 uint8_t asciiHexToBinary(char asciiHex) {
-    if (asciiHex >= '0' && asciiHex <= '9') {
-        return asciiHex - '0';
-    } else if (asciiHex >= 'A' && asciiHex <= 'F') {
-        return (asciiHex - 'A' + 10);
-    } else if (asciiHex >= 'a' && asciiHex <= 'f') {
-        return (asciiHex - 'a' + 10);
-    } else {
-        return 0;
+    uint8_t value = hexValues[(uint8_t)asciiHex];
+    return value == 0xFF ? 0 : value;
+}
+
+size_t binaryToAsciiHex(const uint8_t *binary, size_t length, char *output) {
+    for (size_t i = 0; i < length; i++) {
+        *output++ = hexDigits[binary[i] >> 4];
+        *output++ = hexDigits[binary[i] & 0xF];
+    }
+    return length * 2;
+}
+
+size_t asciiHexToBinary(const char *asciiHex, size_t length, uint8_t *output) {
+    size_t outputLength = 0;
+    for (size_t i = 0; i + 1 < length; i += 2) {
+        uint8_t high = hexValues[(uint8_t)asciiHex[i]];
+        uint8_t low = hexValues[(uint8_t)asciiHex[i + 1]];
+        if ((high | low) == 0xFF) {
+            break;
+        }
+        output[outputLength++] = (high << 4) | low;
     }
+    return outputLength;
 }
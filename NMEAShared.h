@@ -1,19 +1,46 @@
 #ifndef NMEAShared_h
 #define NMEAShared_h
 
-#include "types.h"
+#include "Types.h"
 #include <cstring>
 #include "inttypes.h"
 
+//! Longest sentence we handle, including the line ending and NULL terminator. The standard says 82 chars.
+#define NMEA_MESSAGE_MAX_LENGTH 100
+
+
+//! A field of a sentence, pointing into the sentence instead of copied out of it. It's not NULL terminated, start is
+//! followed by the ',' or '*' that ended the field, which the parsing functions below all stop at.
+typedef struct {
+    const char *start;
+    uint8_t length;
+} NMEAFragment;
+
 
 int calculateChecksum(char *message, size_t length);
 
-double degreesFromCoordinateString(const char *string, char direction);
+//! NMEA ddmm.mmmm or dddmm.mmmm coordinate, negated for S and W
+Coordinate coordinateFromString(const char *string, char direction);
+
+//! Parses a decimal like "12.345" into an integer count of 10^-decimals, rounding half away from zero on the first digit
+//! that doesn't fit. Stops at the first char that isn't part of the number, so empty fields are 0.
+int32_t fixedFromString(const char *string, int decimals);
+
+//! Writes value / 10^decimals with exactly that many decimals and a NULL terminator. Returns the number of chars before it.
+int fixedToString(int32_t value, int decimals, char *output);
 
-void splitMessageIntoFragments(const char *message, size_t messageLength, char **fragments, int *fragmentCount);
+//! Splits at the commas, up to maxFragmentCount fragments. Fields past that are ignored, newer sentence versions append fields.
+//! Fragments the sentence is too short to have are empty. They point into message, so it has to outlive them.
+void splitMessageIntoFragments(const char *message, size_t messageLength, NMEAFragment *fragments, int maxFragmentCount, int *fragmentCount);
 
+bool fragmentEquals(NMEAFragment fragment, const char *string);
+
+//! hhmmss.ss
 Time timeFromString(const char *timeString);
 
+//! ddmmyy
+Date dateFromString(const char *dateString);
+
 Heading headingFromFragments(const char *degrees, const char *trueOrMagnetic);
 
 Laterality lateralityFromFragment(const char *fragment);
@@ -22,4 +49,10 @@ Status statusFromFragment(const char *fragment);
 
 uint8_t asciiHexToBinary(char asciiHex);
 
+//! Writes two uppercase hex digits per byte into output, without a NULL terminator. Returns the number of chars written.
+size_t binaryToAsciiHex(const uint8_t *binary, size_t length, char *output);
+
+//! Decodes pairs of hex digits into bytes. Stops at the first char that isn't a hex digit, returns the number of bytes written.
+size_t asciiHexToBinary(const char *asciiHex, size_t length, uint8_t *output);
+
 #endif
@@ -0,0 +1,569 @@
+#include "Router.h"
+#include "NMEAMessage.h"
+#include "StackPaint.h"
+#include "Arduino.h"
+#include <cstring>
+#include <stdio.h>
+#include "math.h"
+
+// Bytes read from each port per pass of poll(), indexed by Port. Ports whose RX buffer is more than half full are drained completely.
+static const int READ_BUDGETS[PortCount] = {64, 64, 16, 16, 32};
+static const int RX_BUFFER_SIZES[PortCount] = SERIAL_BUFFERS_RX_SIZES;
+// A trace dump only fills the output queue up to here, routed sentences get the rest
+#define TRACE_DUMP_QUEUE_FREE_SLOTS 8
+
+Router::Router() :
+    _outputTxQueue(MessageQueueDropOldest),
+    _nmeaHighSpeedTxQueue(MessageQueueDropOldest),
+    _nmeaTxQueue(MessageQueueReplaceSameType),
+    _seaTalkTxQueue(MessageQueueReplaceSameType),
+    _captureWriter(_captureBuffer, ROUTER_CAPTURE_BUFFER_SIZE),
+    _rmbLatencyProbe("RMB>SEATALK", PortSeaTalk, 0x85),
+    _windLatencyProbe("WIND>MWV", PortOutput, NMEA_TYPE('M', 'W', 'V'))
+{
+    for (int i = 0; i < PortCount; i++) {
+        _ports[i] = NULL;
+        _serialPorts[i] = NULL;
+        _messageStartTimestamps[i] = 0;
+        _txSpace[i] = -1;
+        _txBacklog[i] = 0;
+        _rxBufferSizes[i] = RX_BUFFER_SIZES[i];
+        _portStats[i].bytesRead = 0;
+        _portStats[i].highWater = 0;
+        _portStats[i].fullPasses = 0;
+    }
+    // Each keystroke counts, two presses of +1 mustn't reach the autopilot as one
+    _seaTalkTxQueue.setNeverReplacedType(0x86);
+    _latencyProbes[RouterLatencyRMBToSeaTalk] = &_rmbLatencyProbe;
+    _latencyProbes[RouterLatencyWindToMWV] = &_windLatencyProbe;
+    _isDumpingTrace = false;
+    _traceDumpOffset = 0;
+    _captureMode = RouterCaptureOff;
+    _isStreamingCapture = false;
+    _now = 0;
+}
+
+void Router::setPort(Port port, SerialPort *serial) {
+    _serialPorts[port] = serial;
+    _capturePorts[port].attach(serial, port, &_captureWriter);
+    // The capture goes out on the computer's port, what the router sends the computer is only recorded in it
+    _capturePorts[port].setPassThroughWrites(port != PortOutput);
+    _ports[port] = serial && _captureMode != RouterCaptureOff ? &_capturePorts[port] : serial;
+}
+
+void Router::setRxBufferSize(Port port, int size) {
+    _rxBufferSizes[port] = size;
+}
+
+void Router::setCaptureMode(RouterCaptureMode mode) {
+    if (mode == _captureMode) {
+        return;
+    }
+    if (_captureMode == RouterCaptureOff) {
+        // Drops whatever is left of the last capture if it hasn't all gone out yet
+        _captureWriter.reset();
+        _isStreamingCapture = true;
+    } else if (mode == RouterCaptureOff) {
+        for (int i = 0; i < PortCount; i++) {
+            _capturePorts[i].flush();
+        }
+        _captureWriter.end(micros());
+    }
+    _captureMode = mode;
+    // Anything printed straight to Serial would end up in the middle of the capture
+    _gpsParser.setLogsErrors(mode == RouterCaptureOff);
+    _aisParser.setLogsErrors(mode == RouterCaptureOff);
+    _inputParser.setLogsErrors(mode == RouterCaptureOff);
+    _nmeaParser.setLogsErrors(mode == RouterCaptureOff);
+    for (int i = 0; i < PortCount; i++) {
+        _ports[i] = _serialPorts[i] && mode != RouterCaptureOff ? &_capturePorts[i] : _serialPorts[i];
+    }
+}
+
+bool Router::poll(uint32_t now) {
+    _now = now;
+    bool didRead = false;
+    didRead |= readNMEAPort(PortNMEAHighSpeed, _aisParser);
+    didRead |= readNMEAPort(PortGPS, _gpsParser);
+    didRead |= readNMEAPort(PortOutput, _inputParser);
+    didRead |= readNMEAPort(PortNMEA, _nmeaParser);
+    didRead |= readSeaTalkPort();
+    sendQueuedMessages();
+    return didRead;
+}
+
+uint32_t Router::txDropCount(Port port) {
+    switch (port) {
+        case PortOutput:
+            return _outputTxQueue.dropCount();
+        case PortNMEAHighSpeed:
+            return _nmeaHighSpeedTxQueue.dropCount();
+        case PortNMEA:
+            return _nmeaTxQueue.dropCount();
+        case PortSeaTalk:
+            return _seaTalkTxQueue.dropCount();
+        default:
+            return 0;
+    }
+}
+
+#define SEND_SEATALK_MESSAGE(messageInstance, origin) _seaTalkTxQueue.push(messageInstance.message(), messageInstance.messageLength(), origin, messageInstance.message()[0]);
+
+int Router::txSpace(Port port, SerialPort *serial) {
+    int space = serial->availableForWrite();
+    // Whatever space opened up since our last write is bytes that went out
+    int drained = _txSpace[port] >= 0 && space > _txSpace[port] ? space - _txSpace[port] : 0;
+    if (drained) {
+        _txBacklog[port] -= (uint32_t)drained < _txBacklog[port] ? drained : _txBacklog[port];
+        uint32_t timestamp = latencyTimestamp();
+        for (int i = 0; i < RouterLatencyRouteCount; i++) {
+            if (_latencyProbes[i]->destination() == port) {
+                _latencyProbes[i]->drained(drained, timestamp);
+            }
+        }
+    }
+    _txSpace[port] = space;
+    return space;
+}
+
+void Router::txWritten(Port port, int length) {
+    _txSpace[port] -= length;
+    _txBacklog[port] += length;
+}
+
+void Router::messageWritten(Port port, uint32_t type) {
+    for (int i = 0; i < RouterLatencyRouteCount; i++) {
+        if (_latencyProbes[i]->destination() == port && _latencyProbes[i]->type() == type) {
+            _latencyProbes[i]->written(_txBacklog[port]);
+        }
+    }
+}
+
+void Router::sendQueuedSeaTalkMessages() {
+    SerialPort *serial = _ports[PortSeaTalk];
+    // Nothing to send and nothing of ours left to watch drain
+    if (!serial || (_seaTalkTxQueue.isEmpty() && !_txBacklog[PortSeaTalk])) {
+        return;
+    }
+    TRACE_SCOPE(TraceEventWrite, PortSeaTalk);
+    int space = txSpace(PortSeaTalk, serial);
+    while (!_seaTalkTxQueue.isEmpty()) {
+        uint8_t *message = _seaTalkTxQueue.front();
+        int messageLength = _seaTalkTxQueue.frontLength();
+        // Datagrams go out whole so nothing else can end up in the middle of one
+        if (space < messageLength) {
+            return;
+        }
+        serial->write9bit(message[0] + 256);
+        serial->write(&(message[1]), messageLength - 1);
+        space -= messageLength;
+        txWritten(PortSeaTalk, messageLength);
+        messageWritten(PortSeaTalk, message[0]);
+        _seaTalkEchoFilter.transmitted(message, messageLength, (Port)_seaTalkTxQueue.frontOrigin(), _now);
+        _seaTalkTxQueue.pop();
+    }
+}
+
+//! Hands as much of the queued sentences to the port as fits in its TX buffer
+template <class QueueType>
+void Router::sendQueuedNMEAMessages(Port port, QueueType &queue) {
+    SerialPort *serial = _ports[port];
+    if (!serial || (queue.isEmpty() && !_txBacklog[port])) {
+        return;
+    }
+    TRACE_SCOPE(TraceEventWrite, port);
+    int space = txSpace(port, serial);
+    while (space > 0 && !queue.isEmpty()) {
+        int remaining = queue.frontLength() - queue.frontOffset();
+        int length = remaining < space ? remaining : space;
+        serial->write(&(queue.front()[queue.frontOffset()]), length);
+        space -= length;
+        txWritten(port, length);
+        if (length == remaining) {
+            messageWritten(port, queue.frontType());
+        }
+        queue.consumeFront(length);
+    }
+}
+
+void Router::sendNMEAMessage(const char *message, uint8_t destinations, Port origin) {
+    const uint8_t *bytes = (const uint8_t *)message;
+    int messageLength = strlen(message);
+    uint32_t type = nmeaMessageType(message);
+    if (destinations & PORT_MASK(PortOutput)) {
+        _outputTxQueue.push(bytes, messageLength, origin, type);
+    }
+    if (destinations & PORT_MASK(PortNMEAHighSpeed)) {
+        _nmeaHighSpeedTxQueue.push(bytes, messageLength, origin, type);
+    }
+    if (destinations & PORT_MASK(PortNMEA)) {
+        _nmeaTxQueue.push(bytes, messageLength, origin, type);
+    }
+}
+
+void Router::streamCapture() {
+    SerialPort *serial = _serialPorts[PortOutput];
+    int space = serial ? serial->availableForWrite() : 0;
+    int length = _captureWriter.length() < (size_t)space ? _captureWriter.length() : space;
+    if (length > 0) {
+        serial->write(_captureWriter.data(), length);
+        _captureWriter.consume(length);
+    }
+    if (!serial) {
+        _captureWriter.consume(_captureWriter.length());
+    }
+    if (_captureMode == RouterCaptureOff && !_captureWriter.length()) {
+        _isStreamingCapture = false;
+    }
+}
+
+void Router::sendTraceDump() {
+    // The dump is far bigger than the queue, it goes out a few sentences at a time as the queue empties
+    char sentence[NMEA_MESSAGE_MAX_LENGTH];
+    while (_outputTxQueue.freeCount() > TRACE_DUMP_QUEUE_FREE_SLOTS) {
+        // Leave room for the checksum
+        if (!traceDumpSentence(&_traceDumpOffset, sentence, sizeof(sentence) - 6)) {
+            _isDumpingTrace = false;
+            return;
+        }
+        closeMessage(sentence);
+        sendNMEAMessage(sentence, PORT_MASK(PortOutput), PortOutput);
+    }
+}
+
+void Router::sendQueuedMessages() {
+    if (_isDumpingTrace) {
+        sendTraceDump();
+    }
+    // While the end of a capture is still going out, sentences for the computer wait in the queue
+    if (_captureMode != RouterCaptureOff || !_isStreamingCapture) {
+        sendQueuedNMEAMessages(PortOutput, _outputTxQueue);
+    }
+    if (_isStreamingCapture) {
+        streamCapture();
+    }
+    sendQueuedNMEAMessages(PortNMEAHighSpeed, _nmeaHighSpeedTxQueue);
+    sendQueuedNMEAMessages(PortNMEA, _nmeaTxQueue);
+    sendQueuedSeaTalkMessages();
+}
+
+void Router::handleCommand(const char *message) {
+    char description[NMEA_MESSAGE_MAX_LENGTH];
+    if (strncmp(message, "$PHLM,ROUTE,LIST", 16) == 0) {
+        for (int i = 0; i < _routingTable.routeCount(); i++) {
+            _routingTable.describeRoute(i, description, sizeof(description));
+            sendNMEAMessage(description, PORT_MASK(PortOutput), PortOutput);
+        }
+        _routingTable.describeTransformsInUse(description, sizeof(description));
+        sendNMEAMessage(description, PORT_MASK(PortOutput), PortOutput);
+    } else if (strncmp(message, "$PHLM,STATS", 11) == 0) {
+        // Messages each port's TX queue had to drop, in Port order
+        sprintf(description, "$PHLM,STATS,TXDROPS,%lu,%lu,%lu,%lu,%lu", (unsigned long)txDropCount(PortOutput), (unsigned long)txDropCount(PortNMEAHighSpeed), (unsigned long)txDropCount(PortNMEA), (unsigned long)txDropCount(PortSeaTalk), (unsigned long)txDropCount(PortGPS));
+        closeMessage(description);
+        sendNMEAMessage(description, PORT_MASK(PortOutput), PortOutput);
+        // Deepest the stack has been and how much of it was painted, in bytes
+        sprintf(description, "$PHLM,STATS,STACK,%lu,%lu", (unsigned long)stackHighWater(), (unsigned long)stackPaintedSize());
+        closeMessage(description);
+        sendNMEAMessage(description, PORT_MASK(PortOutput), PortOutput);
+        // Characters each port's driver garbled or lost: ISR latency overruns, RX overflows, framing errors
+        for (int i = 0; i < PortCount; i++) {
+            if (!_serialPorts[i]) {
+                continue;
+            }
+            SerialErrorCounts counts = _serialPorts[i]->errorCounts();
+            sprintf(description, "$PHLM,STATS,ERRORS,%s,%lu,%lu,%lu", RoutingTable::portName((Port)i), (unsigned long)counts.latencyOverruns, (unsigned long)counts.overflows, (unsigned long)counts.framingErrors);
+            closeMessage(description);
+            sendNMEAMessage(description, PORT_MASK(PortOutput), PortOutput);
+        }
+        // SeaTalk bus health: datagrams with a bad length or redundancy bytes, datagrams cut short, bytes skipped to resync
+        sprintf(description, "$PHLM,STATS,SEATALK,%d,%d,%d", _seaTalkParser.invalidMessageCount(), _seaTalkParser.truncatedMessageCount(), _seaTalkParser.discardedByteCount());
+        closeMessage(description);
+        sendNMEAMessage(description, PORT_MASK(PortOutput), PortOutput);
+        // SeaTalk echoes suppressed, by the port each datagram originally came from, in Port order
+        sprintf(description, "$PHLM,STATS,ECHOES,%d,%d,%d,%d,%d", _seaTalkEchoFilter.echoCount(PortOutput), _seaTalkEchoFilter.echoCount(PortNMEAHighSpeed), _seaTalkEchoFilter.echoCount(PortNMEA), _seaTalkEchoFilter.echoCount(PortSeaTalk), _seaTalkEchoFilter.echoCount(PortGPS));
+        closeMessage(description);
+        sendNMEAMessage(description, PORT_MASK(PortOutput), PortOutput);
+        // What each port's RX buffer has seen: bytes read, high water in bytes, passes that found it full
+        for (int i = 0; i < PortCount; i++) {
+            if (!_serialPorts[i]) {
+                continue;
+            }
+            const RouterPortStats *stats = &_portStats[i];
+            sprintf(description, "$PHLM,STATS,RX,%s,%lu,%u,%lu", RoutingTable::portName((Port)i), (unsigned long)stats->bytesRead, (unsigned)stats->highWater, (unsigned long)stats->fullPasses);
+            closeMessage(description);
+            sendNMEAMessage(description, PORT_MASK(PortOutput), PortOutput);
+        }
+    } else if (strncmp(message, "$PHLM,LATENCY,RESET", 19) == 0) {
+        for (int i = 0; i < RouterLatencyRouteCount; i++) {
+            _latencyProbes[i]->histogram()->reset();
+        }
+    } else if (strncmp(message, "$PHLM,LATENCY", 13) == 0) {
+        for (int i = 0; i < RouterLatencyRouteCount; i++) {
+            // Leave room for the checksum
+            _latencyProbes[i]->describe(description, sizeof(description) - 6);
+            closeMessage(description);
+            sendNMEAMessage(description, PORT_MASK(PortOutput), PortOutput);
+        }
+    } else if (strncmp(message, "$PHLM,TRACE", 11) == 0) {
+        if (!_isDumpingTrace) {
+            _isDumpingTrace = true;
+            _traceDumpOffset = 0;
+        }
+    } else if (strncmp(message, "$PHLM,CAPTURE,ON", 16) == 0) {
+        setCaptureMode(RouterCaptureOn);
+    } else if (strncmp(message, "$PHLM,CAPTURE,RAW", 17) == 0) {
+        setCaptureMode(RouterCaptureRaw);
+    } else if (strncmp(message, "$PHLM,CAPTURE,OFF", 17) == 0) {
+        setCaptureMode(RouterCaptureOff);
+        // Goes out once the end of the capture has, so the computer knows how much of it is missing
+        sprintf(description, "$PHLM,CAPTURE,LOST,%lu", (unsigned long)captureDropCount());
+        closeMessage(description);
+        sendNMEAMessage(description, PORT_MASK(PortOutput), PortOutput);
+    } else if (strncmp(message, "$PHLM,ROUTE,", 12) == 0) {
+        // Malformed, or a route that doesn't fit, the table is left as it was
+        if (!_routingTable.applyCommand(message)) {
+            snprintf(description, sizeof(description), "ERROR: Route rejected: %s", message);
+            sendNMEAMessage(description, PORT_MASK(PortOutput), PortOutput);
+        }
+    } else if (!_routingTable.applyCommand(message)) {
+        snprintf(description, sizeof(description), "ERROR: Unknown command: %s", message);
+        sendNMEAMessage(description, PORT_MASK(PortOutput), PortOutput);
+    }
+}
+
+void Router::routeNMEAMessage(Port source, const char *message) {
+    TRACE_SCOPE(TraceEventRoute, source);
+    const RouteDispatch *dispatch = _routingTable.dispatch(source, nmeaMessageType(message));
+    for (int i = 0; i < dispatch->actionCount; i++) {
+        uint8_t destinations = dispatch->actions[i].destinations;
+        switch (dispatch->actions[i].transform) {
+            case RouteTransformNone:
+                sendNMEAMessage(message, destinations, source);
+                break;
+            case RouteTransformRMCToSeaTalk: {
+                NMEAMessageRMC rmc = NMEAMessageRMC(message);
+                SeaTalkMessageLongitude seaTalkMessageLongitude(rmc.longitude());
+                SEND_SEATALK_MESSAGE(seaTalkMessageLongitude, source);
+                SeaTalkMessageLatitude seaTalkMessageLatitude(rmc.latitude());
+                SEND_SEATALK_MESSAGE(seaTalkMessageLatitude, source);
+                SeaTalkMessageSpeedOverGround seaTalkMessageSpeedOverGround(rmc.speedOverGround());
+                SEND_SEATALK_MESSAGE(seaTalkMessageSpeedOverGround, source);
+                // This isn't quite the right translation. The SeaTalk message is magnetic course, and trackMadeGood is true course, but I don't think this should hurt anything. Try to convert if possible.
+                SeaTalkMessageMagneticCourse seaTalkMessageMagneticCourse(_boatState.headingToMagnetic(rmc.trackMadeGood()).deciDegrees);
+                SEND_SEATALK_MESSAGE(seaTalkMessageMagneticCourse, source);
+                // Only send date once per minute
+                if (rmc.time().millisecond == 0) {
+                    SeaTalkMessageDate seaTalkMessageDate(rmc.date());
+                    SEND_SEATALK_MESSAGE(seaTalkMessageDate, source);
+                }
+                // Send time every 10 seconds
+                if ((rmc.time().millisecond / 1000) % 10 == 0) {
+                    SeaTalkMessageTime seaTalkMessageTime(rmc.time());
+                    SEND_SEATALK_MESSAGE(seaTalkMessageTime, source);
+                }
+                break;
+            }
+            case RouteTransformRMBToSeaTalk: {
+                // TODO: Detect conflicting route info coming in from the SeaTalk network and handle more gracefully
+                NMEAMessageRMB rmb = NMEAMessageRMB(message);
+                Heading bearingToDestination = rmb.bearingToDestination();
+                // I don't think the ST4000 picks up the magnetic variation from message 99. So we convert to magnetic here
+                // It's also possible to do the conversion in OpenCPN's connection settings
+                bearingToDestination = _boatState.headingToMagnetic(bearingToDestination);
+                _rmbLatencyProbe.started(_messageStartTimestamps[source]);
+                // Maybe can trick the autopilot to go the right way by passing in the magnetic heading instead of the true heading here
+                // bearingToDestination.isMagnetic = false;
+                SeaTalkMessageNavigationToWaypoint nav = SeaTalkMessageNavigationToWaypoint(rmb.xte(), bearingToDestination, rmb.rangeToDestiation(), rmb.directionToSteer(), 0x7);
+                SEND_SEATALK_MESSAGE(nav, source);
+                break;
+            }
+            case RouteTransformAPBToSeaTalk: {
+                NMEAMessageAPB apb = NMEAMessageAPB(message);
+                NMEAFragment waypointID = apb.destinationWaypointID();
+                SeaTalkMessageTargetWaypointName waypt = SeaTalkMessageTargetWaypointName(waypointID.start, waypointID.length);
+                SEND_SEATALK_MESSAGE(waypt, source);
+                if (apb.isArrived() || apb.isPerpendicularPassed()) {
+                    SeaTalkMessageArrivalInfo arr = SeaTalkMessageArrivalInfo(apb.isPerpendicularPassed(), apb.isArrived(), waypointID.start, waypointID.length);
+                    SEND_SEATALK_MESSAGE(arr, source);
+                }
+                break;
+            }
+            case RouteTransformRMCToVariation: {
+                NMEAMessageRMC rmc = NMEAMessageRMC(message);
+                if (rmc.magneticVariation()) {
+                    _boatState.magneticVariation = rmc.magneticVariation();
+                    if (rmc.time().millisecond < 1000 && destinations) {
+                        // Because the ST4000 doesn't appear to pick up magnetic variation (message 0x99), we set it as a parameter
+                        // Note: parameters persist on the autopilot, so we probably don't need to send this every minute. But doing anything smarter would require us to poll the autopilot parameters, which I think disables the autopilot temporarily.
+                        SeaTalkMessageSetAutopilotParameter apParam = SeaTalkMessageSetAutopilotParameter(0xC, divideRounded(_boatState.magneticVariation, 10));
+                        SEND_SEATALK_MESSAGE(apParam, source);
+                    }
+                }
+                break;
+            }
+            case RouteTransformSEAToSeaTalk: {
+                // Decode the hex straight into the transmit queue, this is the latency sensitive path from the computer to the autopilot
+                uint8_t *seaTalkMessage = _seaTalkTxQueue.reserve();
+                int seaTalkMessageLength = NMEAMessageSEA::decodeSeaTalkMessage(message, seaTalkMessage, SEATALK_MESSAGE_MAX_LENGTH);
+                if (seaTalkMessageIsValid(seaTalkMessage, seaTalkMessageLength)) {
+                    _seaTalkTxQueue.commit(seaTalkMessageLength, source, seaTalkMessage[0]);
+                }
+                break;
+            }
+        }
+    }
+}
+
+void Router::routeSeaTalkMessage(const uint8_t *message, int messageLength) {
+    TRACE_SCOPE(TraceEventRoute, PortSeaTalk);
+    // TODO: Need to dig deeper into the UART so that I can do collision managment
+    const RouteDispatch *dispatch = _routingTable.dispatch(PortSeaTalk, message[0]);
+    for (int i = 0; i < dispatch->actionCount; i++) {
+        uint8_t destinations = dispatch->actions[i].destinations;
+        switch (dispatch->actions[i].transform) {
+            case RouteTransformSeaTalkToSEA: {
+                NMEAMessageSEA sea = NMEAMessageSEA(message, messageLength);
+                sendNMEAMessage(sea.message(), destinations, PortSeaTalk);
+                break;
+            }
+            case RouteTransformWindAngleToMWV: {
+                SeaTalkMessageWindAngle windAngleMessage = SeaTalkMessageWindAngle(message);
+                _boatState.windAngle = windAngleMessage.windAngle();
+                NMEAMessageWind windMessage = NMEAMessageWind(_boatState.windAngle, _boatState.windSpeed);
+                if (destinations & PORT_MASK(_windLatencyProbe.destination())) {
+                    _windLatencyProbe.started(_messageStartTimestamps[PortSeaTalk]);
+                }
+                sendNMEAMessage(windMessage.message(), destinations, PortSeaTalk);
+                break;
+            }
+            case RouteTransformWindSpeed: {
+                SeaTalkMessageWindSpeed windSpeedMessage = SeaTalkMessageWindSpeed(message);
+                _boatState.windSpeed = windSpeedMessage.windSpeed();
+                break;
+            }
+            case RouteTransformDepthToDBT: {
+                SeaTalkMessageDepth depthMessage = SeaTalkMessageDepth(message);
+                NMEAMessageDBT dbt = NMEAMessageDBT(depthMessage.depth());
+                sendNMEAMessage(dbt.message(), destinations, PortSeaTalk);
+                break;
+            }
+            case RouteTransformSpeedToVHW: {
+                SeaTalkMessageSpeedThroughWater speedMessage = SeaTalkMessageSpeedThroughWater(message);
+                NMEAMessageVHW vhw = NMEAMessageVHW(speedMessage.speed());
+                sendNMEAMessage(vhw.message(), destinations, PortSeaTalk);
+                break;
+            }
+            case RouteTransformHeadingToHDM: {
+                SeaTalkMessageCompassHeadingAndRudderPosition headingMessage = SeaTalkMessageCompassHeadingAndRudderPosition(message);
+                NMEAMessageHDM hdm = NMEAMessageHDM(headingMessage.compassHeading() * 10);
+                sendNMEAMessage(hdm.message(), destinations, PortSeaTalk);
+                break;
+            }
+        }
+    }
+}
+
+void Router::routeInputMessage(Port source, const char *message) {
+    // The computer also sends us commands
+    if (source == PortOutput && strncmp(message, "$PHLM,", 6) == 0) {
+        handleCommand(message);
+    } else if (_captureMode != RouterCaptureRaw) {
+        routeNMEAMessage(source, message);
+    }
+}
+
+int Router::sampleAvailable(Port port, SerialPort *serial) {
+    int available = serial ? serial->available() : 0;
+    RouterPortStats *stats = &_portStats[port];
+    if (available > stats->highWater) {
+        stats->highWater = available;
+    }
+    // The Teensy core and AltSoftSerial always leave one slot empty. USB has flow control, so it's never overrun.
+    if (port != PortOutput && available >= _rxBufferSizes[port] - 1) {
+        stats->fullPasses++;
+    }
+    return available;
+}
+
+int Router::readBudget(Port port, int available) {
+    if (available * 2 >= _rxBufferSizes[port]) {
+        return available;
+    }
+    return available < READ_BUDGETS[port] ? available : READ_BUDGETS[port];
+}
+
+bool Router::readNMEAPort(Port source, BaseNMEAParser &parser) {
+    SerialPort *serial = _ports[source];
+    int available = sampleAvailable(source, serial);
+    if (available <= 0) {
+        return false;
+    }
+    TRACE_SCOPE(TraceEventRead, source);
+    // Always consume incoming bytes, even from ports no route reads. Teensy seems to crash otherwise
+    bool isUsed = source == PortOutput || (_captureMode != RouterCaptureRaw && _routingTable.isSourceUsed(source));
+    int budget = readBudget(source, available);
+    _portStats[source].bytesRead += budget;
+    uint32_t timestamp = latencyTimestamp();
+    char buffer[ROUTER_READ_CHUNK_SIZE];
+    while (budget > 0) {
+        int length = budget < ROUTER_READ_CHUNK_SIZE ? budget : ROUTER_READ_CHUNK_SIZE;
+        for (int i = 0; i < length; i++) {
+            buffer[i] = serial->read();
+        }
+        budget -= length;
+        int offset = 0;
+        while (isUsed && offset < length) {
+            bool complete;
+            int consumed = parser.parse(&buffer[offset], length - offset, &complete);
+            // Everything read in one pass gets the same timestamp, only the passes sentences start in matter
+            for (int i = offset; i < offset + consumed; i++) {
+                if (nmeaIsSentenceStart(buffer[i])) {
+                    _messageStartTimestamps[source] = timestamp;
+                    break;
+                }
+            }
+            offset += consumed;
+            if (complete) {
+                routeInputMessage(source, parser.message());
+            }
+        }
+    }
+    return true;
+}
+
+bool Router::readSeaTalkPort() {
+    SerialPort *serial = _ports[PortSeaTalk];
+    int available = sampleAvailable(PortSeaTalk, serial);
+    if (available <= 0) {
+        return false;
+    }
+    TRACE_SCOPE(TraceEventRead, PortSeaTalk);
+    bool isUsed = _captureMode != RouterCaptureRaw && _routingTable.isSourceUsed(PortSeaTalk);
+    int budget = readBudget(PortSeaTalk, available);
+    _portStats[PortSeaTalk].bytesRead += budget;
+    uint32_t timestamp = latencyTimestamp();
+    uint16_t buffer[ROUTER_READ_CHUNK_SIZE];
+    while (budget > 0) {
+        int length = budget < ROUTER_READ_CHUNK_SIZE ? budget : ROUTER_READ_CHUNK_SIZE;
+        for (int i = 0; i < length; i++) {
+            buffer[i] = serial->read();
+        }
+        budget -= length;
+        int offset = 0;
+        while (isUsed && offset < length) {
+            bool complete;
+            int consumed = _seaTalkParser.parse(&buffer[offset], length - offset, &complete);
+            for (int i = offset; i < offset + consumed; i++) {
+                if (buffer[i] & 0x100) {
+                    _messageStartTimestamps[PortSeaTalk] = timestamp;
+                }
+            }
+            offset += consumed;
+            // Drop echoes of our own transmissions, the computer already has them and the translators would see them twice
+            if (complete && !_seaTalkEchoFilter.isEcho(_seaTalkParser.message(), _seaTalkParser.messageLength(), _now)) {
+                routeSeaTalkMessage(_seaTalkParser.message(), _seaTalkParser.messageLength());
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,169 @@
+#ifndef Router_h
+#define Router_h
+
+#include "inttypes.h"
+#include "Types.h"
+#include "SerialPort.h"
+#include "SerialBuffers.h"
+#include "NMEAShared.h"
+#include "NMEAParser.h"
+#include "SeaTalkMessage.h"
+#include "SeaTalkParser.h"
+#include "BoatState.h"
+#include "EchoFilter.h"
+#include "MessageQueue.h"
+#include "RoutingTable.h"
+#include "Capture.h"
+#include "LatencyProbe.h"
+#include "Trace.h"
+
+// Bytes are pulled off a port in chunks of this size and handed to the parser in one go
+#define ROUTER_READ_CHUNK_SIZE 32
+// Longest sentence each port's parser keeps, including the line ending and NULL terminator. 83 fits the standard's 82
+// chars, the GPS and computer get more for proprietary sentences and commands. Longer sentences are dropped.
+#ifndef ROUTER_AIS_MESSAGE_CAPACITY
+#define ROUTER_AIS_MESSAGE_CAPACITY 83
+#endif
+#ifndef ROUTER_GPS_MESSAGE_CAPACITY
+#define ROUTER_GPS_MESSAGE_CAPACITY NMEA_MESSAGE_MAX_LENGTH
+#endif
+#ifndef ROUTER_INPUT_MESSAGE_CAPACITY
+#define ROUTER_INPUT_MESSAGE_CAPACITY NMEA_MESSAGE_MAX_LENGTH
+#endif
+#ifndef ROUTER_NMEA_MESSAGE_CAPACITY
+#define ROUTER_NMEA_MESSAGE_CAPACITY 83
+#endif
+// Messages each port's TX queue holds
+#ifndef ROUTER_OUTPUT_TX_QUEUE_COUNT
+#define ROUTER_OUTPUT_TX_QUEUE_COUNT 16
+#endif
+#ifndef ROUTER_NMEA_HIGH_SPEED_TX_QUEUE_COUNT
+#define ROUTER_NMEA_HIGH_SPEED_TX_QUEUE_COUNT 8
+#endif
+#ifndef ROUTER_NMEA_TX_QUEUE_COUNT
+#define ROUTER_NMEA_TX_QUEUE_COUNT 4
+#endif
+#ifndef ROUTER_SEATALK_TX_QUEUE_COUNT
+#define ROUTER_SEATALK_TX_QUEUE_COUNT 8
+#endif
+// Capture records waiting to go out to the computer. USB drains it far faster than all the ports together can fill it.
+#define ROUTER_CAPTURE_BUFFER_SIZE 2048
+
+typedef enum {
+    RouterCaptureOff = 0,
+    // Route as usual and stream a capture of every port to the computer, sentences for the computer are in it as OUTPUT writes
+    RouterCaptureOn,
+    // Only capture, nothing is parsed or routed apart from commands from the computer
+    RouterCaptureRaw
+} RouterCaptureMode;
+
+//! What poll() has seen of a port's RX buffer, sampled once a pass before reading it
+typedef struct {
+    uint32_t bytesRead;
+    //! Most bytes waiting at the start of a pass
+    uint16_t highWater;
+    //! Passes that found the RX buffer full, so bytes were probably lost. The Teensy's UART drivers don't count overflows.
+    uint32_t fullPasses;
+} RouterPortStats;
+
+//! Routes whose latency is measured end to end
+typedef enum {
+    // RMB from the computer to NavigationToWaypoint (0x85) on SeaTalk, what the autopilot steers by
+    RouterLatencyRMBToSeaTalk = 0,
+    // Wind angle (0x10) from SeaTalk to $WIMWV for the computer
+    RouterLatencyWindToMWV,
+    RouterLatencyRouteCount
+} RouterLatencyRoute;
+
+/*!
+Reads sentences and datagrams from every port, translates them, and queues them for the ports the RoutingTable sends
+them to. Knows nothing about the hardware, ports are attached with setPort() and the clock is passed in to poll().
+*/
+class Router
+{
+public:
+    Router();
+    //! Attaches the port for a Port. Ports that aren't attached are skipped.
+    void setPort(Port port, SerialPort *serial);
+    //! For a port whose RX buffer isn't the size in SerialBuffers.h. Sets when a port is drained and counted as full.
+    void setRxBufferSize(Port port, int size);
+    //! One pass of the main loop. Reads each port up to its budget, routes complete messages, and hands as much of the TX queues to the ports as they can take. Returns true if anything was read.
+    bool poll(uint32_t now);
+    //! Handles a $PHLM command from the computer
+    void handleCommand(const char *message);
+    RoutingTable *routingTable() { return &_routingTable; }
+    BoatState *boatState() { return &_boatState; }
+    EchoFilter *seaTalkEchoFilter() { return &_seaTalkEchoFilter; }
+    //! Messages the TX queue of a port had to drop
+    uint32_t txDropCount(Port port);
+    /*!
+    Starts or stops streaming a capture (see Capture.h) to the computer in place of the usual output. The stream starts
+    with the capture header and ends with an end record, after which the usual output resumes.
+    */
+    void setCaptureMode(RouterCaptureMode mode);
+    RouterCaptureMode captureMode() { return _captureMode; }
+    //! Capture records lost since capture was turned on because the computer wasn't reading fast enough
+    uint32_t captureDropCount() { return _captureWriter.droppedCount(); }
+    LatencyProbe *latencyProbe(RouterLatencyRoute route) { return _latencyProbes[route]; }
+    const RouterPortStats *portStats(Port port) { return &_portStats[port]; }
+private:
+    void sendNMEAMessage(const char *message, uint8_t destinations, Port origin);
+    void sendQueuedSeaTalkMessages();
+    template <class QueueType>
+    void sendQueuedNMEAMessages(Port port, QueueType &queue);
+    void sendQueuedMessages();
+    void sendTraceDump();
+    int txSpace(Port port, SerialPort *serial);
+    void txWritten(Port port, int length);
+    void messageWritten(Port port, uint32_t type);
+    void routeNMEAMessage(Port source, const char *message);
+    void routeSeaTalkMessage(const uint8_t *message, int messageLength);
+    void routeInputMessage(Port source, const char *message);
+    int sampleAvailable(Port port, SerialPort *serial);
+    int readBudget(Port port, int available);
+    bool readNMEAPort(Port source, BaseNMEAParser &parser);
+    bool readSeaTalkPort();
+    void streamCapture();
+
+    // The ports poll() uses, which are the ports from setPort() or the capture ports wrapping them
+    SerialPort *_ports[PortCount];
+    SerialPort *_serialPorts[PortCount];
+    SizedNMEAParser<ROUTER_GPS_MESSAGE_CAPACITY> _gpsParser;
+    SizedNMEAParser<ROUTER_AIS_MESSAGE_CAPACITY> _aisParser;
+    SizedNMEAParser<ROUTER_INPUT_MESSAGE_CAPACITY> _inputParser;
+    SizedNMEAParser<ROUTER_NMEA_MESSAGE_CAPACITY> _nmeaParser;
+    SeaTalkParser _seaTalkParser;
+    BoatState _boatState;
+    // Everything we write to SeaTalk comes back on RX, remember what we sent so we don't route it again
+    EchoFilter _seaTalkEchoFilter;
+    // Messages waiting to go out on each port, tagged with the port they came from. Nothing ever blocks on a full TX buffer.
+    // The computer and radio want everything, so make room for new data. The slow ports only need the latest of each sentence or datagram.
+    MessageQueue<NMEA_MESSAGE_MAX_LENGTH, ROUTER_OUTPUT_TX_QUEUE_COUNT> _outputTxQueue;
+    MessageQueue<NMEA_MESSAGE_MAX_LENGTH, ROUTER_NMEA_HIGH_SPEED_TX_QUEUE_COUNT> _nmeaHighSpeedTxQueue;
+    MessageQueue<NMEA_MESSAGE_MAX_LENGTH, ROUTER_NMEA_TX_QUEUE_COUNT> _nmeaTxQueue;
+    MessageQueue<SEATALK_MESSAGE_MAX_LENGTH, ROUTER_SEATALK_TX_QUEUE_COUNT> _seaTalkTxQueue;
+    // Which sentences and datagrams go where. Starts out with the defaults, can be changed from the computer with $PHLM,ROUTE commands
+    RoutingTable _routingTable;
+    uint8_t _captureBuffer[ROUTER_CAPTURE_BUFFER_SIZE];
+    CaptureWriter _captureWriter;
+    CaptureSerialPort _capturePorts[PortCount];
+    RouterCaptureMode _captureMode;
+    // Still sending the capture to the computer, it carries on for a bit after capture is turned off
+    bool _isStreamingCapture;
+    LatencyProbe _rmbLatencyProbe;
+    LatencyProbe _windLatencyProbe;
+    LatencyProbe *_latencyProbes[RouterLatencyRouteCount];
+    // When the message each parser is working on started arriving, as a latencyTimestamp()
+    uint32_t _messageStartTimestamps[PortCount];
+    // TX buffer space left after our last write to each port, -1 if we haven't looked yet, and how much of what we wrote is still in there
+    int _txSpace[PortCount];
+    uint32_t _txBacklog[PortCount];
+    RouterPortStats _portStats[PortCount];
+    int _rxBufferSizes[PortCount];
+    // Where the $PHLM,TRACE dump in progress is up to
+    bool _isDumpingTrace;
+    uint32_t _traceDumpOffset;
+    uint32_t _now;
+};
+
+#endif
@@ -0,0 +1,403 @@
+#include "RoutingTable.h"
+#include "NMEAShared.h"
+#include "NMEAMessage.h"
+#include <cstring>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+typedef struct {
+    const char *name;
+    bool readsSeaTalk;
+    bool writesSeaTalk;
+    //! Worth running even with no destinations
+    bool updatesBoatState;
+} RouteTransformInfo;
+
+static const RouteTransformInfo transformInfo[RouteTransformCount] = {
+    {"NONE", false, false, false},
+    {"SEATALKTOSEA", true, false, false},
+    {"RMCTOSEATALK", false, true, false},
+    {"RMBTOSEATALK", false, true, false},
+    {"APBTOSEATALK", false, true, false},
+    {"RMCVARIATION", false, true, true},
+    {"SEATOSEATALK", false, true, false},
+    {"WINDANGLETOMWV", true, false, true},
+    {"WINDSPEED", true, false, true},
+    {"DEPTHTODBT", true, false, false},
+    {"SPEEDTOVHW", true, false, false},
+    {"HEADINGTOHDM", true, false, false},
+};
+
+static const char *portNames[PortCount] = {"OUTPUT", "NMEAHS", "NMEA", "SEATALK", "GPS"};
+
+
+// The routes that used to be hard coded in loop()
+static const Route defaultRoutes[] = {
+    // AIS to the computer
+    {PortNMEAHighSpeed, RouteFilterAll, 0, RouteTransformNone, PORT_MASK(PortOutput), true},
+    // GPS to the computer and the radio
+    {PortGPS, RouteFilterAll, 0, RouteTransformNone, PORT_MASK(PortOutput) | PORT_MASK(PortNMEAHighSpeed), true},
+    // GPS to the low speed NMEA port, without GSV since the baud rate is lower
+    {PortGPS, RouteFilterAllExcept, NMEA_TYPE('G', 'S', 'V'), RouteTransformNone, PORT_MASK(PortNMEA), false},
+    // Push location messages out over SeaTalk
+    {PortGPS, RouteFilterType, NMEA_TYPE('R', 'M', 'C'), RouteTransformRMCToSeaTalk, PORT_MASK(PortSeaTalk), true},
+    // Route APB and RMB info from the computer to the SeaTalk network
+    {PortOutput, RouteFilterType, NMEA_TYPE('R', 'M', 'B'), RouteTransformRMBToSeaTalk, PORT_MASK(PortSeaTalk), true},
+    {PortOutput, RouteFilterType, NMEA_TYPE('A', 'P', 'B'), RouteTransformAPBToSeaTalk, PORT_MASK(PortSeaTalk), true},
+    {PortOutput, RouteFilterType, NMEA_TYPE('R', 'M', 'C'), RouteTransformRMCToVariation, PORT_MASK(PortSeaTalk), true},
+    {PortOutput, RouteFilterType, NMEA_TYPE('S', 'E', 'A'), RouteTransformSEAToSeaTalk, PORT_MASK(PortSeaTalk), true},
+    // Raw SeaTalk to the computer
+    {PortSeaTalk, RouteFilterAll, 0, RouteTransformSeaTalkToSEA, PORT_MASK(PortOutput), true},
+    // SeaTalk instruments to NMEA
+    {PortSeaTalk, RouteFilterType, 0x10, RouteTransformWindAngleToMWV, PORT_MASK(PortOutput), true},
+    {PortSeaTalk, RouteFilterType, 0x11, RouteTransformWindSpeed, 0, true},
+    {PortSeaTalk, RouteFilterType, 0x00, RouteTransformDepthToDBT, PORT_MASK(PortOutput), true},
+    {PortSeaTalk, RouteFilterType, 0x20, RouteTransformSpeedToVHW, PORT_MASK(PortOutput), true},
+    {PortSeaTalk, RouteFilterType, 0x9C, RouteTransformHeadingToHDM, PORT_MASK(PortOutput), true},
+};
+
+
+RoutingTable::RoutingTable() {
+    loadDefaults();
+}
+
+void RoutingTable::loadDefaults() {
+    clear();
+    for (size_t i = 0; i < sizeof(defaultRoutes) / sizeof(defaultRoutes[0]); i++) {
+        _routes[_routeCount++] = defaultRoutes[i];
+    }
+    compile();
+}
+
+void RoutingTable::clear() {
+    _routeCount = 0;
+    compile();
+}
+
+int RoutingTable::addRoute(Port source, RouteFilter filter, uint32_t type, RouteTransform transform, uint8_t destinations) {
+    if (_routeCount >= ROUTE_TABLE_SIZE || source >= PortCount || transform >= RouteTransformCount) {
+        return -1;
+    }
+    // Transforms only understand one kind of input, and SeaTalk datagrams can't be forwarded untouched to NMEA ports
+    bool sourceIsSeaTalk = source == PortSeaTalk;
+    if (transformInfo[transform].readsSeaTalk != sourceIsSeaTalk || (transform == RouteTransformNone && sourceIsSeaTalk)) {
+        return -1;
+    }
+    if (transformInfo[transform].writesSeaTalk) {
+        destinations &= PORT_MASK(PortSeaTalk);
+    } else {
+        destinations &= ~PORT_MASK(PortSeaTalk);
+    }
+    if (!destinations && !transformInfo[transform].updatesBoatState) {
+        return -1;
+    }
+    Route *route = &_routes[_routeCount];
+    route->source = source;
+    route->filter = filter;
+    route->type = type;
+    route->transform = transform;
+    route->destinations = destinations;
+    route->enabled = true;
+    _routeCount++;
+    if (!compile()) {
+        // Leave the table as it was rather than running part of what was asked for
+        _routeCount--;
+        compile();
+        return -1;
+    }
+    return _routeCount - 1;
+}
+
+bool RoutingTable::removeRoute(int index) {
+    if (index < 0 || index >= _routeCount) {
+        return false;
+    }
+    memmove(&_routes[index], &_routes[index + 1], (_routeCount - index - 1) * sizeof(Route));
+    _routeCount--;
+    compile();
+    return true;
+}
+
+bool RoutingTable::setRouteEnabled(int index, bool enabled) {
+    if (index < 0 || index >= _routeCount) {
+        return false;
+    }
+    bool wasEnabled = _routes[index].enabled;
+    _routes[index].enabled = enabled;
+    if (!compile()) {
+        _routes[index].enabled = wasEnabled;
+        compile();
+        return false;
+    }
+    return true;
+}
+
+bool RoutingTable::addAction(RouteDispatch *dispatch, uint8_t transform, uint8_t destinations) {
+    // Routes sharing a transform share the work, the output just goes to more places
+    for (int i = 0; i < dispatch->actionCount; i++) {
+        if (dispatch->actions[i].transform == transform) {
+            dispatch->actions[i].destinations |= destinations;
+            return true;
+        }
+    }
+    if (dispatch->actionCount >= ROUTE_MAX_ACTIONS) {
+        return false;
+    }
+    dispatch->actions[dispatch->actionCount].transform = transform;
+    dispatch->actions[dispatch->actionCount].destinations = destinations;
+    dispatch->actionCount++;
+    return true;
+}
+
+bool RoutingTable::addMatchingActions(RouteDispatch *dispatch, Port source, bool isDefault) {
+    bool complete = true;
+    dispatch->actionCount = 0;
+    for (int i = 0; i < _routeCount; i++) {
+        Route *route = &_routes[i];
+        if (!route->enabled || route->source != source) {
+            continue;
+        }
+        bool matches;
+        switch (route->filter) {
+            case RouteFilterType:
+                matches = !isDefault && route->type == dispatch->type;
+                break;
+            case RouteFilterAllExcept:
+                matches = isDefault || route->type != dispatch->type;
+                break;
+            default:
+                matches = true;
+                break;
+        }
+        if (matches) {
+            if (addAction(dispatch, route->transform, route->destinations)) {
+                _transformsInUse |= (1UL << route->transform);
+            } else {
+                complete = false;
+            }
+        }
+    }
+    return complete;
+}
+
+bool RoutingTable::compile() {
+    bool complete = true;
+    _transformsInUse = 0;
+    for (int source = 0; source < PortCount; source++) {
+        // Every type mentioned by a filter gets its own dispatch, sorted by type for the lookup
+        int count = 0;
+        for (int i = 0; i < _routeCount; i++) {
+            Route *route = &_routes[i];
+            if (!route->enabled || route->source != source || route->filter == RouteFilterAll) {
+                continue;
+            }
+            int j = 0;
+            while (j < count && _sourceDispatch[source][j].type < route->type) {
+                j++;
+            }
+            if (j < count && _sourceDispatch[source][j].type == route->type) {
+                continue;
+            }
+            if (count >= ROUTE_MAX_TYPES_PER_SOURCE) {
+                complete = false;
+                continue;
+            }
+            memmove(&_sourceDispatch[source][j + 1], &_sourceDispatch[source][j], (count - j) * sizeof(RouteDispatch));
+            _sourceDispatch[source][j].type = route->type;
+            count++;
+        }
+        _sourceDispatchCount[source] = count;
+        for (int j = 0; j < count; j++) {
+            complete &= addMatchingActions(&_sourceDispatch[source][j], (Port)source, false);
+        }
+        _defaultDispatch[source].type = 0;
+        complete &= addMatchingActions(&_defaultDispatch[source], (Port)source, true);
+    }
+    return complete;
+}
+
+const RouteDispatch *RoutingTable::dispatch(Port source, uint32_t type) {
+    // Binary search of the types this source filters on, everything else gets the default
+    int low = 0;
+    int high = _sourceDispatchCount[source] - 1;
+    while (low <= high) {
+        int middle = (low + high) / 2;
+        uint32_t middleType = _sourceDispatch[source][middle].type;
+        if (middleType == type) {
+            return &_sourceDispatch[source][middle];
+        } else if (middleType < type) {
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return &_defaultDispatch[source];
+}
+
+const char *RoutingTable::portName(Port port) {
+    return port < PortCount ? portNames[port] : "";
+}
+
+const char *RoutingTable::transformName(RouteTransform transform) {
+    return transform < RouteTransformCount ? transformInfo[transform].name : "";
+}
+
+bool RoutingTable::transformReadsSeaTalk(RouteTransform transform) {
+    return transform < RouteTransformCount && transformInfo[transform].readsSeaTalk;
+}
+
+static int portFromName(const char *name, size_t length) {
+    for (int i = 0; i < PortCount; i++) {
+        if (strlen(portNames[i]) == length && strncmp(portNames[i], name, length) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int transformFromName(const char *name) {
+    for (int i = 0; i < RouteTransformCount; i++) {
+        if (strcmp(transformInfo[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#define ROUTE_COMMAND_MAX_FIELDS 8
+
+bool RoutingTable::applyCommand(const char *message) {
+    if (strncmp(message, "$PHLM,ROUTE,", 12) != 0) {
+        return false;
+    }
+    // Split a copy of the sentence in place, the fields point into it
+    char buffer[NMEA_MESSAGE_MAX_LENGTH];
+    strncpy(buffer, &message[12], sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = 0;
+    char *fields[ROUTE_COMMAND_MAX_FIELDS];
+    int fieldCount = 0;
+    fields[fieldCount++] = buffer;
+    for (char *c = buffer; *c; c++) {
+        if (*c == '*' || *c == '\r' || *c == '\n') {
+            *c = 0;
+            break;
+        }
+        if (*c == ',') {
+            *c = 0;
+            if (fieldCount >= ROUTE_COMMAND_MAX_FIELDS) {
+                return false;
+            }
+            fields[fieldCount++] = c + 1;
+        }
+    }
+
+    const char *command = fields[0];
+    if (strcmp(command, "DEFAULTS") == 0) {
+        loadDefaults();
+        return true;
+    } else if (strcmp(command, "CLEAR") == 0) {
+        clear();
+        return true;
+    } else if (fieldCount == 2 && strcmp(command, "DEL") == 0) {
+        return removeRoute(atoi(fields[1]));
+    } else if (fieldCount == 2 && strcmp(command, "ON") == 0) {
+        return setRouteEnabled(atoi(fields[1]), true);
+    } else if (fieldCount == 2 && strcmp(command, "OFF") == 0) {
+        return setRouteEnabled(atoi(fields[1]), false);
+    } else if (fieldCount == 5 && strcmp(command, "ADD") == 0) {
+        int source = portFromName(fields[1], strlen(fields[1]));
+        int transform = transformFromName(fields[3]);
+        if (source < 0 || transform < 0) {
+            return false;
+        }
+        const char *filterString = fields[2];
+        RouteFilter filter = RouteFilterType;
+        uint32_t type = 0;
+        if (filterString[0] == '*') {
+            filter = RouteFilterAll;
+        } else {
+            if (filterString[0] == '!') {
+                filter = RouteFilterAllExcept;
+                filterString++;
+            }
+            if (source == PortSeaTalk) {
+                uint8_t seaTalkCommand;
+                if (strlen(filterString) != 2 || asciiHexToBinary(filterString, 2, &seaTalkCommand) != 1) {
+                    return false;
+                }
+                type = seaTalkCommand;
+            } else {
+                if (strlen(filterString) != 3) {
+                    return false;
+                }
+                type = NMEA_TYPE(filterString[0], filterString[1], filterString[2]);
+            }
+        }
+        // Destinations are joined with '+', e.g. OUTPUT+NMEAHS
+        uint8_t destinations = 0;
+        const char *destination = fields[4];
+        while (*destination) {
+            const char *end = strchr(destination, '+');
+            size_t length = end ? (size_t)(end - destination) : strlen(destination);
+            int port = portFromName(destination, length);
+            if (port < 0) {
+                return false;
+            }
+            destinations |= PORT_MASK(port);
+            destination += length + (end ? 1 : 0);
+        }
+        return addRoute((Port)source, filter, type, (RouteTransform)transform, destinations) >= 0;
+    }
+    return false;
+}
+
+void RoutingTable::describeRoute(int index, char *output, size_t outputSize) {
+    const Route *route = this->route(index);
+    if (!route || outputSize < NMEA_MESSAGE_MAX_LENGTH) {
+        output[0] = 0;
+        return;
+    }
+    char filter[5];
+    if (route->filter == RouteFilterAll) {
+        strcpy(filter, "*");
+    } else {
+        char *type = filter;
+        if (route->filter == RouteFilterAllExcept) {
+            *type++ = '!';
+        }
+        if (route->source == PortSeaTalk) {
+            uint8_t command = route->type;
+            type += binaryToAsciiHex(&command, 1, type);
+        } else {
+            *type++ = (route->type >> 16) & 0xFF;
+            *type++ = (route->type >> 8) & 0xFF;
+            *type++ = route->type & 0xFF;
+        }
+        *type = 0;
+    }
+    char destinations[50];
+    destinations[0] = 0;
+    for (int port = 0; port < PortCount; port++) {
+        if (route->destinations & PORT_MASK(port)) {
+            if (destinations[0]) {
+                strcat(destinations, "+");
+            }
+            strcat(destinations, portNames[port]);
+        }
+    }
+    snprintf(output, outputSize - 5, "$PHLM,ROUTE,%d,%s,%s,%s,%s,%d", index, portNames[route->source], filter, transformInfo[route->transform].name, destinations, route->enabled ? 1 : 0);
+    closeMessage(output);
+}
+
+void RoutingTable::describeTransformsInUse(char *output, size_t outputSize) {
+    size_t length = snprintf(output, outputSize, "$PHLM,TRANSFORMS");
+    for (int i = 0; i < RouteTransformCount; i++) {
+        if ((_transformsInUse & (1UL << i)) && length + strlen(transformInfo[i].name) + 6 < outputSize) {
+            output[length++] = ',';
+            strcpy(&output[length], transformInfo[i].name);
+            length += strlen(transformInfo[i].name);
+        }
+    }
+    closeMessage(output);
+}
@@ -0,0 +1,125 @@
+#ifndef RoutingTable_h
+#define RoutingTable_h
+
+#include "inttypes.h"
+#include <stddef.h>
+#include "Types.h"
+
+#define ROUTE_TABLE_SIZE 24
+//! Distinct sentence types or datagram commands that can be filtered on per source
+#define ROUTE_MAX_TYPES_PER_SOURCE 8
+//! Distinct transforms a single sentence or datagram can fan out to. 6 fits every transform of either kind of input.
+#ifndef ROUTE_MAX_ACTIONS
+#define ROUTE_MAX_ACTIONS 6
+#endif
+
+//! What a route does to a sentence or datagram on the way from its source to its destinations
+typedef enum {
+    RouteTransformNone = 0,             //!< Forward untouched
+    RouteTransformSeaTalkToSEA,         //!< Wrap a SeaTalk datagram in a $STSEA sentence
+    RouteTransformRMCToSeaTalk,         //!< Position, SOG, course, date and time datagrams from RMC
+    RouteTransformRMBToSeaTalk,         //!< Navigation to waypoint datagram from RMB
+    RouteTransformAPBToSeaTalk,         //!< Target waypoint name and arrival info datagrams from APB
+    RouteTransformRMCToVariation,       //!< Magnetic variation from RMC, also set on the autopilot once a minute
+    RouteTransformSEAToSeaTalk,         //!< Unwrap a $STSEA sentence onto the SeaTalk bus
+    RouteTransformWindAngleToMWV,
+    RouteTransformWindSpeed,            //!< Only updates the boat state
+    RouteTransformDepthToDBT,
+    RouteTransformSpeedToVHW,
+    RouteTransformHeadingToHDM,
+    RouteTransformCount
+} RouteTransform;
+
+typedef enum {
+    RouteFilterAll = 0,                 //!< Every sentence or datagram from the source
+    RouteFilterType,                    //!< Only the given sentence type or datagram command
+    RouteFilterAllExcept                //!< Everything but the given sentence type or datagram command
+} RouteFilter;
+
+typedef struct {
+    uint8_t source;
+    uint8_t filter;
+    //! NMEA sentence type packed by nmeaMessageType(), or SeaTalk command byte
+    uint32_t type;
+    uint8_t transform;
+    //! Bitmask of (1 << Port)
+    uint8_t destinations;
+    bool enabled;
+} Route;
+
+typedef struct {
+    uint8_t transform;
+    uint8_t destinations;
+} RouteAction;
+
+//! Everything that has to happen to one sentence type or datagram command from one source
+typedef struct {
+    uint32_t type;
+    uint8_t actionCount;
+    RouteAction actions[ROUTE_MAX_ACTIONS];
+} RouteDispatch;
+
+#define PORT_MASK(port) (1 << (port))
+#define NMEA_TYPE(a, b, c) (((uint32_t)(a) << 16) | ((uint32_t)(b) << 8) | (uint32_t)(c))
+
+//! Packs the 3 char sentence type of an NMEA message ("$GPRMC" -> "RMC") for comparison with Route.type
+inline uint32_t nmeaMessageType(const char *message) {
+    return ((uint32_t)message[3] << 16) | ((uint32_t)message[4] << 8) | (uint32_t)message[5];
+}
+
+/*!
+Table of routes from source ports to destination ports. compile() turns the table into per source dispatch arrays so
+each incoming sentence or datagram needs a single lookup to find everything that should happen to it.
+*/
+class RoutingTable
+{
+public:
+    RoutingTable();
+    //! Replaces the table with the built in routes
+    void loadDefaults();
+    void clear();
+    //! Adds a route, returns its index or -1 if the table is full, the route makes no sense or it doesn't fit in the compiled table
+    int addRoute(Port source, RouteFilter filter, uint32_t type, RouteTransform transform, uint8_t destinations);
+    bool removeRoute(int index);
+    //! Returns false, leaving the route as it was, if enabling it wouldn't fit in the compiled table
+    bool setRouteEnabled(int index, bool enabled);
+    int routeCount() { return _routeCount; }
+    const Route *route(int index) { return index >= 0 && index < _routeCount ? &_routes[index] : NULL; }
+    //! Rebuilds the dispatch arrays. Returns false if some route didn't fit and was left out.
+    bool compile();
+    //! Actions for a sentence or datagram of the given type, found with one lookup in the compiled table
+    const RouteDispatch *dispatch(Port source, uint32_t type);
+    //! Whether any enabled route reads from the port, if not there's no need to parse it
+    bool isSourceUsed(Port source) { return _sourceDispatchCount[source] > 0 || _defaultDispatch[source].actionCount > 0; }
+    //! Bitmask of (1 << RouteTransform) for the transforms any enabled route runs
+    uint32_t transformsInUse() { return _transformsInUse; }
+    /*!
+    Applies a $PHLM,ROUTE command so routes can be changed without reflashing:
+      $PHLM,ROUTE,ADD,<source>,<filter>,<transform>,<destination>[+<destination>...]
+      $PHLM,ROUTE,DEL,<index>
+      $PHLM,ROUTE,ON,<index> and $PHLM,ROUTE,OFF,<index>
+      $PHLM,ROUTE,DEFAULTS and $PHLM,ROUTE,CLEAR
+    Filters are * for everything, a sentence type (RMC) or hex command (9C), or either prefixed with ! to exclude it.
+    Returns false if the command wasn't understood or the route didn't fit, and the table is left as it was.
+    */
+    bool applyCommand(const char *message);
+    //! Writes route index as a $PHLM,ROUTE sentence, e.g. "$PHLM,ROUTE,3,GPS,RMC,RMCTOSEATALK,SEATALK,1*hh\r\n"
+    void describeRoute(int index, char *output, size_t outputSize);
+    //! Lists the transforms enabled routes run as a $PHLM,TRANSFORMS sentence
+    void describeTransformsInUse(char *output, size_t outputSize);
+    static const char *portName(Port port);
+    static const char *transformName(RouteTransform transform);
+    //! Whether the transform consumes SeaTalk datagrams rather than NMEA sentences
+    static bool transformReadsSeaTalk(RouteTransform transform);
+private:
+    bool addAction(RouteDispatch *dispatch, uint8_t transform, uint8_t destinations);
+    bool addMatchingActions(RouteDispatch *dispatch, Port source, bool isDefault);
+    Route _routes[ROUTE_TABLE_SIZE];
+    int _routeCount;
+    RouteDispatch _sourceDispatch[PortCount][ROUTE_MAX_TYPES_PER_SOURCE];
+    int _sourceDispatchCount[PortCount];
+    RouteDispatch _defaultDispatch[PortCount];
+    uint32_t _transformsInUse;
+};
+
+#endif
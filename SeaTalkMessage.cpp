@@ -1,4 +1,6 @@
 #include "SeaTalkMessage.h"
+#include "Trace.h"
+#include "NMEAShared.h"
 #include <cstring>
 #include "Arduino.h"
 #include "math.h"
@@ -11,6 +13,7 @@ BaseSeaTalkMessage::BaseSeaTalkMessage(int messageLength) {
 }
 
 BaseSeaTalkMessage::BaseSeaTalkMessage(const uint8_t *message, int messageLength) {
+    TRACE_SCOPE(TraceEventSeaTalkDecode, 0);
     _messageLength = messageLength;
     memcpy(_message, message, messageLength);
 }
@@ -23,7 +26,8 @@ SeaTalkMessageType BaseSeaTalkMessage::messageType() {
     return (SeaTalkMessageType)_message[0];
 }
 
-SeaTalkMessageDepth::SeaTalkMessageDepth(double depth) : BaseSeaTalkMessage(this->messageLength()) {
+SeaTalkMessageDepth::SeaTalkMessageDepth(DeciFeet depth) : BaseSeaTalkMessage(this->messageLength()) {
+    TRACE_SCOPE(TraceEventSeaTalkEncode, 0);
     // 00  02  YZ  XX XX  Depth below transducer: XXXX/10 feet 
     //  Flags in Y: Y&8 = 8: Anchor Alarm is active
     //             Y&4 = 4: Metric display units or
@@ -35,12 +39,12 @@ SeaTalkMessageDepth::SeaTalkMessageDepth(double depth) : BaseSeaTalkMessage(this
     _message[0] = 0x00;
     _message[1] = 0x02;
     _message[2] = 0x00;
-    int depthInteger = round(depth * 10);
-    _message[3] = depthInteger & 0xFF;
-    _message[4] = (depthInteger >> 8) & 0xFF;
+    _message[3] = depth & 0xFF;
+    _message[4] = (depth >> 8) & 0xFF;
 }
 
 SeaTalkMessageWaterTemperature::SeaTalkMessageWaterTemperature(int celcius) : BaseSeaTalkMessage(this->messageLength()) {
+    TRACE_SCOPE(TraceEventSeaTalkEncode, 0);
     // 23  Z1  XX  YY  Water temperature (ST50): XX deg Celsius, YY deg Fahrenheit
     //                 Flag Z&4: Sensor defective or not connected (Z=4) 
     //                 Corresponding NMEA sentence: MTW
@@ -50,41 +54,45 @@ SeaTalkMessageWaterTemperature::SeaTalkMessageWaterTemperature(int celcius) : Ba
     _message[3] = (1.8 * celcius) + 32;
 }
 
-float SeaTalkMessageWindAngle::windAngle() {
+DeciDegrees SeaTalkMessageWindAngle::windAngle() {
     // 10  01  XX  YY  Apparent Wind Angle: XXYY/2 degrees right of bow
-    return ((_message[2] << 8) + _message[3]) / 2;
+    return ((_message[2] << 8) + _message[3]) * 5;
 }
 
-float SeaTalkMessageWindSpeed::windSpeed() {
+CentiKnots SeaTalkMessageWindSpeed::windSpeed() {
     // 11  01  XX  0Y  Apparent Wind Speed: (XX & 0x7F) + Y/10 Knots
-    return (_message[2] & 0x7F) + ((float)_message[3] / 10);
+    return (_message[2] & 0x7F) * 100 + (_message[3] & 0xF) * 10;
 }
 
-SeaTalkMessageSpeedThroughWater::SeaTalkMessageSpeedThroughWater(double speed) : BaseSeaTalkMessage(this->messageLength()) {
+SeaTalkMessageSpeedThroughWater::SeaTalkMessageSpeedThroughWater(CentiKnots speed) : BaseSeaTalkMessage(this->messageLength()) {
+    TRACE_SCOPE(TraceEventSeaTalkEncode, 0);
     // 20  01  XX  XX  Speed through water: XXXX/10 Knots 
     _message[0] = 0x20;
     _message[1] = 0x01;
-    int intSpeed = round(speed * 10);
+    int intSpeed = divideRounded(speed, 10);
     _message[2] = intSpeed & 0xFF;
     _message[3] = (intSpeed >> 8) & 0xFF;
 }
 
 SeaTalkMessageLampIntensity::SeaTalkMessageLampIntensity(uint8_t intensity) : BaseSeaTalkMessage(this->messageLength()) {
+    TRACE_SCOPE(TraceEventSeaTalkEncode, 0);
     _message[0] = 0x30;
     _message[1] = 0x00;
     _message[2] = (intensity * 4) & 0xF;
 }
 
-SeaTalkMessageLatitude::SeaTalkMessageLatitude(double latitude) : BaseSeaTalkMessage(this->messageLength()) {
+SeaTalkMessageLatitude::SeaTalkMessageLatitude(Coordinate latitude) : BaseSeaTalkMessage(this->messageLength()) {
+    TRACE_SCOPE(TraceEventSeaTalkEncode, 0);
     // 50  Z2  XX  YY  YY  LAT position: XX degrees, (YYYY & 0x7FFF)/100 minutes 
     // MSB of Y = YYYY & 0x8000 = South if set, North if cleared
     _message[0] = 0x50;
     _message[1] = 0x02;
     bool south = latitude < 0;
-    latitude = fabs(latitude);
-    int degrees = (int)latitude;
+    latitude = abs(latitude);
+    int degrees = latitude / COORDINATE_UNITS_PER_DEGREE;
     _message[2] = degrees;
-    int minutes = (latitude - degrees) * 60 * 100;
+    // Hundredths of a minute, truncated
+    int minutes = (latitude - degrees * COORDINATE_UNITS_PER_DEGREE) * 6 / 10000;
     _message[3] = minutes & 0xFF;
     _message[4] = (minutes & 0x7F00) >> 8;
     if (south) {
@@ -92,16 +100,17 @@ SeaTalkMessageLatitude::SeaTalkMessageLatitude(double latitude) : BaseSeaTalkMes
     }
 }
 
-SeaTalkMessageLongitude::SeaTalkMessageLongitude(double longitude) : BaseSeaTalkMessage(this->messageLength()) {
+SeaTalkMessageLongitude::SeaTalkMessageLongitude(Coordinate longitude) : BaseSeaTalkMessage(this->messageLength()) {
+    TRACE_SCOPE(TraceEventSeaTalkEncode, 0);
     // 51  Z2  XX  YY  YY  LON position: XX degrees, (YYYY & 0x7FFF)/100 minutes 
     // MSB of Y = YYYY & 0x8000 = East if set, West if cleared 
     _message[0] = 0x51;
     _message[1] = 0x02;
     bool east = longitude > 0;
-    longitude = fabs(longitude);
-    int degrees = (int)longitude;
+    longitude = abs(longitude);
+    int degrees = longitude / COORDINATE_UNITS_PER_DEGREE;
     _message[2] = degrees;
-    int minutes = (longitude - degrees) * 60 * 100;
+    int minutes = (longitude - degrees * COORDINATE_UNITS_PER_DEGREE) * 6 / 10000;
     _message[3] = minutes & 0xFF;
     _message[4] = (minutes >> 8) & 0x7F;
     if (east) {
@@ -109,33 +118,35 @@ SeaTalkMessageLongitude::SeaTalkMessageLongitude(double longitude) : BaseSeaTalk
     }
 }
 
-SeaTalkMessageSpeedOverGround::SeaTalkMessageSpeedOverGround(double speed) : BaseSeaTalkMessage(this->messageLength()) {
+SeaTalkMessageSpeedOverGround::SeaTalkMessageSpeedOverGround(CentiKnots speed) : BaseSeaTalkMessage(this->messageLength()) {
+    TRACE_SCOPE(TraceEventSeaTalkEncode, 0);
     // 52  01  XX  XX  Speed over Ground: XXXX/10 Knots 
     _message[0] = 0x52;
     _message[1] = 0x01;
-    int intSpeed = (speed * 10);
+    int intSpeed = speed / 10;
     _message[2] = intSpeed & 0xFF;
     _message[3] = (intSpeed >> 8) & 0xFF;
 }
 
-SeaTalkMessageMagneticCourse::SeaTalkMessageMagneticCourse(double course) : BaseSeaTalkMessage(this->messageLength()) {
+SeaTalkMessageMagneticCourse::SeaTalkMessageMagneticCourse(DeciDegrees course) : BaseSeaTalkMessage(this->messageLength()) {
+    TRACE_SCOPE(TraceEventSeaTalkEncode, 0);
     // Round to the nearest 0.5
-    course = roundf(course * 2.0) / 2.0;
+    int halfDegrees = divideRounded(course, 5);
     _message[0] = 0x53;
-    int quadrant = course / 90;
+    int quadrant = halfDegrees / 180;
     _message[1] = ((quadrant & 0x3) << 4);
-    int degreesInQuadrant = floor(course - (quadrant * 90)) / 2;
-    _message[2] = (degreesInQuadrant) & 0x3F;
-    int fraction = 2 * (course - quadrant * 90.0 - 2 * degreesInQuadrant);
-    _message[1] |= ((fraction & 0x3) << 6);
+    int halfDegreesInQuadrant = halfDegrees - quadrant * 180;
+    _message[2] = (halfDegreesInQuadrant / 4) & 0x3F;
+    _message[1] |= ((halfDegreesInQuadrant % 4) << 6);
 }
 
 SeaTalkMessageTime::SeaTalkMessageTime(Time time) : BaseSeaTalkMessage(this->messageLength()) {
+    TRACE_SCOPE(TraceEventSeaTalkEncode, 0);
     // 54  T1  RS  HH  GMT-time: HH hours, 
     // 6 MSBits of RST = minutes = (RS & 0xFC) / 4
     // 6 LSBits of RST = seconds =  ST & 0x3F 
     _message[0] = 0x54;
-    int secondInteger = time.second;
+    int secondInteger = time.millisecond / 1000;
     _message[1] = 0x01 | ((secondInteger & 0xF) << 4);
     _message[2] = 0xFC & (time.minute << 2);
     _message[2] |= 0x03 & ((secondInteger & 0x30) >> 4);
@@ -143,6 +154,7 @@ SeaTalkMessageTime::SeaTalkMessageTime(Time time) : BaseSeaTalkMessage(this->mes
 }
 
 SeaTalkMessageDate::SeaTalkMessageDate(Date date) : BaseSeaTalkMessage(this->messageLength()) {
+    TRACE_SCOPE(TraceEventSeaTalkEncode, 0);
     _message[0] = 0x56;
     _message[1] = 0x1 | ((date.month << 4) & 0xF0);
     _message[2] = date.day;
@@ -158,10 +170,22 @@ Date SeaTalkMessageDate::date() {
 }
 
 SeaTalkMessageTargetWaypointName::SeaTalkMessageTargetWaypointName(const char *name) : BaseSeaTalkMessage(this->messageLength()) {
+    TRACE_SCOPE(TraceEventSeaTalkEncode, 0);
+    encodeName(name, strlen(name));
+}
+
+SeaTalkMessageTargetWaypointName::SeaTalkMessageTargetWaypointName(const char *name, int nameLength) : BaseSeaTalkMessage(this->messageLength()) {
+    TRACE_SCOPE(TraceEventSeaTalkEncode, 0);
+    encodeName(name, nameLength);
+}
+
+void SeaTalkMessageTargetWaypointName::encodeName(const char *name, int nameLength) {
     uint8_t stName[4];
     for (int i = 0; i < 4; i++) {
-        stName[i] = toupper(name[i]) - 0x30;
-        _name[i] = toupper(name[i]);
+        // Past the end of a short name is what its NULL terminator would give
+        char c = i < nameLength ? toupper(name[i]) : 0;
+        stName[i] = c - 0x30;
+        _name[i] = c;
     }
     _name[4] = 0;
     _message[0] = 0x82;
@@ -174,23 +198,23 @@ SeaTalkMessageTargetWaypointName::SeaTalkMessageTargetWaypointName(const char *n
     _message[7] = _message[6] ^ 0xFF;
 }
 
-SeaTalkMessageNavigationToWaypoint::SeaTalkMessageNavigationToWaypoint(float xte, Heading bearingToDestination, float distanceToDestination, Laterality directionToSteer, int trackControlMode) : BaseSeaTalkMessage(this->messageLength()) {
+SeaTalkMessageNavigationToWaypoint::SeaTalkMessageNavigationToWaypoint(CentiNauticalMiles xte, Heading bearingToDestination, CentiNauticalMiles distanceToDestination, Laterality directionToSteer, int trackControlMode) : BaseSeaTalkMessage(this->messageLength()) {
+    TRACE_SCOPE(TraceEventSeaTalkEncode, 0);
     _message[0] = 0x85;
-    int xteInt = xte * 100;
-    _message[1] = ((xteInt & 0xF) << 4) | 0x6;
-    _message[2] = (xteInt >> 4) & 0xFF;
-    int quadrant = bearingToDestination.degrees / 90;
+    _message[1] = ((xte & 0xF) << 4) | 0x6;
+    _message[2] = (xte >> 4) & 0xFF;
+    int quadrant = bearingToDestination.deciDegrees / 900;
     _message[3] = (quadrant & 0x3) | (!bearingToDestination.isMagnetic ? 0x8 : 0);
-    int degreesInQuadrant = (bearingToDestination.degrees - (quadrant * 90)) * 2;
-    _message[3] |= (degreesInQuadrant & 0xF) << 4;
-    _message[4] = (degreesInQuadrant >> 4) & 0xF;
+    int halfDegreesInQuadrant = (bearingToDestination.deciDegrees - (quadrant * 900)) / 5;
+    _message[3] |= (halfDegreesInQuadrant & 0xF) << 4;
+    _message[4] = (halfDegreesInQuadrant >> 4) & 0xF;
     int distanceInt;
     bool lessThan10;
-    if (distanceToDestination < 10.0) {
-        distanceInt = distanceToDestination * 100;
+    if (distanceToDestination < 1000) {
+        distanceInt = distanceToDestination;
         lessThan10 = true;
     } else {
-        distanceInt = distanceToDestination * 10;
+        distanceInt = distanceToDestination / 10;
         lessThan10 = false;
     }
     _message[4] |= (distanceInt & 0xF) << 4;
@@ -202,6 +226,7 @@ SeaTalkMessageNavigationToWaypoint::SeaTalkMessageNavigationToWaypoint(float xte
 }
 
 SeaTalkMessageSetAutopilotParameter::SeaTalkMessageSetAutopilotParameter(int parameterNumber, int parameterValue) : BaseSeaTalkMessage(this->messageLength()) {
+    TRACE_SCOPE(TraceEventSeaTalkEncode, 0);
     _message[0] = 0x92;
     _message[1] = 0x02;
     _message[2] = (parameterNumber & 0xFF);
@@ -210,12 +235,14 @@ SeaTalkMessageSetAutopilotParameter::SeaTalkMessageSetAutopilotParameter(int par
 }
 
 SeaTalkMessageMagneticVariation::SeaTalkMessageMagneticVariation(int variation) : BaseSeaTalkMessage(this->messageLength()) {
+    TRACE_SCOPE(TraceEventSeaTalkEncode, 0);
     _message[0] = 0x99;
     _message[1] = 0x00;
     _message[2] = variation & 0xFF;
 }
 
 SeaTalkMessageCompassHeadingAndRudderPosition::SeaTalkMessageCompassHeadingAndRudderPosition(int compassHeading, bool isTurningRight, int rudderPosition) : BaseSeaTalkMessage(this->messageLength()) {
+    TRACE_SCOPE(TraceEventSeaTalkEncode, 0);
     _message[0] = 0x9C;
     _message[1] = isTurningRight ? 0x41 : 0x01;
     int quadrant = compassHeading / 90;
@@ -226,15 +253,25 @@ SeaTalkMessageCompassHeadingAndRudderPosition::SeaTalkMessageCompassHeadingAndRu
 }
 
 SeaTalkMessageArrivalInfo::SeaTalkMessageArrivalInfo(bool isPerpendicularPassed, bool isArrivalCircleEntered, const char *waypointName) : BaseSeaTalkMessage(this->messageLength()) {
+    TRACE_SCOPE(TraceEventSeaTalkEncode, 0);
+    encode(isPerpendicularPassed, isArrivalCircleEntered, waypointName, strlen(waypointName));
+}
+
+SeaTalkMessageArrivalInfo::SeaTalkMessageArrivalInfo(bool isPerpendicularPassed, bool isArrivalCircleEntered, const char *waypointName, int nameLength) : BaseSeaTalkMessage(this->messageLength()) {
+    TRACE_SCOPE(TraceEventSeaTalkEncode, 0);
+    encode(isPerpendicularPassed, isArrivalCircleEntered, waypointName, nameLength);
+}
+
+void SeaTalkMessageArrivalInfo::encode(bool isPerpendicularPassed, bool isArrivalCircleEntered, const char *waypointName, int nameLength) {
     _message[0] = 0xA2;
     _message[1] = 0x4 | (isPerpendicularPassed ? 0x20 : 0) | (isArrivalCircleEntered ? 0x40 : 0);
-    int nameLength = (int)strlen(waypointName);
     for (int i = 0; i < 4 && i < nameLength; i++) {
         _message[this->messageLength() - i - 1] = toupper(waypointName[nameLength - i - 1]);
     }
 }
 
 SeaTalkMessageDeviceQuery::SeaTalkMessageDeviceQuery() : BaseSeaTalkMessage(this->messageLength()) {
+    TRACE_SCOPE(TraceEventSeaTalkEncode, 0);
     _message[0] = 0xA4;
     _message[1] = 0x02;
     _message[2] = 0x00;
@@ -266,13 +303,71 @@ BaseSeaTalkMessage *newSeaTalkMessage(const uint8_t *message, int messageLength)
     }
 }
 
+// Datagram lengths from Thomas Knauf's SeaTalk reference. Lengths are (attribute & 0xF) + 3, 0 where the length varies or the command isn't documented.
+static const uint8_t seaTalkMessageLengths[256] = {
+//  x0  x1  x2  x3  x4  x5  x6  x7  x8  x9  xA  xB  xC  xD  xE  xF
+     5,  8,  0,  0,  0,  6,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 0x
+     4,  4,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 1x
+     4,  5,  5,  4,  5,  7,  7,  4,  0,  0,  0,  0,  0,  0,  0,  0, // 2x
+     3,  0,  0,  0,  0,  0,  3,  0,  4,  0,  0,  0,  0,  0,  0,  0, // 3x
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 4x
+     5,  5,  4,  3,  4,  4,  4,  3,  8,  5,  0,  0,  0,  0,  0,  0, // 5x
+     0,  6,  0,  0,  0,  3,  3,  0,  4,  0,  0,  0,  8,  0, 10,  0, // 6x
+     3,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 7x
+     3,  0,  8, 10,  9,  9,  4,  3,  6,  5,  0,  0,  0,  0,  0,  0, // 8x
+     3,  3,  5,  3,  0,  9,  0,  0,  0,  3, 12,  0,  4,  0,  0,  0, // 9x
+     0,  0,  7,  0,  0,  0,  0, 12,  6,  0,  0,  0,  0,  0,  0,  0, // Ax
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // Bx
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // Cx
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // Dx
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // Ex
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // Fx
+};
+
+int seaTalkMessageExpectedLength(uint8_t command) {
+    return seaTalkMessageLengths[command];
+}
+
+bool seaTalkMessageIsValid(const uint8_t *message, int messageLength) {
+    if (messageLength < 3 || messageLength != (message[1] & 0x0F) + 3) {
+        return false;
+    }
+    int expectedLength = seaTalkMessageExpectedLength(message[0]);
+    if (expectedLength && messageLength != expectedLength) {
+        return false;
+    }
+    switch (message[0]) {
+        case 0x38:
+            // yy is the inverse of the code lock data YY
+            return (message[2] ^ message[3]) == 0xFF;
+        case 0x55:
+            // yy is the inverse of the TRACK key code YY
+            return (message[2] ^ message[3]) == 0xFF;
+        case 0x82:
+            // XX+xx = YY+yy = ZZ+zz = FF
+            return (message[2] ^ message[3]) == 0xFF && (message[4] ^ message[5]) == 0xFF && (message[6] ^ message[7]) == 0xFF;
+        case 0x85:
+            // yf is the inverse of YF
+            return (message[6] ^ message[8]) == 0xFF;
+        case 0x86:
+            // yy is the inverse of the keystroke code YY
+            return (message[2] ^ message[3]) == 0xFF;
+        default:
+            return true;
+    }
+}
+
 void printSeaTalkMessage(uint8_t *message, int messageLength) {
+    // Formatted as "1XX XX XX\r\n" with the 9th bit shown on the command byte, then written out in one go
+    char output[1 + SEATALK_MESSAGE_MAX_LENGTH * 3 + 3];
+    int outputLength = 0;
+    output[outputLength++] = '1';
     for (int i = 0; i < messageLength; i++) {
-        if (i == 0) {
-            Serial.printf("%03X ", message[i] + 256);
-        } else {
-            Serial.printf("%02X ", message[i]);
-        }
+        outputLength += binaryToAsciiHex(&message[i], 1, &output[outputLength]);
+        output[outputLength++] = ' ';
     }
-    Serial.print("\r\n");
+    output[outputLength++] = '\r';
+    output[outputLength++] = '\n';
+    output[outputLength] = 0;
+    Serial.print(output);
 }
@@ -4,6 +4,9 @@
 #include "inttypes.h"
 #include "Types.h"
 
+//! Two header bytes plus up to 16 data bytes
+#define SEATALK_MESSAGE_MAX_LENGTH 18
+
 typedef enum {
     SeaTalkMessageTypeWindAngle = 0x10,
     SeaTalkMessageTypeWindSpeed = 0x11,
@@ -36,17 +39,16 @@ public:
     int messageLength() { return _messageLength; }
 protected:
     int _messageLength;
-    uint8_t _message[18];
+    uint8_t _message[SEATALK_MESSAGE_MAX_LENGTH];
 };
 
 class SeaTalkMessageDepth : public BaseSeaTalkMessage
 {
 public:
     SeaTalkMessageDepth(const uint8_t *message) : BaseSeaTalkMessage(message, this->messageLength()) {}
-    SeaTalkMessageDepth(double depth);
+    SeaTalkMessageDepth(DeciFeet depth);
     int messageLength() { return 5; }
-    //! Depth in feet
-    double depth() { return (_message[3] + (_message[4] << 8)) / 10.0; }
+    DeciFeet depth() { return _message[3] + (_message[4] << 8); }
     bool isAnchorAlarmActive() { return !!(_message[2] & 0x80); }
     bool isMetricDisplayUnits() { return !!(_message[2] & 0x40); }
     bool isTransducerDefective() { return !!(_message[2] & 0x04); }
@@ -70,7 +72,7 @@ class SeaTalkMessageWindAngle : public BaseSeaTalkMessage
 public:
     SeaTalkMessageWindAngle(const uint8_t *message) : BaseSeaTalkMessage(message, this->messageLength()) {}
     int messageLength() { return 4; }
-    float windAngle();
+    DeciDegrees windAngle();
 };
 
 class SeaTalkMessageWindSpeed : public BaseSeaTalkMessage
@@ -78,17 +80,16 @@ class SeaTalkMessageWindSpeed : public BaseSeaTalkMessage
 public:
     SeaTalkMessageWindSpeed(const uint8_t *message) : BaseSeaTalkMessage(message, this->messageLength()) {}
     int messageLength() { return 4; }
-    float windSpeed();
+    CentiKnots windSpeed();
 };
 
 class SeaTalkMessageSpeedThroughWater : public BaseSeaTalkMessage
 {
 public:
     SeaTalkMessageSpeedThroughWater(const uint8_t *message) : BaseSeaTalkMessage(message, this->messageLength()) {}
-    SeaTalkMessageSpeedThroughWater(double speed);
+    SeaTalkMessageSpeedThroughWater(CentiKnots speed);
     int messageLength() { return 4; }
-    //! Speed in knots
-    double speed() { return (_message[2] + (_message[3] << 8)) / 10.0; }
+    CentiKnots speed() { return (_message[2] + (_message[3] << 8)) * 10; }
 };
 
 class SeaTalkMessageLampIntensity : public BaseSeaTalkMessage
@@ -104,21 +105,21 @@ public:
 class SeaTalkMessageLatitude : public BaseSeaTalkMessage
 {
 public:
-    SeaTalkMessageLatitude(double latitude);
+    SeaTalkMessageLatitude(Coordinate latitude);
     int messageLength() { return 5; }
 };
 
 class SeaTalkMessageLongitude : public BaseSeaTalkMessage
 {
 public:
-    SeaTalkMessageLongitude(double longitude); 
+    SeaTalkMessageLongitude(Coordinate longitude);
     int messageLength() { return 5; }
 };
 
 class SeaTalkMessageSpeedOverGround : public BaseSeaTalkMessage
 {
 public:
-    SeaTalkMessageSpeedOverGround(double speed);
+    SeaTalkMessageSpeedOverGround(CentiKnots speed);
     int messageLength() { return 4; }
 };
 
@@ -132,9 +133,9 @@ class SeaTalkMessageMagneticCourse : public BaseSeaTalkMessage
 {
 public:
     SeaTalkMessageMagneticCourse(const uint8_t *message) : BaseSeaTalkMessage(message, this->messageLength()) {}
-    SeaTalkMessageMagneticCourse(double course);
+    SeaTalkMessageMagneticCourse(DeciDegrees course);
     int messageLength() { return 3; }
-    float course() { return ((_message[1] & 0x30) >> 4) * 90.0 + (_message[2] & 0x3F) * 2.0 + ((_message[1] & 0xC0) >> 6) / 2.0; };
+    DeciDegrees course() { return ((_message[1] & 0x30) >> 4) * 900 + (_message[2] & 0x3F) * 20 + ((_message[1] & 0xC0) >> 6) * 5; };
 };
 
 class SeaTalkMessageTime : public BaseSeaTalkMessage
@@ -165,6 +166,8 @@ class SeaTalkMessageTargetWaypointName : public BaseSeaTalkMessage
 {
 public:
     SeaTalkMessageTargetWaypointName(const char *name);
+    //! Name that isn't NULL terminated, like an NMEAFragment
+    SeaTalkMessageTargetWaypointName(const char *name, int nameLength);
     SeaTalkMessageTargetWaypointName(const uint8_t *message) : BaseSeaTalkMessage(message, this->messageLength()) { _name[0] = 0; }
     int messageLength() { return 8; }
     char *name() {
@@ -178,6 +181,7 @@ public:
         return _name;
     }
 private:
+    void encodeName(const char *name, int nameLength);
     char _name[5];
 };
 
@@ -264,19 +268,20 @@ class SeaTalkMessageNavigationToWaypoint : public BaseSeaTalkMessage
 {
 public:
     SeaTalkMessageNavigationToWaypoint(const uint8_t *message) : BaseSeaTalkMessage(message, this->messageLength()) {}
-    SeaTalkMessageNavigationToWaypoint(float xte, Heading bearingToDestination, float distanceToDestination, Laterality directionToSteer, int trackControlMode);
+    SeaTalkMessageNavigationToWaypoint(CentiNauticalMiles xte, Heading bearingToDestination, CentiNauticalMiles distanceToDestination, Laterality directionToSteer, int trackControlMode);
     int messageLength() { return 9; }
 
-    float xte() { return (((_message[1] >> 4) & 0xF) + (_message[2] << 4)) / 100.0; }
+    CentiNauticalMiles xte() { return ((_message[1] >> 4) & 0xF) + (_message[2] << 4); }
     Heading bearingToDestination() {
         Heading heading;
-        heading.degrees = ((_message[3] & 0x3) * 90) + (((_message[3] >> 4) & 0xF) + ((_message[4] << 4) & 0xF0)) / 2.0;
+        heading.deciDegrees = ((_message[3] & 0x3) * 900) + (((_message[3] >> 4) & 0xF) + ((_message[4] << 4) & 0xF0)) * 5;
         heading.isMagnetic = !(_message[3] & 0x8);
         return heading;
     }
-    float distanceToDestination() {
-        float multiplier = _message[6] & 0x10 ? 100.0 : 10.0;
-        return (((_message[4] >> 4) & 0xF) + ((_message[5] << 4) & 0xFF0)) / multiplier;
+    //! Hundredths of a mile under 10 miles, tenths above
+    CentiNauticalMiles distanceToDestination() {
+        int multiplier = _message[6] & 0x10 ? 1 : 10;
+        return (((_message[4] >> 4) & 0xF) + ((_message[5] << 4) & 0xFF0)) * multiplier;
     }
     Laterality directionToSteer() {
         return _message[6] & 0x40 ? LateralityRight : LateralityLeft;
@@ -372,12 +377,15 @@ class SeaTalkMessageArrivalInfo : public BaseSeaTalkMessage
 public:
     SeaTalkMessageArrivalInfo(const uint8_t *message) : BaseSeaTalkMessage(message, this->messageLength()) {}
     SeaTalkMessageArrivalInfo(bool isPerpendicularPassed, bool isArrivalCircleEntered, const char *waypointName);
+    SeaTalkMessageArrivalInfo(bool isPerpendicularPassed, bool isArrivalCircleEntered, const char *waypointName, int nameLength);
     int messageLength() { return 7; }
     bool isPerpendicularPassed() { return _message[1] & 0x20; }
     bool isArrivalCircleEntered() { return _message[1] & 0x40; }
     char *name() {
         return (char *)&_message[3];
     }
+private:
+    void encode(bool isPerpendicularPassed, bool isArrivalCircleEntered, const char *waypointName, int nameLength);
 };
 
 
@@ -390,6 +398,12 @@ public:
 
 BaseSeaTalkMessage *newSeaTalkMessage(const uint8_t *message, int messageLength);
 
+//! Total length in bytes of datagrams with the given command byte, or 0 if the length is variable or unknown
+int seaTalkMessageExpectedLength(uint8_t command);
+
+//! Checks the length and, for datagrams that carry them, the redundancy bytes (e.g. XX+xx=FF in 0x82)
+bool seaTalkMessageIsValid(const uint8_t *message, int messageLength);
+
 void printSeaTalkMessage(uint8_t *message, int messageLength);
 
 #endif
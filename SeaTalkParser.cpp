@@ -1,5 +1,6 @@
 #include "SeaTalkParser.h"
 #include <cstring>
+#include "Trace.h"
 #include "Arduino.h"
 
 
@@ -12,20 +13,26 @@ typedef enum {
 
 
 SeaTalkParser::SeaTalkParser() {
-    _index = 0;
-    _state = SeaTalkParserStateReset;
+    reset();
     _invalidMessageCount = 0;
+    _truncatedMessageCount = 0;
     _messagesParsedCount = 0;
+    _discardedByteCount = 0;
+}
+
+void SeaTalkParser::reset() {
+    _index = 0;
+    _messageLength = 0;
+    _state = SeaTalkParserStateReset;
 }
 
 bool SeaTalkParser::parse(uint16_t c) {
-    // Sanity check: messages shouldn't be too long
-    if (_index > 18) {
-        _state = SeaTalkParserStateReset;
-    }
     // New messages have the 9th bit set
     if (c & 0x100) {
-        memset(_message, 0, sizeof(_message));
+        // A command byte in the middle of a message means it was cut short (probably a collision)
+        if (_state == SeaTalkParserStateParsingHeader || _state == SeaTalkParserStateParsingContent) {
+            _truncatedMessageCount++;
+        }
         _message[0] = c & 0xFF;
         _messageLength = 0;
         _index = 1;
@@ -39,6 +46,13 @@ bool SeaTalkParser::parse(uint16_t c) {
             // Least significant nibble of the 2nd byte is the length of the optional section
             if (_index == 1) {
                 _messageLength = (c & 0x0F) + 3;
+                int expectedLength = seaTalkMessageExpectedLength(_message[0]);
+                // Reject as soon as the length disagrees with the command, then ignore everything up to the next command byte
+                if (expectedLength && _messageLength != expectedLength) {
+                    _invalidMessageCount++;
+                    reset();
+                    return false;
+                }
             }
             _message[_index++] = c;
             // The header is always 3 bytes long, the rest of the message is 0-15 bytes
@@ -46,6 +60,7 @@ bool SeaTalkParser::parse(uint16_t c) {
                 if (_messageLength > 3) {
                     _state = SeaTalkParserStateParsingContent;
                 } else {
+                    _messagesParsedCount++;
                     _state = SeaTalkParserStateComplete;
                     return true;
                 }
@@ -54,20 +69,37 @@ bool SeaTalkParser::parse(uint16_t c) {
         case SeaTalkParserStateParsingContent:
             _message[_index++] = c;
             if (_index >= _messageLength) {
+                if (!seaTalkMessageIsValid(_message, _messageLength)) {
+                    _invalidMessageCount++;
+                    reset();
+                    return false;
+                }
+                _messagesParsedCount++;
                 _state = SeaTalkParserStateComplete;
                 return true;
             }
             break;
-        // Wait for a new header to bump us out of the complete state
+        // Wait for a new header to bump us out of the complete or reset states
         case SeaTalkParserStateComplete:
-            break;
         default:
-            _state = SeaTalkParserStateReset;
+            _discardedByteCount++;
             break;
     }
     return false;
 }
 
+int SeaTalkParser::parse(const uint16_t *buffer, int length, bool *complete) {
+    TRACE_SCOPE(TraceEventSeaTalkParse, 0);
+    *complete = false;
+    for (int i = 0; i < length; i++) {
+        if (parse(buffer[i])) {
+            *complete = true;
+            return i + 1;
+        }
+    }
+    return length;
+}
+
 const uint8_t *SeaTalkParser::message() {
     if (_state == SeaTalkParserStateComplete) {
         return _message;
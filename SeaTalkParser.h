@@ -2,6 +2,7 @@
 #define SeaTalkParser_h
 
 #include "inttypes.h"
+#include "SeaTalkMessage.h"
 
 /*!
 Parses a bytestream into a full SeaTalk message
@@ -12,18 +13,29 @@ public:
     SeaTalkParser();
     //! Accepts the next byte in the stream, returns true if a full sentence was received
     bool parse(uint16_t c);
+    //! Accepts a run of bytes from the stream. Stops right after a full message so it can be handled before the next one overwrites it. Returns the number of bytes consumed.
+    int parse(const uint16_t *buffer, int length, bool *complete);
     //! The most recently received complete message. Will be NULL if no full message has been received.
     const uint8_t* message();
     int messageLength();
     void reset();
+    //! Messages rejected for a bad length or bad redundancy bytes
+    int invalidMessageCount() { return _invalidMessageCount; }
+    //! Messages cut short by the next command byte, probably by a collision
+    int truncatedMessageCount() { return _truncatedMessageCount; }
+    int messagesParsedCount() { return _messagesParsedCount; }
+    //! Bytes thrown away while waiting for the next command byte
+    int discardedByteCount() { return _discardedByteCount; }
 private:
-    uint8_t _message[19];
+    uint8_t _message[SEATALK_MESSAGE_MAX_LENGTH];
     int _messageLength;
     int _state;
     int _index;
 
     int _invalidMessageCount;
+    int _truncatedMessageCount;
     int _messagesParsedCount;
+    int _discardedByteCount;
 };
 
 #endif
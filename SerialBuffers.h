@@ -0,0 +1,26 @@
+#ifndef SerialBuffers_h
+#define SerialBuffers_h
+
+#include "Types.h"
+#include "libraries/AltSoftSerial/config/AltSoftSerial_Buffers.h"
+
+// RX and TX buffers in Teensyduino's serial1.c, serial2.c and serial3.c. They're set in the core, check them when it's updated.
+#define TEENSY_SERIAL1_RX_BUFFER_SIZE 64
+#define TEENSY_SERIAL1_TX_BUFFER_SIZE 64
+#define TEENSY_SERIAL2_RX_BUFFER_SIZE 64
+#define TEENSY_SERIAL2_TX_BUFFER_SIZE 40
+#define TEENSY_SERIAL3_RX_BUFFER_SIZE 64
+#define TEENSY_SERIAL3_TX_BUFFER_SIZE 40
+// USB has flow control, this is what a pass can expect to find waiting, a packet
+#define USB_SERIAL_RX_BUFFER_SIZE 64
+
+// RX buffer of the serial behind each Port as Helm.ino wires them up, indexed by Port
+#define SERIAL_BUFFERS_RX_SIZES { \
+    USB_SERIAL_RX_BUFFER_SIZE, \
+    TEENSY_SERIAL1_RX_BUFFER_SIZE, \
+    ALTSS_RX_BUFFER_SIZE, \
+    TEENSY_SERIAL3_RX_BUFFER_SIZE, \
+    TEENSY_SERIAL2_RX_BUFFER_SIZE \
+}
+
+#endif
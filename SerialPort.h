@@ -0,0 +1,74 @@
+#ifndef SerialPort_h
+#define SerialPort_h
+
+#include "inttypes.h"
+#include <stddef.h>
+
+//! Errors a serial driver has counted since it started
+typedef struct {
+    //! Characters garbled because an interrupt ran too late, which means CPU load rather than the line
+    uint32_t latencyOverruns;
+    //! Characters lost because the RX buffer was full
+    uint32_t overflows;
+    //! Characters with a bad stop bit, which means a problem on the line
+    uint32_t framingErrors;
+} SerialErrorCounts;
+
+/*!
+The part of a Stream the Router needs. The Router only talks to ports through this so the same routing code can run
+against the Teensy's UARTs, AltSoftSerial, or a fake port on the host.
+*/
+class SerialPort
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    //! Bytes that can be written without blocking
+    virtual int availableForWrite() = 0;
+    //! The Router never writes more than availableForWrite() at once, so this doesn't block
+    virtual size_t write(const uint8_t *buffer, size_t size) = 0;
+    //! Writes the low 9 bits of data as one character. Only the SeaTalk port needs this.
+    virtual size_t write9bit(uint32_t data) { return 0; }
+    //! All zero for drivers that don't count errors
+    virtual SerialErrorCounts errorCounts() {
+        SerialErrorCounts counts = {0, 0, 0};
+        return counts;
+    }
+};
+
+//! Wraps anything with the Stream API (HardwareSerial, usb_serial_class, AltSoftSerial) as a SerialPort
+template <class SerialType>
+class SerialPortAdapter : public SerialPort
+{
+public:
+    SerialPortAdapter(SerialType &serial) : _serial(serial) { }
+    int available() { return _serial.available(); }
+    int read() { return _serial.read(); }
+    int availableForWrite() { return _serial.availableForWrite(); }
+    size_t write(const uint8_t *buffer, size_t size) { return _serial.write(buffer, size); }
+protected:
+    SerialType &_serial;
+};
+
+//! A SerialPortAdapter for UARTs configured for 9 bit characters
+template <class SerialType>
+class SerialPort9BitAdapter : public SerialPortAdapter<SerialType>
+{
+public:
+    SerialPort9BitAdapter(SerialType &serial) : SerialPortAdapter<SerialType>(serial) { }
+    size_t write9bit(uint32_t data) { return this->_serial.write9bit(data); }
+};
+
+//! A SerialPortAdapter for drivers that count their errors, like AltSoftSerial
+template <class SerialType>
+class SerialPortErrorCountingAdapter : public SerialPortAdapter<SerialType>
+{
+public:
+    SerialPortErrorCountingAdapter(SerialType &serial) : SerialPortAdapter<SerialType>(serial) { }
+    SerialErrorCounts errorCounts() {
+        SerialErrorCounts counts = {this->_serial.latencyOverrunCount(), this->_serial.overflowCount(), this->_serial.framingErrorCount()};
+        return counts;
+    }
+};
+
+#endif
@@ -0,0 +1,65 @@
+#include "StackPaint.h"
+#include "Arduino.h"
+
+// Lowest painted byte and the address the high water is measured from
+static uint8_t *paintedBottom = NULL;
+static uint8_t *stackTop = NULL;
+
+#if defined(KINETISK)
+
+// From the Teensy 3 linker script and core: the top of RAM, where the stack starts, and the end of the heap
+extern char _estack;
+extern char *__brkval;
+
+void stackPaint() {
+    uint8_t marker;
+    paintedBottom = (uint8_t *)__brkval;
+    stackTop = (uint8_t *)&_estack;
+    for (uint8_t *byte = paintedBottom; byte < &marker - STACK_PAINT_MARGIN; byte++) {
+        *byte = STACK_PAINT_PATTERN;
+    }
+}
+
+static uint8_t *scanBottom() {
+    // The heap may have grown into what was painted since
+    uint8_t *heapEnd = (uint8_t *)__brkval;
+    return heapEnd > paintedBottom ? heapEnd : paintedBottom;
+}
+
+#else
+
+// Paints its own frame, which is dead stack below the caller of stackPaint() once it returns, and returns where it starts
+static uintptr_t __attribute__((noinline)) paintRegion() {
+    volatile uint8_t region[STACK_PAINT_HOST_SIZE];
+    for (int i = 0; i < STACK_PAINT_HOST_SIZE; i++) {
+        region[i] = STACK_PAINT_PATTERN;
+    }
+    return (uintptr_t)region;
+}
+
+void stackPaint() {
+    uint8_t marker;
+    stackTop = &marker;
+    paintedBottom = (uint8_t *)paintRegion();
+}
+
+static uint8_t *scanBottom() {
+    return paintedBottom;
+}
+
+#endif
+
+uint32_t stackHighWater() {
+    if (!paintedBottom) {
+        return 0;
+    }
+    volatile uint8_t *byte = scanBottom();
+    while (byte < stackTop && *byte == STACK_PAINT_PATTERN) {
+        byte++;
+    }
+    return stackTop - byte;
+}
+
+uint32_t stackPaintedSize() {
+    return paintedBottom ? stackTop - scanBottom() : 0;
+}
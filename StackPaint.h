@@ -0,0 +1,29 @@
+#ifndef StackPaint_h
+#define StackPaint_h
+
+#include "inttypes.h"
+
+/*
+Stack high water mark by painting. stackPaint() fills the free stack below its caller with a pattern, and
+stackHighWater() finds how much of it has been written over since.
+
+On the Teensy that's everything between the end of the heap and the stack pointer, and the high water is measured from
+the top of RAM. The Teensy has no MMU, so a stack that runs into the heap corrupts it silently; this is how we find out
+how close it gets. On the host a fixed size region below the caller is painted instead and the high water is measured
+from the caller's frame, so host numbers track changes in the code rather than what the firmware uses.
+*/
+
+#define STACK_PAINT_PATTERN 0xC5
+// Left unpainted just under the stack pointer, for stackPaint()'s own frame and any interrupt that fires while painting
+#define STACK_PAINT_MARGIN 256
+// Bytes painted on the host
+#define STACK_PAINT_HOST_SIZE (64 * 1024)
+
+//! Call once, as high up the stack as possible. Interrupts should be off on the Teensy.
+void stackPaint();
+//! Most stack used since stackPaint() in bytes, 0 if it was never called
+uint32_t stackHighWater();
+//! Bytes stackHighWater() can see. When the high water reaches this the stack went at least that deep.
+uint32_t stackPaintedSize();
+
+#endif
@@ -0,0 +1,86 @@
+#include "Trace.h"
+#include "LatencyProbe.h"
+#include <stdio.h>
+#include "Arduino.h"
+
+#if defined(ARM_DWT_CYCCNT)
+
+uint32_t traceTimestamp() {
+    return latencyTimestamp();
+}
+
+uint32_t traceTicksPerMicro() {
+    return latencyTicksPerMicro();
+}
+
+#else
+
+#include <time.h>
+
+uint32_t traceTimestamp() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+uint32_t traceTicksPerMicro() {
+    return 1000;
+}
+
+#endif
+
+static const char *eventNames[TraceEventCount] = {"READ", "NMEAPARSE", "SEATALKPARSE", "ROUTE", "NMEADECODE", "NMEAENCODE", "SEATALKDECODE", "SEATALKENCODE", "WRITE"};
+
+const char *traceEventName(TraceEvent event) {
+    return event < TraceEventCount ? eventNames[event] : "UNKNOWN";
+}
+
+#ifdef HELM_TRACE
+
+TraceEntry traceRing[TRACE_RING_SIZE];
+uint32_t traceCount = 0;
+bool traceEnabled = true;
+
+static uint32_t traceEventCount() {
+    return traceCount < TRACE_RING_SIZE ? traceCount : TRACE_RING_SIZE;
+}
+
+#else
+
+static uint32_t traceEventCount() {
+    return 0;
+}
+
+#endif
+
+bool traceDumpSentence(uint32_t *offset, char *buffer, size_t size) {
+    uint32_t eventCount = traceEventCount();
+    // Offset 0 is BEGIN, then one per sentence of events, then END
+    uint32_t sentenceCount = (eventCount + TRACE_EVENTS_PER_SENTENCE - 1) / TRACE_EVENTS_PER_SENTENCE;
+    if (*offset == 0) {
+#ifdef HELM_TRACE
+        traceEnabled = false;
+#endif
+        snprintf(buffer, size, "$PHLM,TRACE,BEGIN,%lu,%lu", (unsigned long)eventCount, (unsigned long)traceTicksPerMicro());
+    } else if (*offset <= sentenceCount) {
+#ifdef HELM_TRACE
+        size_t length = snprintf(buffer, size, "$PHLM,TRACE,");
+        // The oldest event is the next one to be overwritten once the ring has wrapped
+        uint32_t oldest = traceCount - eventCount;
+        for (uint32_t i = (*offset - 1) * TRACE_EVENTS_PER_SENTENCE; i < *offset * TRACE_EVENTS_PER_SENTENCE && i < eventCount && length < size; i++) {
+            TraceEntry *entry = &traceRing[(oldest + i) % TRACE_RING_SIZE];
+            length += snprintf(&buffer[length], size - length, "%08lX%02X%X%X", (unsigned long)entry->timestamp, entry->event, entry->phase & 0xF, entry->arg & 0xF);
+        }
+#endif
+    } else if (*offset == sentenceCount + 1) {
+        snprintf(buffer, size, "$PHLM,TRACE,END");
+#ifdef HELM_TRACE
+        traceCount = 0;
+        traceEnabled = true;
+#endif
+    } else {
+        return false;
+    }
+    (*offset)++;
+    return true;
+}
@@ -0,0 +1,108 @@
+#ifndef Trace_h
+#define Trace_h
+
+#include "inttypes.h"
+#include <stddef.h>
+
+/*
+Begin/end events around the parsing, decoding, encoding and writing the router does, recorded into a RAM ring with a
+traceTimestamp() each. Build with -DHELM_TRACE to turn them on, otherwise the macros compile to nothing.
+
+The ring is dumped with $PHLM,TRACE and testing/TraceExport.cpp turns the dump into Chrome/Perfetto trace JSON.
+*/
+
+// Events kept, the oldest are overwritten. 8 bytes each.
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE 512
+#endif
+
+// Events packed into each $PHLM,TRACE sentence of a dump, 12 hex chars each
+#define TRACE_EVENTS_PER_SENTENCE 6
+
+typedef enum {
+    // Reading a chunk off a port and feeding it to the parser, the arg is the port
+    TraceEventRead = 0,
+    TraceEventNMEAParse,
+    TraceEventSeaTalkParse,
+    // Running the routes for a complete message, the arg is the source port
+    TraceEventRoute,
+    // Message constructors, decoding what came in and encoding what goes out
+    TraceEventNMEADecode,
+    TraceEventNMEAEncode,
+    TraceEventSeaTalkDecode,
+    TraceEventSeaTalkEncode,
+    // Handing queued messages to a port, the arg is the port
+    TraceEventWrite,
+    TraceEventCount
+} TraceEvent;
+
+typedef enum {
+    TracePhaseBegin = 0,
+    TracePhaseEnd
+} TracePhase;
+
+typedef struct {
+    uint32_t timestamp;
+    uint8_t event;
+    uint8_t phase;
+    uint8_t arg;
+} TraceEntry;
+
+const char *traceEventName(TraceEvent event);
+//! The CPU cycle counter on Teensy, real nanoseconds on the host where the simulated clock stands still while the router runs
+uint32_t traceTimestamp();
+uint32_t traceTicksPerMicro();
+
+#ifdef HELM_TRACE
+
+extern TraceEntry traceRing[TRACE_RING_SIZE];
+extern uint32_t traceCount;
+extern bool traceEnabled;
+
+inline void traceRecord(TraceEvent event, TracePhase phase, uint8_t arg) {
+    if (!traceEnabled) {
+        return;
+    }
+    TraceEntry *entry = &traceRing[traceCount++ % TRACE_RING_SIZE];
+    entry->timestamp = traceTimestamp();
+    entry->event = event;
+    entry->phase = phase;
+    entry->arg = arg;
+}
+
+//! Ends the event when it goes out of scope, for functions with more than one return
+class TraceScope
+{
+public:
+    TraceScope(TraceEvent event, uint8_t arg) : _event(event), _arg(arg) { traceRecord(event, TracePhaseBegin, arg); }
+    ~TraceScope() { traceRecord(_event, TracePhaseEnd, _arg); }
+private:
+    TraceEvent _event;
+    uint8_t _arg;
+};
+
+#define TRACE_BEGIN(event, arg) traceRecord(event, TracePhaseBegin, arg)
+#define TRACE_END(event, arg) traceRecord(event, TracePhaseEnd, arg)
+#define TRACE_SCOPE(event, arg) TraceScope traceScope(event, arg)
+
+#else
+
+#define TRACE_BEGIN(event, arg)
+#define TRACE_END(event, arg)
+#define TRACE_SCOPE(event, arg)
+
+#endif
+
+/*!
+Writes the next sentence of a dump of the ring, without the checksum, and returns false once there are none left. Start
+with *offset at 0. Recording is paused from the first sentence to the last so the ring holds still.
+
+    $PHLM,TRACE,BEGIN,<events>,<timestamp ticks per micro>
+    $PHLM,TRACE,<timestamp 8 hex><event 2 hex><phase 1 hex><arg 1 hex>...   oldest first
+    $PHLM,TRACE,END
+
+Without HELM_TRACE the dump is just BEGIN and END with no events.
+*/
+bool traceDumpSentence(uint32_t *offset, char *buffer, size_t size);
+
+#endif
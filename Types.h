@@ -1,20 +1,46 @@
 #ifndef Types_h
 #define Types_h
 
+#include "inttypes.h"
+
+// Navigation values are fixed point. The Teensy 3's Cortex-M4 has no FPU, so float and double math is all done in
+// software; these keep decoding and encoding in integer math and make the structs smaller. Coordinates are rounded to
+// the nearest 1e-7 degree, since NMEA's 1e-5 minutes don't divide into it evenly. The other units are exact for the NMEA
+// fields we read and the SeaTalk fields we write.
+
+//! Latitude or longitude in 1e-7 degrees, positive north and east. About 1cm, finer than NMEA's 1e-5 minutes.
+typedef int32_t Coordinate;
+#define COORDINATE_UNITS_PER_DEGREE 10000000L
+//! Angles in tenths of a degree
+typedef int16_t DeciDegrees;
+//! Speed in hundredths of a knot
+typedef int32_t CentiKnots;
+//! Distance, cross track error included, in hundredths of a nautical mile
+typedef int32_t CentiNauticalMiles;
+//! Depth in tenths of a foot, as SeaTalk sends it
+typedef int32_t DeciFeet;
+
+//! value / divisor rounded half away from zero, for going to a coarser unit
+inline int32_t divideRounded(int32_t value, int32_t divisor) {
+    return (value + (value < 0 ? -divisor : divisor) / 2) / divisor;
+}
+
 typedef struct {
-	int hour;
-	int minute;
-	float second;
+    uint8_t hour;
+    uint8_t minute;
+    //! Milliseconds into the minute, seconds included
+    uint16_t millisecond;
 } Time;
 
 typedef struct {
-    int day;
-    int month;
-    int year;
+    uint8_t day;
+    uint8_t month;
+    //! As sent, two digits from NMEA
+    uint16_t year;
 } Date;
 
 typedef struct {
-    float degrees;
+    DeciDegrees deciDegrees;
     bool isMagnetic;
 } Heading;
 
@@ -30,4 +56,14 @@ typedef enum {
     LateralityUnknown = 0
 } Laterality;
 
+//! The serial ports messages are routed between
+typedef enum {
+    PortOutput = 0,
+    PortNMEAHighSpeed,
+    PortNMEA,
+    PortSeaTalk,
+    PortGPS,
+    PortCount
+} Port;
+
 #endif
\ No newline at end of file
@@ -32,12 +32,25 @@
 #include "config/AltSoftSerial_Boards.h"
 #include "config/AltSoftSerial_Timers.h"
 
+#ifndef ALTSS_WAIT
+#define ALTSS_WAIT()
+#endif
+
 /****************************************/
 /**          Initialization            **/
 /****************************************/
 
 static uint16_t ticks_per_bit=0;
 bool AltSoftSerial::timing_error=false;
+// An ISR ran too late to set up the next edge in time (TX) or to be sure
+// it saw every edge (RX). Either way a byte went out or came in garbled,
+// because the CPU was busy with interrupts off, not because of the line.
+static volatile uint32_t latency_overrun_count;
+// Bytes received while the RX buffer was full, because loop() didn't read
+// them quickly enough
+static volatile uint32_t overflow_count;
+// Bytes whose stop bit was low, a problem on the line itself
+static volatile uint32_t framing_error_count;
 
 static uint8_t rx_state;
 static uint8_t rx_byte;
@@ -46,7 +59,7 @@ static uint16_t rx_target;
 static uint16_t rx_stop_ticks=0;
 static volatile uint8_t rx_buffer_head;
 static volatile uint8_t rx_buffer_tail;
-#define RX_BUFFER_SIZE 80
+#define RX_BUFFER_SIZE ALTSS_RX_BUFFER_SIZE
 static volatile uint8_t rx_buffer[RX_BUFFER_SIZE];
 
 static volatile uint8_t tx_state=0;
@@ -54,7 +67,7 @@ static uint8_t tx_byte;
 static uint8_t tx_bit;
 static volatile uint8_t tx_buffer_head;
 static volatile uint8_t tx_buffer_tail;
-#define TX_BUFFER_SIZE 160
+#define TX_BUFFER_SIZE ALTSS_TX_BUFFER_SIZE
 static volatile uint8_t tx_buffer[TX_BUFFER_SIZE];
 
 
@@ -80,11 +93,15 @@ void AltSoftSerial::init(uint32_t cycles_per_bit)
 	digitalWrite(OUTPUT_COMPARE_A_PIN, HIGH);
 	pinMode(OUTPUT_COMPARE_A_PIN, OUTPUT);
 	rx_state = 0;
+	rx_bit = 0;
 	rx_buffer_head = 0;
 	rx_buffer_tail = 0;
 	tx_state = 0;
 	tx_buffer_head = 0;
 	tx_buffer_tail = 0;
+	latency_overrun_count = 0;
+	overflow_count = 0;
+	framing_error_count = 0;
 	ENABLE_INT_INPUT_CAPTURE();
 }
 
@@ -105,36 +122,79 @@ void AltSoftSerial::end(void)
 
 void AltSoftSerial::writeByte(uint8_t b)
 {
-	uint8_t intr_state, head;
+	while (!tryWrite(&b, 1)) ALTSS_WAIT(); // wait until space in buffer
+}
+
+// Queues as much of buffer as fits without waiting and returns how many
+// bytes that was. The whole span goes in under one critical section, which
+// is at most TX_BUFFER_SIZE copies, well under a bit time at these baud rates.
+size_t AltSoftSerial::tryWrite(const uint8_t *buffer, size_t size)
+{
+	uint8_t intr_state, head, next, tail;
+	size_t count = 0;
 
-	head = tx_buffer_head + 1;
-	if (head >= TX_BUFFER_SIZE) head = 0;
-	while (tx_buffer_tail == head) ; // wait until space in buffer
+	if (size == 0) return 0;
 	intr_state = SREG;
 	cli();
-	if (tx_state) {
-		tx_buffer[head] = b;
-		tx_buffer_head = head;
-	} else {
+	if (!tx_state) {
 		tx_state = 1;
-		tx_byte = b;
+		tx_byte = buffer[count++];
 		tx_bit = 0;
 		ENABLE_INT_COMPARE_A();
 		CONFIG_MATCH_CLEAR();
 		SET_COMPARE_A(GET_TIMER_COUNT() + 16);
 	}
+	head = tx_buffer_head;
+	tail = tx_buffer_tail;
+	while (count < size) {
+		next = head + 1;
+		if (next >= TX_BUFFER_SIZE) next = 0;
+		if (next == tail) break;
+		tx_buffer[next] = buffer[count++];
+		head = next;
+	}
+	tx_buffer_head = head;
 	SREG = intr_state;
+	return count;
 }
 
+#if ARDUINO >= 100 || defined(ALTSS_HOST_EMULATION)
+size_t AltSoftSerial::write(const uint8_t *buffer, size_t size)
+{
+	size_t count = 0;
+
+	while (count < size) {
+		size_t written = tryWrite(buffer + count, size - count);
+		if (!written) ALTSS_WAIT(); // wait until space in buffer
+		count += written;
+	}
+	return size;
+}
+#endif
+
+
+// The compare only matches when the timer gets to target. If it already
+// went past while this ISR was waiting to run, the edge waits for the timer
+// to wrap all the way around and the byte is garbled. Both are measured
+// from the match that fired, since a run of equal bits can put target more
+// than half the timer's range ahead.
+static inline void check_compare_a_late(uint16_t fired, uint16_t target)
+{
+	if ((uint16_t)(GET_TIMER_COUNT() - fired) >= (uint16_t)(target - fired)) {
+		latency_overrun_count++;
+		AltSoftSerial::timing_error = true;
+	}
+}
 
 ISR(COMPARE_A_INTERRUPT)
 {
 	uint8_t state, byte, bit, head, tail;
-	uint16_t target;
+	uint16_t fired, target;
 
 	state = tx_state;
 	byte = tx_byte;
-	target = GET_COMPARE_A();
+	fired = GET_COMPARE_A();
+	target = fired;
 	while (state < 9) {
 		target += ticks_per_bit;
 		bit = byte & 1;
@@ -150,7 +210,7 @@ ISR(COMPARE_A_INTERRUPT)
 			tx_bit = bit;
 			tx_byte = byte;
 			tx_state = state;
-			// TODO: how to detect timing_error?
+			check_compare_a_late(fired, target);
 			return;
 		}
 	}
@@ -158,6 +218,7 @@ ISR(COMPARE_A_INTERRUPT)
 		tx_state = 10;
 		CONFIG_MATCH_SET();
 		SET_COMPARE_A(target + ticks_per_bit);
+		check_compare_a_late(fired, target + ticks_per_bit);
 		return;
 	}
 	head = tx_buffer_head;
@@ -174,13 +235,23 @@ ISR(COMPARE_A_INTERRUPT)
 		tx_bit = 0;
 		CONFIG_MATCH_CLEAR();
 		SET_COMPARE_A(target + ticks_per_bit);
-		// TODO: how to detect timing_error?
+		check_compare_a_late(fired, target + ticks_per_bit);
 	}
 }
 
+int AltSoftSerial::availableForWrite(void)
+{
+	uint8_t head, tail;
+
+	head = tx_buffer_head;
+	tail = tx_buffer_tail;
+	if (tail > head) return tail - head - 1;
+	return TX_BUFFER_SIZE + tail - head - 1;
+}
+
 void AltSoftSerial::flushOutput(void)
 {
-	while (tx_state) /* wait */ ;
+	while (tx_state) ALTSS_WAIT();
 }
 
 
@@ -196,6 +267,12 @@ ISR(CAPTURE_INTERRUPT)
 	int16_t offset;
 
 	capture = GET_INPUT_CAPTURE();
+	// Another edge in the time it took to get here would have overwritten
+	// the capture, and the bits it ended are lost
+	if ((uint16_t)(GET_TIMER_COUNT() - capture) > ticks_per_bit) {
+		latency_overrun_count++;
+		AltSoftSerial::timing_error = true;
+	}
 	bit = rx_bit;
 	if (bit) {
 		CONFIG_CAPTURE_FALLING_EDGE();
@@ -222,11 +299,25 @@ ISR(CAPTURE_INTERRUPT)
 			state++;
 			if (state >= 9) {
 				DISABLE_INT_COMPARE_B();
+				// Compare B ends the byte a quarter bit into the stop
+				// bit, so an edge before then is the one into the stop
+				// bit and has to be rising. One after it is the next
+				// start bit, here because compare B's ISR ran late,
+				// and that character is lost.
+				offset = capture - target;
+				if (offset >= -(int16_t)(ticks_per_bit / 4)) {
+					latency_overrun_count++;
+					AltSoftSerial::timing_error = true;
+				} else if (rx_bit) {
+					framing_error_count++;
+				}
 				head = rx_buffer_head + 1;
 				if (head >= RX_BUFFER_SIZE) head = 0;
 				if (head != rx_buffer_tail) {
 					rx_buffer[head] = rx_byte;
 					rx_buffer_head = head;
+				} else {
+					overflow_count++;
 				}
 				CONFIG_CAPTURE_FALLING_EDGE();
 				rx_bit = 0;
@@ -237,7 +328,6 @@ ISR(CAPTURE_INTERRUPT)
 		rx_target = target;
 		rx_state = state;
 	}
-	//if (GET_TIMER_COUNT() - capture > ticks_per_bit) AltSoftSerial::timing_error = true;
 }
 
 ISR(COMPARE_B_INTERRUPT)
@@ -252,11 +342,15 @@ ISR(COMPARE_B_INTERRUPT)
 		rx_byte = (rx_byte >> 1) | bit;
 		state++;
 	}
+	// The line has been at this level since the last edge, stop bit included
+	if (!bit) framing_error_count++;
 	head = rx_buffer_head + 1;
 	if (head >= RX_BUFFER_SIZE) head = 0;
 	if (head != rx_buffer_tail) {
 		rx_buffer[head] = rx_byte;
 		rx_buffer_head = head;
+	} else {
+		overflow_count++;
 	}
 	rx_state = 0;
 	CONFIG_CAPTURE_FALLING_EDGE();
@@ -303,6 +397,34 @@ void AltSoftSerial::flushInput(void)
 	rx_buffer_head = rx_buffer_tail;
 }
 
+// 32 bit reads aren't atomic on AVR
+static uint32_t read_count(volatile uint32_t *count)
+{
+	uint8_t intr_state;
+	uint32_t value;
+
+	intr_state = SREG;
+	cli();
+	value = *count;
+	SREG = intr_state;
+	return value;
+}
+
+uint32_t AltSoftSerial::latencyOverrunCount(void)
+{
+	return read_count(&latency_overrun_count);
+}
+
+uint32_t AltSoftSerial::overflowCount(void)
+{
+	return read_count(&overflow_count);
+}
+
+uint32_t AltSoftSerial::framingErrorCount(void)
+{
+	return read_count(&framing_error_count);
+}
+
 
 #ifdef ALTSS_USE_FTM0
 void ftm0_isr(void)
@@ -25,21 +25,31 @@
 #define AltSoftSerial_h
 
 #include <inttypes.h>
+#include "config/AltSoftSerial_Buffers.h"
 
-#if ARDUINO >= 100
+#if defined(ALTSS_HOST_EMULATION)
+#include "Arduino.h"
+#include "config/AltSoftSerial_HostEmulation.h"
+#elif ARDUINO >= 100
 #include "Arduino.h"
 #else
 #include "WProgram.h"
 #include "pins_arduino.h"
 #endif
 
-#if defined(__arm__) && defined(CORE_TEENSY)
+#if defined(ALTSS_HOST_EMULATION)
+#define ALTSS_BASE_FREQ ALTSS_HOST_TIMER_FREQ
+#elif defined(__arm__) && defined(CORE_TEENSY)
 #define ALTSS_BASE_FREQ F_BUS
 #else
 #define ALTSS_BASE_FREQ F_CPU
 #endif
 
+#if defined(ALTSS_HOST_EMULATION)
+class AltSoftSerial
+#else
 class AltSoftSerial : public Stream
+#endif
 {
 public:
 	AltSoftSerial() { }
@@ -49,14 +59,19 @@ public:
 	int peek();
 	int read();
 	int available();
-#if ARDUINO >= 100
+	int availableForWrite();
+	static size_t tryWrite(const uint8_t *buffer, size_t size);
+#if ARDUINO >= 100 || defined(ALTSS_HOST_EMULATION)
 	size_t write(uint8_t byte) { writeByte(byte); return 1; }
+	size_t write(const uint8_t *buffer, size_t size);
 	void flush() { flushOutput(); }
 #else
 	void write(uint8_t byte) { writeByte(byte); }
 	void flush() { flushInput(); }
 #endif
+#if !defined(ALTSS_HOST_EMULATION)
 	using Print::write;
+#endif
 	static void flushInput();
 	static void flushOutput();
 	// for drop-in compatibility with NewSoftSerial, rxPin & txPin ignored
@@ -64,6 +79,10 @@ public:
 	bool listen() { return false; }
 	bool isListening() { return true; }
 	bool overflow() { bool r = timing_error; timing_error = false; return r; }
+	// Counted since begin(), see the ISRs for what each one means
+	static uint32_t latencyOverrunCount();
+	static uint32_t overflowCount();
+	static uint32_t framingErrorCount();
 	static int library_version() { return 1; }
 	static void enable_timer0(bool enable) { }
 	static bool timing_error;
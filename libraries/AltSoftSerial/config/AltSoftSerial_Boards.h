@@ -22,9 +22,19 @@
  */
 
 
+// Host emulation, for running the ISRs off target. Pins as on the Teensy 3.
+//
+#if defined(ALTSS_HOST_EMULATION)
+
+ #define ALTSS_USE_HOST_EMULATION
+ #define INPUT_CAPTURE_PIN		20 // receive
+ #define OUTPUT_COMPARE_A_PIN		21 // transmit
+ #define OUTPUT_COMPARE_B_PIN		22 // unusable PWM
+
+
 // Teensy 2.0
 //
-#if defined(__AVR_ATmega32U4__) && defined(CORE_TEENSY)
+#elif defined(__AVR_ATmega32U4__) && defined(CORE_TEENSY)
 
  //#define ALTSS_USE_TIMER1
  //#define INPUT_CAPTURE_PIN		22 // receive
@@ -0,0 +1,17 @@
+#ifndef AltSoftSerial_Buffers_h
+#define AltSoftSerial_Buffers_h
+
+// Ring buffer sizes in bytes. Override them for the whole build with -D, the library is compiled on its own so
+// defining them in a sketch doesn't reach it. The ring indexes are uint8_t, and one slot is always left empty.
+#ifndef ALTSS_RX_BUFFER_SIZE
+#define ALTSS_RX_BUFFER_SIZE 80
+#endif
+#ifndef ALTSS_TX_BUFFER_SIZE
+#define ALTSS_TX_BUFFER_SIZE 160
+#endif
+
+#if ALTSS_RX_BUFFER_SIZE > 256 || ALTSS_TX_BUFFER_SIZE > 256
+#error "AltSoftSerial buffers can't be larger than 256 bytes, the ring indexes are uint8_t"
+#endif
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef AltSoftSerial_HostEmulation_h
+#define AltSoftSerial_HostEmulation_h
+
+// Host stand-in for the timer AltSoftSerial runs on, built with
+// ALTSS_HOST_EMULATION so the ISRs can be tested off target. It works like
+// the Teensy 3's FTM0: a free running 16 bit counter, an input capture
+// channel on the RX pin, compare A driving the TX pin and compare B as the
+// RX timeout. The macros in AltSoftSerial_Timers.h read and write
+// altss_host_timer. Nothing moves by itself; a test harness keeps the time,
+// drives the pins and calls the ISRs below when they come due.
+
+#include <inttypes.h>
+
+// F_BUS on a Teensy 3 at 96 MHz, so the prescaler and ticks per bit come
+// out the same as on the board
+#define ALTSS_HOST_TIMER_FREQ 48000000
+
+#define ALTSS_HOST_MATCH_NORMAL	0
+#define ALTSS_HOST_MATCH_TOGGLE	1
+#define ALTSS_HOST_MATCH_CLEAR	2
+#define ALTSS_HOST_MATCH_SET	3
+
+typedef struct {
+	uint8_t prescale;
+	uint16_t capture;
+	bool capture_rising;
+	bool capture_enabled;
+	uint16_t compare_a;
+	uint8_t match_a;
+	bool compare_a_enabled;
+	uint16_t compare_b;
+	bool compare_b_enabled;
+	// Level of the TX pin. Compare A matches set it, and the pin goes back
+	// to idle when compare A is disabled, like the FTM0 macros do.
+	uint8_t tx_level;
+} altss_host_timer_t;
+
+extern altss_host_timer_t altss_host_timer;
+// Only the interrupt flag, bit 7, means anything
+extern uint8_t altss_host_sreg;
+
+void altss_capture_interrupt(void);
+void altss_compare_a_interrupt(void);
+void altss_compare_b_interrupt(void);
+// Supplied by the harness: the counter at the current time, and running
+// until the next thing happens
+uint16_t altss_host_timer_count(void);
+void altss_host_wait(void);
+
+#define SREG altss_host_sreg
+#define cli() (altss_host_sreg &= ~0x80)
+
+#ifndef INPUT
+#define INPUT 0
+#endif
+#ifndef OUTPUT
+#define OUTPUT 1
+#endif
+#ifndef HIGH
+#define HIGH 1
+#endif
+#ifndef LOW
+#define LOW 0
+#endif
+static inline void pinMode(uint8_t pin, uint8_t mode) { }
+static inline void digitalWrite(uint8_t pin, uint8_t value) { }
+
+#endif
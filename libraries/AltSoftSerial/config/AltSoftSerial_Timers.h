@@ -21,7 +21,37 @@
  * THE SOFTWARE.
  */
 
-#if defined(ALTSS_USE_TIMER1)
+#if defined(ALTSS_USE_HOST_EMULATION)
+  // See AltSoftSerial_HostEmulation.h, a test harness runs the timer
+  #define CONFIG_TIMER_NOPRESCALE()	(altss_host_timer.prescale = 1)
+  #define CONFIG_TIMER_PRESCALE_8()	(altss_host_timer.prescale = 8)
+  #define CONFIG_MATCH_NORMAL()		(altss_host_timer.match_a = ALTSS_HOST_MATCH_NORMAL)
+  #define CONFIG_MATCH_TOGGLE()		(altss_host_timer.match_a = ALTSS_HOST_MATCH_TOGGLE)
+  #define CONFIG_MATCH_CLEAR()		(altss_host_timer.match_a = ALTSS_HOST_MATCH_CLEAR)
+  #define CONFIG_MATCH_SET()		(altss_host_timer.match_a = ALTSS_HOST_MATCH_SET)
+  #define CONFIG_CAPTURE_FALLING_EDGE()	(altss_host_timer.capture_rising = false)
+  #define CONFIG_CAPTURE_RISING_EDGE()	(altss_host_timer.capture_rising = true)
+  #define ENABLE_INT_INPUT_CAPTURE()	(altss_host_timer.capture_enabled = true)
+  #define ENABLE_INT_COMPARE_A()	(altss_host_timer.compare_a_enabled = true)
+  #define ENABLE_INT_COMPARE_B()	(altss_host_timer.compare_b_enabled = true)
+  #define DISABLE_INT_INPUT_CAPTURE()	(altss_host_timer.capture_enabled = false)
+  #define DISABLE_INT_COMPARE_A()	(altss_host_timer.compare_a_enabled = false, altss_host_timer.tx_level = 1)
+  #define DISABLE_INT_COMPARE_B()	(altss_host_timer.compare_b_enabled = false)
+  #define GET_TIMER_COUNT()		altss_host_timer_count()
+  #define GET_INPUT_CAPTURE()		(altss_host_timer.capture)
+  #define GET_COMPARE_A()		(altss_host_timer.compare_a)
+  #define GET_COMPARE_B()		(altss_host_timer.compare_b)
+  #define SET_COMPARE_A(val)		(altss_host_timer.compare_a = (val))
+  #define SET_COMPARE_B(val)		(altss_host_timer.compare_b = (val))
+  #define CAPTURE_INTERRUPT		altss_capture_interrupt
+  #define COMPARE_A_INTERRUPT		altss_compare_a_interrupt
+  #define COMPARE_B_INTERRUPT		altss_compare_b_interrupt
+  #define ISR(f) void f (void)
+  // Nothing runs the ISRs behind the library's back, so waiting has to move time along
+  #define ALTSS_WAIT()			altss_host_wait()
+
+
+#elif defined(ALTSS_USE_TIMER1)
   #define CONFIG_TIMER_NOPRESCALE()	(TIMSK1 = 0, TCCR1A = 0, TCCR1B = (1<<ICNC1) | (1<<CS10))
   #define CONFIG_TIMER_PRESCALE_8()	(TIMSK1 = 0, TCCR1A = 0, TCCR1B = (1<<ICNC1) | (1<<CS11))
   #define CONFIG_MATCH_NORMAL()		(TCCR1A = TCCR1A & ~((1<<COM1A1) | (1<<COM1A0)))
@@ -0,0 +1,111 @@
+#include "AllocationCounter.h"
+#include <stdlib.h>
+#include <new>
+
+static AllocationStats stats = {0, 0, 0};
+
+static void countAllocation(size_t size) {
+    stats.count++;
+    stats.bytes += size;
+}
+
+void allocationCounterReset() {
+    stats.count = 0;
+    stats.bytes = 0;
+    stats.frees = 0;
+}
+
+AllocationStats allocationCounterStats() {
+    return stats;
+}
+
+#if defined(__GLIBC__)
+
+// glibc's own entry points, so malloc can be replaced without dlsym
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *pointer, size_t size);
+extern "C" void __libc_free(void *pointer);
+
+extern "C" void *malloc(size_t size) {
+    countAllocation(size);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+    countAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size) {
+    // Counted as freeing the old block and allocating a new one, so leak checks balance
+    if (pointer) {
+        stats.frees++;
+    }
+    if (size || !pointer) {
+        countAllocation(size);
+    }
+    return __libc_realloc(pointer, size);
+}
+
+extern "C" void free(void *pointer) {
+    if (pointer) {
+        stats.frees++;
+    }
+    __libc_free(pointer);
+}
+
+bool allocationCounterCountsMalloc() {
+    return true;
+}
+
+// operator new ends up in malloc, which already counts it
+void *operator new(size_t size) {
+    void *pointer = malloc(size ? size : 1);
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+#else
+
+bool allocationCounterCountsMalloc() {
+    return false;
+}
+
+void *operator new(size_t size) {
+    countAllocation(size);
+    void *pointer = malloc(size ? size : 1);
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+#endif
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept {
+#if !defined(__GLIBC__)
+    if (pointer) {
+        stats.frees++;
+    }
+#endif
+    free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+    operator delete(pointer);
+}
@@ -0,0 +1,59 @@
+#ifndef AllocationCounter_h
+#define AllocationCounter_h
+
+#include "inttypes.h"
+#include <stddef.h>
+
+/*!
+Counts heap allocations made through malloc, calloc, realloc and operator new, for benchmarks and tests that care
+about what the hot path allocates. Link testing/AllocationCounter.cpp in to turn it on. malloc is only intercepted with
+glibc; elsewhere only operator new is counted and allocationCounterCountsMalloc() returns false.
+*/
+typedef struct {
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t frees;
+} AllocationStats;
+
+//! Zeroes the counters
+void allocationCounterReset();
+//! Allocations since the last reset
+AllocationStats allocationCounterStats();
+bool allocationCounterCountsMalloc();
+
+//! Counts what's allocated between its construction and stats(), so a test can check one piece of code
+class AllocationScope
+{
+public:
+    AllocationScope() : _start(allocationCounterStats()) { }
+    AllocationStats stats() {
+        AllocationStats now = allocationCounterStats();
+        AllocationStats stats = {now.count - _start.count, now.bytes - _start.bytes, now.frees - _start.frees};
+        return stats;
+    }
+private:
+    AllocationStats _start;
+};
+
+#ifdef REQUIRE
+
+//! Fails the Catch test if running expression allocates more than maxCount times or maxBytes bytes in total
+#define REQUIRE_ALLOCATIONS_AT_MOST(maxCount, maxBytes, expression) do { \
+        AllocationScope allocationScope; \
+        expression; \
+        AllocationStats allocations = allocationScope.stats(); \
+        REQUIRE( allocations.count <= (maxCount) ); \
+        REQUIRE( allocations.bytes <= (maxBytes) ); \
+    } while (0)
+
+//! Fails the Catch test if running expression doesn't free everything it allocates
+#define REQUIRE_NO_LEAKS(expression) do { \
+        AllocationScope allocationScope; \
+        expression; \
+        AllocationStats allocations = allocationScope.stats(); \
+        REQUIRE( allocations.frees == allocations.count ); \
+    } while (0)
+
+#endif
+
+#endif
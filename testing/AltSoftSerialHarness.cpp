@@ -0,0 +1,277 @@
+#include "AltSoftSerialHarness.h"
+#include <stdio.h>
+#include <string.h>
+
+#define NO_EVENT UINT64_MAX
+#define CYCLES_PER_MICRO (ALTSS_HOST_TIMER_FREQ / 1000000)
+// The counter wraps after this many ticks, and a compare value matches again
+#define TIMER_PERIOD_TICKS 65536
+
+altss_host_timer_t altss_host_timer;
+uint8_t altss_host_sreg = 0x80;
+
+static AltSoftSerialHarness *activeHarness = NULL;
+
+uint16_t altss_host_timer_count(void) {
+    return activeHarness ? activeHarness->timerCount() : 0;
+}
+
+void altss_host_wait(void) {
+    if (!activeHarness) {
+        // Nothing would ever empty the buffer being waited on
+        fprintf(stderr, "AltSoftSerial waited with no AltSoftSerialHarness to run it\n");
+        abort();
+    }
+    activeHarness->step();
+}
+
+AltSoftSerialHarness::AltSoftSerialHarness(uint32_t seed) : _random(seed) {
+    memset(&altss_host_timer, 0, sizeof(altss_host_timer));
+    altss_host_timer.prescale = 1;
+    altss_host_timer.tx_level = 1;
+    _now = 0;
+    _latencyMin = 0;
+    _latencyMax = 0;
+    _jitter = 0;
+    _rxLineFree = 0;
+    _rxQueuedLevel = 1;
+    _txLevel = 1;
+    _txDecodedTo = 0;
+    _sentFramingErrors = 0;
+    _compareA = 0;
+    _compareB = 0;
+    _compareAMatch = NO_EVENT;
+    _compareBMatch = NO_EVENT;
+    _interrupt = NO_EVENT;
+    _captureFlag = false;
+    _compareAFlag = false;
+    _compareBFlag = false;
+    activeHarness = this;
+}
+
+AltSoftSerialHarness::~AltSoftSerialHarness() {
+    activeHarness = NULL;
+}
+
+uint8_t AltSoftSerialHarness::prescale() {
+    return altss_host_timer.prescale ? altss_host_timer.prescale : 1;
+}
+
+void AltSoftSerialHarness::setInterruptLatency(double minMicros, double maxMicros) {
+    _latencyMin = minMicros * CYCLES_PER_MICRO;
+    _latencyMax = maxMicros * CYCLES_PER_MICRO;
+}
+
+void AltSoftSerialHarness::setEdgeJitter(double micros) {
+    _jitter = micros * CYCLES_PER_MICRO;
+}
+
+double AltSoftSerialHarness::micros() {
+    return (double)_now / CYCLES_PER_MICRO;
+}
+
+uint64_t AltSoftSerialHarness::latency() {
+    if (_latencyMax <= _latencyMin) {
+        return _latencyMin;
+    }
+    std::uniform_int_distribution<uint64_t> distribution(_latencyMin, _latencyMax);
+    return distribution(_random);
+}
+
+double AltSoftSerialHarness::inject(const uint8_t *buffer, size_t size, uint32_t baud, bool stopBitLow) {
+    double bitCycles = (double)ALTSS_HOST_TIMER_FREQ / baud;
+    double start = _rxLineFree > _now ? _rxLineFree : _now;
+    std::uniform_real_distribution<double> jitter(-_jitter, _jitter);
+    for (size_t i = 0; i < size; i++) {
+        // Start bit, data LSB first, stop bit, and back to idle after a low one
+        uint8_t levels[11];
+        int bitCount = stopBitLow ? 11 : 10;
+        levels[0] = 0;
+        for (int bit = 0; bit < 8; bit++) {
+            levels[bit + 1] = (buffer[i] >> bit) & 1;
+        }
+        levels[9] = stopBitLow ? 0 : 1;
+        levels[10] = 1;
+        for (int bit = 0; bit < bitCount; bit++) {
+            if (levels[bit] == _rxQueuedLevel) {
+                continue;
+            }
+            double time = start + bit * bitCycles + (_jitter > 0 ? jitter(_random) : 0);
+            uint64_t edgeTime = time < _now ? _now : (uint64_t)time;
+            if (!_rxEdges.empty() && edgeTime <= _rxEdges.back().time) {
+                edgeTime = _rxEdges.back().time + 1;
+            }
+            Edge edge = {edgeTime, levels[bit]};
+            _rxEdges.push_back(edge);
+            _rxQueuedLevel = levels[bit];
+        }
+        start += bitCount * bitCycles;
+    }
+    _rxLineFree = start;
+    return start / CYCLES_PER_MICRO;
+}
+
+double AltSoftSerialHarness::inject(const char *string, uint32_t baud) {
+    return inject((const uint8_t *)string, strlen(string), baud);
+}
+
+void AltSoftSerialHarness::run(double micros) {
+    advance(_now + (uint64_t)(micros * CYCLES_PER_MICRO));
+}
+
+void AltSoftSerialHarness::step() {
+    uint64_t next = nextEvent();
+    if (next == NO_EVENT) {
+        fprintf(stderr, "AltSoftSerialHarness has nothing left to run\n");
+        abort();
+    }
+    advance(next);
+}
+
+// Picks up compare values the library changed since the last event
+void AltSoftSerialHarness::schedule() {
+    uint64_t ticks = cyclesToTicks(_now);
+    if (altss_host_timer.compare_a != _compareA || _compareAMatch == NO_EVENT) {
+        _compareA = altss_host_timer.compare_a;
+        uint32_t delta = (uint16_t)(_compareA - (uint16_t)ticks);
+        _compareAMatch = ticksToCycles(ticks + (delta ? delta : TIMER_PERIOD_TICKS));
+    }
+    while (_compareAMatch < _now) {
+        _compareAMatch += ticksToCycles(TIMER_PERIOD_TICKS);
+    }
+    if (altss_host_timer.compare_b != _compareB || _compareBMatch == NO_EVENT) {
+        _compareB = altss_host_timer.compare_b;
+        uint32_t delta = (uint16_t)(_compareB - (uint16_t)ticks);
+        _compareBMatch = ticksToCycles(ticks + (delta ? delta : TIMER_PERIOD_TICKS));
+    }
+    while (_compareBMatch < _now) {
+        _compareBMatch += ticksToCycles(TIMER_PERIOD_TICKS);
+    }
+}
+
+uint64_t AltSoftSerialHarness::nextEvent() {
+    schedule();
+    uint64_t next = NO_EVENT;
+    if (!_rxEdges.empty()) {
+        next = _rxEdges.front().time;
+    }
+    if ((altss_host_timer.match_a != ALTSS_HOST_MATCH_NORMAL || altss_host_timer.compare_a_enabled) && _compareAMatch < next) {
+        next = _compareAMatch;
+    }
+    if (altss_host_timer.compare_b_enabled && _compareBMatch < next) {
+        next = _compareBMatch;
+    }
+    if (_interrupt < next) {
+        next = _interrupt;
+    }
+    return next;
+}
+
+void AltSoftSerialHarness::raiseInterrupt(bool *flag) {
+    *flag = true;
+    if (_interrupt == NO_EVENT) {
+        _interrupt = _now + latency();
+    }
+}
+
+void AltSoftSerialHarness::recordTxLevel() {
+    if (altss_host_timer.tx_level != _txLevel) {
+        _txLevel = altss_host_timer.tx_level;
+        Edge edge = {_now, _txLevel};
+        _txEdges.push_back(edge);
+    }
+}
+
+void AltSoftSerialHarness::advance(uint64_t until) {
+    while (true) {
+        uint64_t next = nextEvent();
+        if (next > until) {
+            break;
+        }
+        _now = next;
+        // What the pins and the timer do happens first, then the interrupts they raised
+        if (!_rxEdges.empty() && _rxEdges.front().time == _now) {
+            uint8_t level = _rxEdges.front().level;
+            _rxEdges.pop_front();
+            if (altss_host_timer.capture_enabled && level == (altss_host_timer.capture_rising ? 1 : 0)) {
+                // A second edge before the ISR reads the capture overwrites it
+                altss_host_timer.capture = (uint16_t)cyclesToTicks(_now);
+                raiseInterrupt(&_captureFlag);
+            }
+        } else if (_compareAMatch == _now && (altss_host_timer.match_a != ALTSS_HOST_MATCH_NORMAL || altss_host_timer.compare_a_enabled)) {
+            switch (altss_host_timer.match_a) {
+                case ALTSS_HOST_MATCH_CLEAR:
+                    altss_host_timer.tx_level = 0;
+                    break;
+                case ALTSS_HOST_MATCH_SET:
+                    altss_host_timer.tx_level = 1;
+                    break;
+                case ALTSS_HOST_MATCH_TOGGLE:
+                    altss_host_timer.tx_level ^= 1;
+                    break;
+            }
+            recordTxLevel();
+            if (altss_host_timer.compare_a_enabled) {
+                raiseInterrupt(&_compareAFlag);
+            }
+            _compareAMatch += ticksToCycles(TIMER_PERIOD_TICKS);
+        } else if (_compareBMatch == _now && altss_host_timer.compare_b_enabled) {
+            raiseInterrupt(&_compareBFlag);
+            _compareBMatch += ticksToCycles(TIMER_PERIOD_TICKS);
+        } else if (_interrupt == _now) {
+            bool capture = _captureFlag;
+            bool compareA = _compareAFlag;
+            bool compareB = _compareBFlag;
+            _interrupt = NO_EVENT;
+            _captureFlag = _compareAFlag = _compareBFlag = false;
+            // An earlier handler can turn a later one's interrupt off
+            if (capture && altss_host_timer.capture_enabled) {
+                altss_capture_interrupt();
+            }
+            if (compareA && altss_host_timer.compare_a_enabled) {
+                altss_compare_a_interrupt();
+            }
+            if (compareB && altss_host_timer.compare_b_enabled) {
+                altss_compare_b_interrupt();
+            }
+        }
+        recordTxLevel();
+    }
+    if (until > _now) {
+        _now = until;
+    }
+}
+
+uint8_t AltSoftSerialHarness::txLevelAt(double time) {
+    uint8_t level = 1;
+    for (size_t i = 0; i < _txEdges.size() && _txEdges[i].time <= time; i++) {
+        level = _txEdges[i].level;
+    }
+    return level;
+}
+
+std::vector<uint8_t> AltSoftSerialHarness::takeSent(uint32_t baud) {
+    double bitCycles = (double)ALTSS_HOST_TIMER_FREQ / baud;
+    std::vector<uint8_t> sent;
+    for (size_t i = 0; i < _txEdges.size(); i++) {
+        const Edge &edge = _txEdges[i];
+        if (edge.level || edge.time < _txDecodedTo) {
+            continue;
+        }
+        // A start bit. Sample in the middle of each bit, once the whole character is out.
+        double start = edge.time;
+        if (start + 10 * bitCycles > _now) {
+            break;
+        }
+        uint8_t byte = 0;
+        for (int bit = 0; bit < 8; bit++) {
+            byte |= txLevelAt(start + (bit + 1.5) * bitCycles) << bit;
+        }
+        if (!txLevelAt(start + 9.5 * bitCycles)) {
+            _sentFramingErrors++;
+        }
+        sent.push_back(byte);
+        _txDecodedTo = start + 9.5 * bitCycles;
+    }
+    return sent;
+}
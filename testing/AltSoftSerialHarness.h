@@ -0,0 +1,82 @@
+#ifndef AltSoftSerialHarness_h
+#define AltSoftSerialHarness_h
+
+#include "../libraries/AltSoftSerial/AltSoftSerial.h"
+#include <deque>
+#include <random>
+#include <vector>
+
+/*!
+Runs AltSoftSerial's ISRs against the emulated timer in config/AltSoftSerial_HostEmulation.h, for a build with
+ALTSS_HOST_EMULATION. Edges injected on the RX line are captured and compare A matches drive the TX line in hardware,
+like FTM0 does, while the interrupt runs some latency after the event that raised it, standing in for whatever else had
+interrupts off. Time only moves in run(), or while the library waits for room in its TX buffer.
+
+There's only one AltSoftSerial, so only one harness can exist at a time. Create it before the AltSoftSerial, so it's still
+there when the AltSoftSerial's destructor waits for the TX buffer to empty.
+*/
+class AltSoftSerialHarness
+{
+public:
+    AltSoftSerialHarness(uint32_t seed = 1);
+    ~AltSoftSerialHarness();
+    //! The interrupt runs between minMicros and maxMicros after the first event that raised it
+    void setInterruptLatency(double minMicros, double maxMicros);
+    //! Each injected edge lands up to this far either side of where it belongs
+    void setEdgeJitter(double micros);
+    //! Puts bytes on the RX line after anything injected before. Returns when the last stop bit ends, in micros.
+    double inject(const uint8_t *buffer, size_t size, uint32_t baud, bool stopBitLow = false);
+    double inject(const char *string, uint32_t baud);
+    //! Moves time forward, running interrupts as they come due
+    void run(double micros);
+    //! Runs until the next edge, compare match or interrupt
+    void step();
+    double micros();
+    //! The counter GET_TIMER_COUNT() reads
+    uint16_t timerCount() { return (uint16_t)cyclesToTicks(_now); }
+    //! Decodes the characters that have gone out on the TX line since the last call
+    std::vector<uint8_t> takeSent(uint32_t baud);
+    //! Characters takeSent() found with a low stop bit
+    int sentFramingErrors() { return _sentFramingErrors; }
+private:
+    typedef struct {
+        uint64_t time;
+        uint8_t level;
+    } Edge;
+    uint64_t ticksToCycles(uint64_t ticks) { return ticks * prescale(); }
+    uint64_t cyclesToTicks(uint64_t cycles) { return cycles / prescale(); }
+    uint64_t latency();
+    uint64_t nextEvent();
+    void advance(uint64_t until);
+    void schedule();
+    void raiseInterrupt(bool *flag);
+    void recordTxLevel();
+    uint8_t txLevelAt(double time);
+    static uint8_t prescale();
+
+    // Time in timer input clock cycles, at ALTSS_HOST_TIMER_FREQ
+    uint64_t _now;
+    std::mt19937 _random;
+    uint64_t _latencyMin;
+    uint64_t _latencyMax;
+    double _jitter;
+    std::deque<Edge> _rxEdges;
+    double _rxLineFree;
+    uint8_t _rxQueuedLevel;
+    std::vector<Edge> _txEdges;
+    uint8_t _txLevel;
+    double _txDecodedTo;
+    int _sentFramingErrors;
+    uint16_t _compareA;
+    uint16_t _compareB;
+    uint64_t _compareAMatch;
+    uint64_t _compareBMatch;
+    // FTM0 has one interrupt for all its channels. It runs at _interrupt, or NO_EVENT when no channel has a flag set,
+    // and handles every flag set by then, in the order ftm0_isr() checks them.
+    uint64_t _interrupt;
+    bool _captureFlag;
+    bool _compareAFlag;
+    bool _compareBFlag;
+};
+
+#endif
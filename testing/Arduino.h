@@ -3,60 +3,122 @@
 
 #include "inttypes.h"
 #include "stdlib.h"
+#include <stddef.h>
+#include <deque>
+#include <vector>
 
 #define DEC 10
 #define HEX 16
 #define OCT 8
 #define BIN 2
 
-#ifndef min
-#define min(a, b) (a < b ? a : b)
-#endif
+// Serial formats, same values as the Teensy core
+#define SERIAL_8N1 0x00
+#define SERIAL_9N1 0x84
+#define SERIAL_9N1_RXINV_TXINV 0xB4
+
+// The Teensy core's min is a macro, which breaks the standard headers on the host
+#include <algorithm>
+using std::min;
+
+// Simulated clock. Time only moves when a test moves it, so timing dependent tests are deterministic.
+uint32_t millis();
+uint32_t micros();
+void mockSetMicros(uint32_t micros);
+void mockAdvanceMicros(uint32_t micros);
 
+/*!
+Host stand-in for HardwareSerial. Bytes move between the RX/TX buffers and the "wire" at the configured baud rate as the
+simulated clock advances, so a test can check throughput, overflows and latency. A baud rate of 0 (the default, and what
+Serial uses since USB ignores it) moves bytes instantly.
+*/
 class MockSerial
 {
 public:
-	MockSerial() { }
-	static void begin(uint32_t baud) { }
-	static void end();
-	int peek() { return 0; }
-	int read() { return 0; }
-	int available() { return 0; }
-	size_t write(uint8_t byte) { return 0; }
-	void flush() {  }
-	static void flushInput();
-	static void flushOutput();
-	bool overflow() { return false; }
-	static int library_version() { return 0; }
-	static void enable_timer0(bool enable) { }
-	static bool timing_error;
+	MockSerial(int rxBufferSize = 64, int txBufferSize = 64);
+	void begin(uint32_t baud, uint32_t format = 0);
+	void setBufferSizes(int rxBufferSize, int txBufferSize) { _rxBufferSize = rxBufferSize; _txBufferSize = txBufferSize; }
+	void end() { }
+	int peek();
+	int read();
+	int available();
+	int availableForWrite();
+	size_t write(uint8_t byte);
+	size_t write(const uint8_t *buffer, size_t size);
+	size_t write(const char *string);
+	//! Writes the low 9 bits of data as one character, like the Teensy UARTs in 9 bit mode
+	size_t write9bit(uint32_t data);
+	//! Waits, moving the simulated clock, until everything written is on the wire
+	void flush();
+	void clear();
+	bool overflow() { bool overflowed = _overflowed; _overflowed = false; return overflowed; }
+
+	size_t print(const char[]);
+	size_t print(char);
+	size_t print(unsigned char, int = DEC);
+	size_t print(int, int = DEC);
+	size_t print(unsigned int, int = DEC);
+	size_t print(long, int = DEC);
+	size_t print(unsigned long, int = DEC);
+	size_t print(double, int = 2);
+
+	size_t println(const char[]);
+	size_t println(char);
+	size_t println(unsigned char, int = DEC);
+	size_t println(int, int = DEC);
+	size_t println(unsigned int, int = DEC);
+	size_t println(long, int = DEC);
+	size_t println(unsigned long, int = DEC);
+	size_t println(double, int = 2);
+	size_t println(void);
 
-    // size_t print(const __FlashStringHelper *) { return 0; }
-    // size_t print(const String &) { return 0; }
-    size_t print(const char[]) { return 0; }
-    size_t print(char) { return 0; }
-    size_t print(unsigned char, int = DEC) { return 0; }
-    size_t print(int, int = DEC) { return 0; }
-    size_t print(unsigned int, int = DEC) { return 0; }
-    size_t print(long, int = DEC) { return 0; }
-    size_t print(unsigned long, int = DEC) { return 0; }
-    size_t print(double, int = 2) { return 0; }
-    // size_t print(const Printable&) { return 0; }
+	int printf(const char *format, ...);
 
-    // size_t println(const __FlashStringHelper *) { return 0; }
-    // size_t println(const String &s) { return 0; }
-    size_t println(const char[]) { return 0; }
-    size_t println(char) { return 0; }
-    size_t println(unsigned char, int = DEC) { return 0; }
-    size_t println(int, int = DEC) { return 0; }
-    size_t println(unsigned int, int = DEC) { return 0; }
-    size_t println(long, int = DEC) { return 0; }
-    size_t println(unsigned long, int = DEC) { return 0; }
-    size_t println(double, int = 2) { return 0; }
-    // size_t println(const Printable&) { return 0; }
-    size_t println(void) { return 0; }
+	// The far end of the wire, for tests
+	//! Puts bytes on the wire towards us. They land in the RX buffer as the clock advances, or are lost if it's full. Returns when the last one lands.
+	uint32_t inject(const uint8_t *buffer, size_t size);
+	uint32_t inject(const char *string);
+	//! Puts one 9 bit character on the wire towards us
+	uint32_t inject9bit(uint16_t data);
+	//! Characters injected that are still on the wire
+	int wireBacklog() { update(); return _incoming.size(); }
+	//! Characters written that haven't made it out on the wire yet
+	int txBacklog() { update(); return _txBuffer.size(); }
+	//! Characters that have made it all the way out on the wire since the last takeSent(), 9th bit included
+	std::vector<uint16_t> takeSent();
+	//! Wire time of each character returned by the last takeSent(), in micros
+	const std::vector<uint32_t> &sentTimes() { return _lastSentTimes; }
+	//! Characters lost because the RX buffer was full
+	uint32_t overflowCount() { update(); return _overflowCount; }
+	//! Always 0, characters land on the simulated wire exactly on time
+	uint32_t latencyOverrunCount() { return 0; }
+	uint32_t framingErrorCount() { return 0; }
+	//! Most characters the RX buffer has held at once
+	int rxHighWater() { return _rxHighWater; }
+	//! Microseconds one character takes on the wire at the current baud rate
+	double characterMicros();
+private:
+	typedef struct {
+		uint16_t data;
+		double time;
+	} Character;
+	void update();
 
-	int printf(const char *format, ...) { return 0; }
+	int _rxBufferSize;
+	int _txBufferSize;
+	uint32_t _baud;
+	int _bitsPerCharacter;
+	std::deque<Character> _incoming;
+	std::deque<uint16_t> _rxBuffer;
+	std::deque<Character> _txBuffer;
+	double _rxWireFree;
+	double _txWireFree;
+	std::vector<uint16_t> _sent;
+	std::vector<uint32_t> _sentTimes;
+	std::vector<uint32_t> _lastSentTimes;
+	uint32_t _overflowCount;
+	bool _overflowed;
+	int _rxHighWater;
 };
 
 extern MockSerial Serial;
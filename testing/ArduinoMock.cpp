@@ -1,3 +1,210 @@
 #include "Arduino.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <cstring>
 
 MockSerial Serial;
+
+static uint32_t mockMicros = 0;
+
+uint32_t millis() {
+    return mockMicros / 1000;
+}
+
+uint32_t micros() {
+    return mockMicros;
+}
+
+void mockSetMicros(uint32_t micros) {
+    mockMicros = micros;
+}
+
+void mockAdvanceMicros(uint32_t micros) {
+    mockMicros += micros;
+}
+
+MockSerial::MockSerial(int rxBufferSize, int txBufferSize) {
+    _rxBufferSize = rxBufferSize;
+    _txBufferSize = txBufferSize;
+    _baud = 0;
+    _bitsPerCharacter = 10;
+    _rxWireFree = 0;
+    _txWireFree = 0;
+    _overflowCount = 0;
+    _overflowed = false;
+    _rxHighWater = 0;
+}
+
+void MockSerial::begin(uint32_t baud, uint32_t format) {
+    _baud = baud;
+    // Start bit, 8 or 9 data bits, stop bit
+    _bitsPerCharacter = (format & 0x80) ? 11 : 10;
+}
+
+double MockSerial::characterMicros() {
+    if (!_baud) {
+        return 0;
+    }
+    return _bitsPerCharacter * 1000000.0 / _baud;
+}
+
+void MockSerial::update() {
+    double now = micros();
+    while (!_incoming.empty() && _incoming.front().time <= now) {
+        if ((int)_rxBuffer.size() < _rxBufferSize) {
+            _rxBuffer.push_back(_incoming.front().data);
+            _rxHighWater = std::max(_rxHighWater, (int)_rxBuffer.size());
+        } else {
+            _overflowCount++;
+            _overflowed = true;
+        }
+        _incoming.pop_front();
+    }
+    while (!_txBuffer.empty() && _txBuffer.front().time <= now) {
+        _sent.push_back(_txBuffer.front().data);
+        _sentTimes.push_back((uint32_t)_txBuffer.front().time);
+        _txBuffer.pop_front();
+    }
+}
+
+int MockSerial::peek() {
+    update();
+    return _rxBuffer.empty() ? -1 : _rxBuffer.front();
+}
+
+int MockSerial::read() {
+    update();
+    if (_rxBuffer.empty()) {
+        return -1;
+    }
+    int c = _rxBuffer.front();
+    _rxBuffer.pop_front();
+    return c;
+}
+
+int MockSerial::available() {
+    update();
+    return _rxBuffer.size();
+}
+
+int MockSerial::availableForWrite() {
+    update();
+    return _txBufferSize - _txBuffer.size();
+}
+
+size_t MockSerial::write9bit(uint32_t data) {
+    update();
+    // A real UART blocks until there's room
+    while ((int)_txBuffer.size() >= _txBufferSize) {
+        mockSetMicros((uint32_t)_txBuffer.front().time);
+        update();
+    }
+    Character character;
+    character.data = data & 0x1FF;
+    _txWireFree = std::max(_txWireFree, (double)micros()) + characterMicros();
+    character.time = _txWireFree;
+    _txBuffer.push_back(character);
+    update();
+    return 1;
+}
+
+size_t MockSerial::write(uint8_t byte) {
+    return write9bit(byte);
+}
+
+size_t MockSerial::write(const uint8_t *buffer, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        write9bit(buffer[i]);
+    }
+    return size;
+}
+
+size_t MockSerial::write(const char *string) {
+    return write((const uint8_t *)string, strlen(string));
+}
+
+void MockSerial::flush() {
+    if (!_txBuffer.empty()) {
+        mockSetMicros((uint32_t)_txBuffer.back().time);
+    }
+    update();
+}
+
+void MockSerial::clear() {
+    update();
+    _rxBuffer.clear();
+}
+
+uint32_t MockSerial::inject9bit(uint16_t data) {
+    Character character;
+    character.data = data & 0x1FF;
+    _rxWireFree = std::max(_rxWireFree, (double)micros()) + characterMicros();
+    character.time = _rxWireFree;
+    _incoming.push_back(character);
+    update();
+    return (uint32_t)character.time;
+}
+
+uint32_t MockSerial::inject(const uint8_t *buffer, size_t size) {
+    uint32_t time = micros();
+    for (size_t i = 0; i < size; i++) {
+        time = inject9bit(buffer[i]);
+    }
+    return time;
+}
+
+uint32_t MockSerial::inject(const char *string) {
+    return inject((const uint8_t *)string, strlen(string));
+}
+
+std::vector<uint16_t> MockSerial::takeSent() {
+    update();
+    std::vector<uint16_t> sent;
+    sent.swap(_sent);
+    _lastSentTimes.swap(_sentTimes);
+    _sentTimes.clear();
+    return sent;
+}
+
+static const char *formatForBase(int base, bool isLong, bool isUnsigned) {
+    if (base == HEX) {
+        return isLong ? "%lX" : "%X";
+    } else if (base == OCT) {
+        return isLong ? "%lo" : "%o";
+    }
+    if (isUnsigned) {
+        return isLong ? "%lu" : "%u";
+    }
+    return isLong ? "%ld" : "%d";
+}
+
+size_t MockSerial::print(const char string[]) { return write(string); }
+size_t MockSerial::print(char c) { return write((uint8_t)c); }
+size_t MockSerial::print(unsigned char n, int base) { return print((unsigned int)n, base); }
+size_t MockSerial::print(int n, int base) { return printf(formatForBase(base, false, false), n); }
+size_t MockSerial::print(unsigned int n, int base) { return printf(formatForBase(base, false, true), n); }
+size_t MockSerial::print(long n, int base) { return printf(formatForBase(base, true, false), n); }
+size_t MockSerial::print(unsigned long n, int base) { return printf(formatForBase(base, true, true), n); }
+size_t MockSerial::print(double n, int digits) { return printf("%.*f", digits, n); }
+
+size_t MockSerial::println(const char string[]) { return print(string) + println(); }
+size_t MockSerial::println(char c) { return print(c) + println(); }
+size_t MockSerial::println(unsigned char n, int base) { return print(n, base) + println(); }
+size_t MockSerial::println(int n, int base) { return print(n, base) + println(); }
+size_t MockSerial::println(unsigned int n, int base) { return print(n, base) + println(); }
+size_t MockSerial::println(long n, int base) { return print(n, base) + println(); }
+size_t MockSerial::println(unsigned long n, int base) { return print(n, base) + println(); }
+size_t MockSerial::println(double n, int digits) { return print(n, digits) + println(); }
+size_t MockSerial::println(void) { return write("\r\n"); }
+
+int MockSerial::printf(const char *format, ...) {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length < 0) {
+        return 0;
+    }
+    return write((const uint8_t *)buffer, std::min((size_t)length, sizeof(buffer) - 1));
+}
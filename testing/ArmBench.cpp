@@ -0,0 +1,280 @@
+//
+//  ArmBench.cpp
+//  Helm
+//
+//  The parser and codec hot paths, built with the firmware's arm-none-eabi flags and run under user mode emulation so
+//  their instruction counts reflect soft double math and newlib's sprintf/atof. testing/armbench.sh runs each benchmark
+//  twice, with 0 and with N ops, and divides the difference in instructions by N. Run with `make bench-arm`.
+//
+//      armbench --list             names of the benchmarks
+//      armbench NAME OPS           runs OPS ops of one benchmark
+//
+//  Every op handles one sentence or datagram, cycling through the corpus below, which mirrors testing/bench. It's
+//  compiled in since the emulator can't be relied on to give us files.
+//
+
+#include "Arduino.h"
+#include "../NMEAParser.h"
+#include "../NMEAMessage.h"
+#include "../SeaTalkMessage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <cstring>
+
+#define ARM_BENCH_COUNT(array) (sizeof(array) / sizeof(array[0]))
+
+static const char *rmcSentences[] = {
+    "$GPRMC,045430.00,A,3751.98405,N,12218.96980,W,0.078,,041114,,,D*69",
+    "$GPRMC,045431.00,A,3751.98405,N,12218.96980,W,0.078,45.2,041114,42.2,W,D*38",
+    "$GPRMC,045432.00,A,3751.98415,N,12218.97005,W,5.132,211.0,041114,13.5,E,D*15",
+};
+static const char *rmbSentences[] = {
+    "$ECRMB,A,0.000,L,tospace,001,3751.944,N,12219.721,W,0.596,266.197,0.055,V*48",
+    "$GPRMB,A,0.66,L,003,004,4917.24,N,12309.57,W,001.3,052.5,000.5,V*20",
+};
+static const char *apbSentences[] = {
+    "$ECAPB,A,A,2.345,L,N,V,V,266.243,T,001,266.197,T,266.197,T*35",
+};
+static const char *gllSentences[] = {
+    "$GPGLL,3751.98415,N,12218.97005,W,045445.00,A,D*78",
+};
+static const char *seaSentences[] = {
+    "$STSEA,9C010000*07",
+    "$STSEA,861101FE*70",
+    "$STSEA,1001005A*08",
+};
+// What the parser sees, the GPS chatter the router mostly forwards as well as what it translates
+static const char *streamSentences[] = {
+    "$GPRMC,045432.00,A,3751.98415,N,12218.97005,W,5.132,211.0,041114,13.5,E,D*15\r\n",
+    "$GPGGA,045432.00,3751.98415,N,12218.97005,W,2,09,0.95,8.2,M,-25.6,M,,0000*68\r\n",
+    "$GPGSV,4,1,16,00,67,054,31,01,12,314,22,02,41,253,40,03,22,084,17*73\r\n",
+    "!AIVDM,1,1,,A,13u?etPv2;0n:dDPwUM1U1Cb069D,0*24\r\n",
+    "$ECRMB,A,0.000,L,tospace,001,3751.944,N,12219.721,W,0.596,266.197,0.055,V*48\r\n",
+    "$WIMWV,315.4,R,12.2,N,A*11\r\n",
+};
+static const uint8_t seaTalkDatagrams[][SEATALK_MESSAGE_MAX_LENGTH] = {
+    {0x00, 0x02, 0x00, 0xEA, 0x00},
+    {0x10, 0x01, 0x00, 0x5A},
+    {0x11, 0x01, 0x0C, 0x03},
+    {0x20, 0x01, 0x40, 0x00},
+    {0x9C, 0x41, 0x5A, 0x00},
+    {0x84, 0xC6, 0x5A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C},
+    {0x85, 0x66, 0x56, 0x30, 0x15, 0x00, 0x20, 0x27, 0xDF},
+    {0x50, 0x02, 0x25, 0xDE, 0x0E},
+    {0x53, 0x30, 0x2D},
+    {0x82, 0x05, 0x00, 0xFF, 0x20, 0xDF, 0x40, 0xBF},
+};
+
+// Results are added up in here so the compiler can't throw the work away
+static volatile uint32_t sink;
+
+static const uint8_t *seaTalkDatagram(uint32_t op, int *length) {
+    const uint8_t *datagram = seaTalkDatagrams[op % ARM_BENCH_COUNT(seaTalkDatagrams)];
+    // The low nibble of the attribute byte is the number of data bytes after the first
+    *length = (datagram[1] & 0x0F) + 3;
+    return datagram;
+}
+
+static NMEAParser parser;
+
+static void benchParse(uint32_t op) {
+    for (const char *c = streamSentences[op % ARM_BENCH_COUNT(streamSentences)]; *c; c++) {
+        sink += parser.parse(*c);
+    }
+}
+
+static void benchSplitMessageIntoFragments(uint32_t op) {
+    const char *sentence = rmcSentences[op % ARM_BENCH_COUNT(rmcSentences)];
+    NMEAFragment fragments[32];
+    int fragmentCount = 0;
+    splitMessageIntoFragments(sentence, strlen(sentence), fragments, ARM_BENCH_COUNT(fragments), &fragmentCount);
+    sink += fragmentCount;
+}
+
+static void benchCloseMessage(uint32_t op) {
+    char message[NMEA_MESSAGE_MAX_LENGTH];
+    const char *sentence = rmcSentences[op % ARM_BENCH_COUNT(rmcSentences)];
+    size_t length = strchr(sentence, '*') - sentence;
+    memcpy(message, sentence, length);
+    message[length] = '\0';
+    closeMessage(message);
+    sink += message[length + 1];
+}
+
+static void benchRMC(uint32_t op) {
+    NMEAMessageRMC message(rmcSentences[op % ARM_BENCH_COUNT(rmcSentences)]);
+    sink += message.status();
+}
+
+static void benchRMB(uint32_t op) {
+    NMEAMessageRMB message(rmbSentences[op % ARM_BENCH_COUNT(rmbSentences)]);
+    sink += message.status();
+}
+
+static void benchAPB(uint32_t op) {
+    NMEAMessageAPB message(apbSentences[op % ARM_BENCH_COUNT(apbSentences)]);
+    sink += message.isArrived();
+}
+
+static void benchGLL(uint32_t op) {
+    NMEAMessageGLL message(gllSentences[op % ARM_BENCH_COUNT(gllSentences)]);
+    sink += message.time().hour;
+}
+
+static void benchSEADecode(uint32_t op) {
+    NMEAMessageSEA message(seaSentences[op % ARM_BENCH_COUNT(seaSentences)]);
+    sink += message.seaTalkMessageLength();
+}
+
+static void benchSEAEncode(uint32_t op) {
+    int length;
+    const uint8_t *datagram = seaTalkDatagram(op, &length);
+    NMEAMessageSEA message(datagram, length);
+    sink += message.message()[1];
+}
+
+static void benchWind(uint32_t op) {
+    NMEAMessageWind message(op % 3600, 1220);
+    sink += message.message()[1];
+}
+
+static void benchDBT(uint32_t op) {
+    NMEAMessageDBT message(243 + op % 100);
+    sink += message.message()[1];
+}
+
+static void benchVHW(uint32_t op) {
+    NMEAMessageVHW message(640 + op % 1000);
+    sink += message.message()[1];
+}
+
+static void benchHDM(uint32_t op) {
+    NMEAMessageHDM message(op % 3600);
+    sink += message.message()[1];
+}
+
+static void benchNewSeaTalkMessage(uint32_t op) {
+    int length;
+    const uint8_t *datagram = seaTalkDatagram(op, &length);
+    BaseSeaTalkMessage *message = newSeaTalkMessage(datagram, length);
+    sink += message->message()[0];
+    delete message;
+}
+
+static void benchDepth(uint32_t op) {
+    SeaTalkMessageDepth message(243 + op % 100);
+    sink += message.message()[2];
+}
+
+static void benchSpeedThroughWater(uint32_t op) {
+    SeaTalkMessageSpeedThroughWater message(640 + op % 1000);
+    sink += message.message()[2];
+}
+
+static void benchLatitude(uint32_t op) {
+    SeaTalkMessageLatitude message(378664000 + (op % 100) * 1000);
+    sink += message.message()[2];
+}
+
+static void benchLongitude(uint32_t op) {
+    SeaTalkMessageLongitude message(-1223161000 + (op % 100) * 1000);
+    sink += message.message()[2];
+}
+
+static void benchSpeedOverGround(uint32_t op) {
+    SeaTalkMessageSpeedOverGround message(510 + op % 1000);
+    sink += message.message()[2];
+}
+
+static void benchMagneticCourse(uint32_t op) {
+    SeaTalkMessageMagneticCourse message(op % 3600);
+    sink += message.message()[1];
+}
+
+static void benchTime(uint32_t op) {
+    Time time = {4, (uint8_t)(op % 60), 30500};
+    SeaTalkMessageTime message(time);
+    sink += message.message()[2];
+}
+
+static void benchDate(uint32_t op) {
+    Date date = {(uint8_t)(op % 28 + 1), 11, 2014};
+    SeaTalkMessageDate message(date);
+    sink += message.message()[2];
+}
+
+static void benchTargetWaypointName(uint32_t op) {
+    SeaTalkMessageTargetWaypointName message("tospace");
+    sink += message.message()[2];
+}
+
+static void benchNavigationToWaypoint(uint32_t op) {
+    Heading bearing = {2662, true};
+    SeaTalkMessageNavigationToWaypoint message(66, bearing, 130 + (op % 10) * 100, LateralityLeft, 0x7);
+    sink += message.message()[2];
+}
+
+static void benchArrivalInfo(uint32_t op) {
+    SeaTalkMessageArrivalInfo message(op % 2, true, "tospace");
+    sink += message.message()[2];
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(uint32_t op);
+} ArmBenchmark;
+
+static const ArmBenchmark benchmarks[] = {
+    {"NMEAParser::parse", benchParse},
+    {"splitMessageIntoFragments", benchSplitMessageIntoFragments},
+    {"closeMessage", benchCloseMessage},
+    {"NMEAMessageRMC", benchRMC},
+    {"NMEAMessageRMB", benchRMB},
+    {"NMEAMessageAPB", benchAPB},
+    {"NMEAMessageGLL", benchGLL},
+    {"NMEAMessageSEA(decode)", benchSEADecode},
+    {"NMEAMessageSEA(encode)", benchSEAEncode},
+    {"NMEAMessageWind", benchWind},
+    {"NMEAMessageDBT", benchDBT},
+    {"NMEAMessageVHW", benchVHW},
+    {"NMEAMessageHDM", benchHDM},
+    {"newSeaTalkMessage", benchNewSeaTalkMessage},
+    {"SeaTalkMessageDepth", benchDepth},
+    {"SeaTalkMessageSpeedThroughWater", benchSpeedThroughWater},
+    {"SeaTalkMessageLatitude", benchLatitude},
+    {"SeaTalkMessageLongitude", benchLongitude},
+    {"SeaTalkMessageSpeedOverGround", benchSpeedOverGround},
+    {"SeaTalkMessageMagneticCourse", benchMagneticCourse},
+    {"SeaTalkMessageTime", benchTime},
+    {"SeaTalkMessageDate", benchDate},
+    {"SeaTalkMessageTargetWaypointName", benchTargetWaypointName},
+    {"SeaTalkMessageNavigationToWaypoint", benchNavigationToWaypoint},
+    {"SeaTalkMessageArrivalInfo", benchArrivalInfo},
+};
+
+int main(int argc, char **argv) {
+    if (argc == 2 && strcmp(argv[1], "--list") == 0) {
+        for (size_t i = 0; i < ARM_BENCH_COUNT(benchmarks); i++) {
+            printf("%s\n", benchmarks[i].name);
+        }
+        return 0;
+    }
+    if (argc != 3) {
+        printf("Usage: armbench --list | NAME OPS\n");
+        return 1;
+    }
+    uint32_t ops = strtoul(argv[2], NULL, 10);
+    for (size_t i = 0; i < ARM_BENCH_COUNT(benchmarks); i++) {
+        if (strcmp(argv[1], benchmarks[i].name) == 0) {
+            // The run with 0 ops still touches the first op's code so one time setup, like newlib's locale and stdio
+            // buffers, cancels out of the difference
+            benchmarks[i].run(0);
+            for (uint32_t op = 0; op < ops; op++) {
+                benchmarks[i].run(op);
+            }
+            return 0;
+        }
+    }
+    printf("No benchmark named %s\n", argv[1]);
+    return 1;
+}
@@ -0,0 +1,421 @@
+//
+//  Bench.cpp
+//  Helm
+//
+//  Microbenchmarks for the parsers and message codecs, run over the sentences and datagrams in testing/bench. Prints
+//  ns/op, bytes/s and allocations per op, optionally writes them as JSON, and compares them against a baseline.
+//  Build and run with `make bench`, refresh the baseline with `make bench-baseline`. The baseline's timings only mean
+//  something on the machine that wrote them, so make bench only compares against it when asked with --baseline.
+//
+
+#include "Arduino.h"
+#include "AllocationCounter.h"
+#include "../NMEAParser.h"
+#include "../NMEAMessage.h"
+#include "../SeaTalkMessage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+
+// Each benchmark is timed in batches of about this long, and the fastest batch wins
+#define BENCH_DEFAULT_MIN_TIME_MS 50
+#define BENCH_BATCHES 3
+// Slower than the baseline by more than this is a regression. Allocations have to match exactly.
+#define BENCH_DEFAULT_THRESHOLD_PERCENT 25
+// Bytes handed to NMEAParser::parse at a time, like the router does
+#define BENCH_PARSE_CHUNK_SIZE 32
+
+typedef struct {
+    std::string name;
+    double nsPerOp;
+    double bytesPerSecond;
+    double allocsPerOp;
+    double allocBytesPerOp;
+} BenchResult;
+
+typedef struct {
+    const char *nmeaPath;
+    const char *seaTalkPath;
+    const char *jsonPath;
+    const char *baselinePath;
+    const char *filter;
+    double minTimeMs;
+    double thresholdPercent;
+} BenchOptions;
+
+// Results are added up in here so the compiler can't throw the work away
+static volatile uint32_t sink;
+
+/*!
+Times operation(i) for i = 0, 1, 2... Operations return how many bytes of input they handled, for bytes/s.
+*/
+template <class Operation>
+static BenchResult runBenchmark(const char *name, double minTimeMs, Operation operation) {
+    typedef std::chrono::steady_clock Clock;
+    BenchResult result;
+    result.name = name;
+    // Find a batch size that takes about minTimeMs
+    uint64_t iterations = 1;
+    while (true) {
+        Clock::time_point start = Clock::now();
+        for (uint64_t i = 0; i < iterations; i++) {
+            sink += operation(i);
+        }
+        double elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        if (elapsedMs >= minTimeMs / 4 || iterations >= (1ull << 32)) {
+            iterations = elapsedMs > 0 ? (uint64_t)(iterations * minTimeMs / elapsedMs) + 1 : iterations;
+            break;
+        }
+        iterations *= 2;
+    }
+    result.nsPerOp = 0;
+    for (int batch = 0; batch < BENCH_BATCHES; batch++) {
+        allocationCounterReset();
+        uint64_t bytes = 0;
+        Clock::time_point start = Clock::now();
+        for (uint64_t i = 0; i < iterations; i++) {
+            bytes += operation(i);
+        }
+        double elapsedNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        AllocationStats allocations = allocationCounterStats();
+        sink += bytes;
+        double nsPerOp = elapsedNs / iterations;
+        if (batch == 0 || nsPerOp < result.nsPerOp) {
+            result.nsPerOp = nsPerOp;
+            result.bytesPerSecond = elapsedNs > 0 ? bytes * 1e9 / elapsedNs : 0;
+        }
+        result.allocsPerOp = (double)allocations.count / iterations;
+        result.allocBytesPerOp = (double)allocations.bytes / iterations;
+    }
+    return result;
+}
+
+//! Runs the benchmark if its name matches the filter and prints its result
+template <class Operation>
+static void bench(std::vector<BenchResult> *results, const BenchOptions &options, const char *name, Operation operation) {
+    if (!strstr(name, options.filter)) {
+        return;
+    }
+    BenchResult result = runBenchmark(name, options.minTimeMs, operation);
+    printf("%-52s %10.1f %10.1f %8.2f %8.1f\n", name, result.nsPerOp, result.bytesPerSecond / 1e6, result.allocsPerOp, result.allocBytesPerOp);
+    results->push_back(result);
+}
+
+static bool readLines(const char *path, std::vector<std::string> *lines) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        size_t length = strcspn(line, "\r\n");
+        if (length) {
+            lines->push_back(std::string(line, length));
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static bool readSeaTalkCorpus(const char *path, std::vector<std::vector<uint8_t> > *datagrams) {
+    std::vector<std::string> lines;
+    if (!readLines(path, &lines)) {
+        return false;
+    }
+    for (size_t i = 0; i < lines.size(); i++) {
+        std::vector<uint8_t> datagram;
+        const char *hex = lines[i].c_str();
+        char *end;
+        for (long byte = strtol(hex, &end, 16); end != hex; byte = strtol(hex, &end, 16)) {
+            datagram.push_back(byte);
+            hex = end;
+        }
+        if (!seaTalkMessageIsValid(&datagram[0], datagram.size())) {
+            fprintf(stderr, "Skipping invalid datagram: %s\n", lines[i].c_str());
+            continue;
+        }
+        datagrams->push_back(datagram);
+    }
+    return true;
+}
+
+//! The sentences of one type, "RMC" matches $GPRMC and $ECRMC
+static std::vector<std::string> sentencesOfType(const std::vector<std::string> &sentences, const char *type) {
+    std::vector<std::string> matching;
+    for (size_t i = 0; i < sentences.size(); i++) {
+        if (sentences[i].size() > 6 && sentences[i].compare(3, 3, type) == 0) {
+            matching.push_back(sentences[i]);
+        }
+    }
+    return matching;
+}
+
+static void writeJSON(FILE *file, const std::vector<BenchResult> &results) {
+    // One benchmark per line, which is what readBaseline() expects
+    fprintf(file, "{\"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult &result = results[i];
+        fprintf(file, "{\"name\": \"%s\", \"ns_per_op\": %.2f, \"bytes_per_second\": %.0f, \"allocs_per_op\": %.3f, \"alloc_bytes_per_op\": %.1f}%s\n", result.name.c_str(), result.nsPerOp, result.bytesPerSecond, result.allocsPerOp, result.allocBytesPerOp, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "]}\n");
+}
+
+static bool readBaseline(const char *path, std::map<std::string, BenchResult> *baseline) {
+    std::vector<std::string> lines;
+    if (!readLines(path, &lines)) {
+        return false;
+    }
+    for (size_t i = 0; i < lines.size(); i++) {
+        char name[128];
+        BenchResult result;
+        if (sscanf(lines[i].c_str(), "{\"name\": \"%127[^\"]\", \"ns_per_op\": %lf, \"bytes_per_second\": %lf, \"allocs_per_op\": %lf, \"alloc_bytes_per_op\": %lf", name, &result.nsPerOp, &result.bytesPerSecond, &result.allocsPerOp, &result.allocBytesPerOp) == 5) {
+            result.name = name;
+            (*baseline)[name] = result;
+        }
+    }
+    return true;
+}
+
+static void printUsage() {
+    printf("Usage: bench [--nmea FILE] [--seatalk FILE] [--json FILE] [--baseline FILE] [--threshold PERCENT] [--min-time MS] [--filter TEXT]\n");
+    printf("  --json FILE        Write the results as JSON\n");
+    printf("  --baseline FILE    Compare against results written with --json, exits with 1 on a regression\n");
+    printf("  --threshold N      Percent slower than the baseline that counts as a regression (default %d)\n", BENCH_DEFAULT_THRESHOLD_PERCENT);
+    printf("  --filter TEXT      Only run benchmarks whose name contains TEXT\n");
+}
+
+static bool parseOptions(int argc, char **argv, BenchOptions *options) {
+    options->nmeaPath = "testing/bench/nmea.txt";
+    options->seaTalkPath = "testing/bench/seatalk.txt";
+    options->jsonPath = NULL;
+    options->baselinePath = NULL;
+    options->filter = "";
+    options->minTimeMs = BENCH_DEFAULT_MIN_TIME_MS;
+    options->thresholdPercent = BENCH_DEFAULT_THRESHOLD_PERCENT;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--nmea") == 0 && hasValue) {
+            options->nmeaPath = argv[++i];
+        } else if (strcmp(argv[i], "--seatalk") == 0 && hasValue) {
+            options->seaTalkPath = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && hasValue) {
+            options->jsonPath = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && hasValue) {
+            options->baselinePath = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && hasValue) {
+            options->thresholdPercent = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--min-time") == 0 && hasValue) {
+            options->minTimeMs = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--filter") == 0 && hasValue) {
+            options->filter = argv[++i];
+        } else {
+            return false;
+        }
+    }
+    return options->minTimeMs > 0;
+}
+
+int main(int argc, char **argv) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, &options)) {
+        printUsage();
+        return 1;
+    }
+    std::vector<std::string> sentences;
+    std::vector<std::vector<uint8_t> > datagrams;
+    if (!readLines(options.nmeaPath, &sentences) || !readSeaTalkCorpus(options.seaTalkPath, &datagrams) || sentences.empty() || datagrams.empty()) {
+        fprintf(stderr, "Can't read the corpus in %s and %s\n", options.nmeaPath, options.seaTalkPath);
+        return 1;
+    }
+    // What the parser sees on the wire
+    std::string stream;
+    for (size_t i = 0; i < sentences.size(); i++) {
+        stream += sentences[i] + "\r\n";
+    }
+
+    std::vector<BenchResult> results;
+    printf("%-52s %10s %10s %8s %8s\n", "Benchmark", "ns/op", "MB/s", "allocs", "bytes");
+
+    // Parsing
+    NMEAParser parser;
+    bench(&results, options, "NMEAParser::parse(char)", [&](uint64_t i) -> size_t {
+        sink += parser.parse(stream[i % stream.size()]);
+        return 1;
+    });
+    bench(&results, options, "NMEAParser::parse(buffer) 32 byte chunks", [&](uint64_t i) -> size_t {
+        size_t offset = (i * BENCH_PARSE_CHUNK_SIZE) % stream.size();
+        int length = std::min((size_t)BENCH_PARSE_CHUNK_SIZE, stream.size() - offset);
+        int parsed = 0;
+        while (parsed < length) {
+            bool complete;
+            parsed += parser.parse(&stream[offset + parsed], length - parsed, &complete);
+            sink += complete;
+        }
+        return length;
+    });
+    bench(&results, options, "splitMessageIntoFragments", [&](uint64_t i) -> size_t {
+        const std::string &sentence = sentences[i % sentences.size()];
+        NMEAFragment fragments[32];
+        int fragmentCount = 0;
+        splitMessageIntoFragments(sentence.c_str(), sentence.size(), fragments, 32, &fragmentCount);
+        sink += fragmentCount;
+        return sentence.size();
+    });
+    char body[NMEA_MESSAGE_MAX_LENGTH];
+    bench(&results, options, "closeMessage", [&](uint64_t i) -> size_t {
+        const std::string &sentence = sentences[i % sentences.size()];
+        size_t length = sentence.find('*');
+        memcpy(body, sentence.c_str(), length);
+        body[length] = '\0';
+        closeMessage(body);
+        return length;
+    });
+
+    // NMEA decoders
+    std::vector<std::string> rmc = sentencesOfType(sentences, "RMC");
+    std::vector<std::string> rmb = sentencesOfType(sentences, "RMB");
+    std::vector<std::string> apb = sentencesOfType(sentences, "APB");
+    std::vector<std::string> gll = sentencesOfType(sentences, "GLL");
+    std::vector<std::string> sea = sentencesOfType(sentences, "SEA");
+    bench(&results, options, "NMEAMessageRMC(const char *)", [&](uint64_t i) -> size_t {
+        const std::string &sentence = rmc[i % rmc.size()];
+        NMEAMessageRMC message(sentence.c_str());
+        sink += message.status();
+        return sentence.size();
+    });
+    bench(&results, options, "NMEAMessageRMB(const char *)", [&](uint64_t i) -> size_t {
+        const std::string &sentence = rmb[i % rmb.size()];
+        NMEAMessageRMB message(sentence.c_str());
+        sink += message.status();
+        return sentence.size();
+    });
+    bench(&results, options, "NMEAMessageAPB(const char *)", [&](uint64_t i) -> size_t {
+        const std::string &sentence = apb[i % apb.size()];
+        NMEAMessageAPB message(sentence.c_str());
+        sink += message.isArrived();
+        return sentence.size();
+    });
+    bench(&results, options, "NMEAMessageGLL(const char *)", [&](uint64_t i) -> size_t {
+        const std::string &sentence = gll[i % gll.size()];
+        NMEAMessageGLL message(sentence.c_str());
+        sink += message.latitude();
+        return sentence.size();
+    });
+    bench(&results, options, "NMEAMessageSEA(const char *)", [&](uint64_t i) -> size_t {
+        const std::string &sentence = sea[i % sea.size()];
+        NMEAMessageSEA message(sentence.c_str());
+        sink += message.seaTalkMessageLength();
+        return sentence.size();
+    });
+    bench(&results, options, "NMEAMessageSEA::decodeSeaTalkMessage", [&](uint64_t i) -> size_t {
+        const std::string &sentence = sea[i % sea.size()];
+        uint8_t datagram[SEATALK_MESSAGE_MAX_LENGTH];
+        sink += NMEAMessageSEA::decodeSeaTalkMessage(sentence.c_str(), datagram, sizeof(datagram));
+        return sentence.size();
+    });
+
+    // NMEA generators
+    bench(&results, options, "NMEAMessageWind(DeciDegrees, CentiKnots)", [&](uint64_t i) -> size_t {
+        NMEAMessageWind message(i % 3600, 1220);
+        return strlen(message.message());
+    });
+    bench(&results, options, "NMEAMessageDBT(DeciFeet)", [&](uint64_t i) -> size_t {
+        NMEAMessageDBT message(243 + i % 100);
+        return strlen(message.message());
+    });
+    bench(&results, options, "NMEAMessageVHW(CentiKnots)", [&](uint64_t i) -> size_t {
+        NMEAMessageVHW message(640 + i % 1000);
+        return strlen(message.message());
+    });
+    bench(&results, options, "NMEAMessageHDM(DeciDegrees)", [&](uint64_t i) -> size_t {
+        NMEAMessageHDM message(i % 3600);
+        return strlen(message.message());
+    });
+    bench(&results, options, "NMEAMessageSEA(const uint8_t *, uint8_t)", [&](uint64_t i) -> size_t {
+        const std::vector<uint8_t> &datagram = datagrams[i % datagrams.size()];
+        NMEAMessageSEA message(&datagram[0], datagram.size());
+        return strlen(message.message());
+    });
+
+    // SeaTalk decoding
+    bench(&results, options, "newSeaTalkMessage", [&](uint64_t i) -> size_t {
+        const std::vector<uint8_t> &datagram = datagrams[i % datagrams.size()];
+        BaseSeaTalkMessage *message = newSeaTalkMessage(&datagram[0], datagram.size());
+        sink += message->message()[0];
+        delete message;
+        return datagram.size();
+    });
+
+    // SeaTalk encoders
+    Time time = {4, 54, 30500};
+    Date date = {4, 11, 2014};
+    Heading bearing = {2662, true};
+#define BENCH_SEATALK_ENCODER(benchName, construction) \
+    bench(&results, options, benchName, [&](uint64_t i) -> size_t { \
+        construction; \
+        sink += message.message()[1]; \
+        return message.messageLength(); \
+    });
+    BENCH_SEATALK_ENCODER("SeaTalkMessageDepth(DeciFeet)", SeaTalkMessageDepth message(243 + i % 100));
+    BENCH_SEATALK_ENCODER("SeaTalkMessageWaterTemperature(int)", SeaTalkMessageWaterTemperature message(i % 30));
+    BENCH_SEATALK_ENCODER("SeaTalkMessageSpeedThroughWater(CentiKnots)", SeaTalkMessageSpeedThroughWater message(640 + i % 1000));
+    BENCH_SEATALK_ENCODER("SeaTalkMessageLampIntensity(uint8_t)", SeaTalkMessageLampIntensity message(i % 4));
+    BENCH_SEATALK_ENCODER("SeaTalkMessageLatitude(Coordinate)", SeaTalkMessageLatitude message(378664000 + (i % 100) * 1000));
+    BENCH_SEATALK_ENCODER("SeaTalkMessageLongitude(Coordinate)", SeaTalkMessageLongitude message(-1223161000 + (i % 100) * 1000));
+    BENCH_SEATALK_ENCODER("SeaTalkMessageSpeedOverGround(CentiKnots)", SeaTalkMessageSpeedOverGround message(510 + i % 1000));
+    BENCH_SEATALK_ENCODER("SeaTalkMessageMagneticCourse(DeciDegrees)", SeaTalkMessageMagneticCourse message(i % 3600));
+    BENCH_SEATALK_ENCODER("SeaTalkMessageTime(Time)", SeaTalkMessageTime message(time));
+    BENCH_SEATALK_ENCODER("SeaTalkMessageDate(Date)", SeaTalkMessageDate message(date));
+    BENCH_SEATALK_ENCODER("SeaTalkMessageTargetWaypointName(const char *)", SeaTalkMessageTargetWaypointName message("tospace"));
+    BENCH_SEATALK_ENCODER("SeaTalkMessageNavigationToWaypoint(...)", SeaTalkMessageNavigationToWaypoint message(66, bearing, 130 + (i % 10) * 100, LateralityLeft, 0x7));
+    BENCH_SEATALK_ENCODER("SeaTalkMessageSetAutopilotParameter(int, int)", SeaTalkMessageSetAutopilotParameter message(0xC, i % 20));
+    BENCH_SEATALK_ENCODER("SeaTalkMessageMagneticVariation(int)", SeaTalkMessageMagneticVariation message(i % 20));
+    BENCH_SEATALK_ENCODER("SeaTalkMessageCompassHeadingAndRudderPosition(...)", SeaTalkMessageCompassHeadingAndRudderPosition message(i % 360, true, 0));
+    BENCH_SEATALK_ENCODER("SeaTalkMessageArrivalInfo(bool, bool, const char *)", SeaTalkMessageArrivalInfo message(i % 2, true, "tospace"));
+    BENCH_SEATALK_ENCODER("SeaTalkMessageDeviceQuery()", SeaTalkMessageDeviceQuery message);
+
+    if (options.jsonPath) {
+        FILE *file = fopen(options.jsonPath, "w");
+        if (!file) {
+            fprintf(stderr, "Can't write %s\n", options.jsonPath);
+            return 1;
+        }
+        writeJSON(file, results);
+        fclose(file);
+    }
+
+    int regressionCount = 0;
+    if (options.baselinePath) {
+        std::map<std::string, BenchResult> baseline;
+        if (!readBaseline(options.baselinePath, &baseline)) {
+            fprintf(stderr, "Can't read %s\n", options.baselinePath);
+            return 1;
+        }
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchResult &result = results[i];
+            std::map<std::string, BenchResult>::iterator it = baseline.find(result.name);
+            if (it == baseline.end()) {
+                continue;
+            }
+            const BenchResult &expected = it->second;
+            if (result.nsPerOp > expected.nsPerOp * (1 + options.thresholdPercent / 100)) {
+                printf("REGRESSION %s: %.1f ns/op, baseline %.1f\n", result.name.c_str(), result.nsPerOp, expected.nsPerOp);
+                regressionCount++;
+            }
+            // Allocations don't depend on the machine, any increase counts
+            if (result.allocsPerOp > expected.allocsPerOp + 0.001 || result.allocBytesPerOp > expected.allocBytesPerOp + 0.1) {
+                printf("REGRESSION %s: %.2f allocs/op %.1f bytes/op, baseline %.2f %.1f\n", result.name.c_str(), result.allocsPerOp, result.allocBytesPerOp, expected.allocsPerOp, expected.allocBytesPerOp);
+                regressionCount++;
+            }
+        }
+        printf("%d regressions against %s\n", regressionCount, options.baselinePath);
+    }
+    if (!allocationCounterCountsMalloc()) {
+        printf("Note: malloc isn't intercepted on this platform, only operator new is counted\n");
+    }
+    return regressionCount ? 1 : 0;
+}
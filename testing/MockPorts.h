@@ -0,0 +1,19 @@
+#ifndef MockPorts_h
+#define MockPorts_h
+
+#include "Arduino.h"
+#include "../Types.h"
+#include "../SerialBuffers.h"
+
+// The Teensy's ports as the simulator and replay set up MockSerial, indexed by Port
+static const uint32_t mockPortBauds[PortCount] = {0, 38400, 4800, 4800, 9600};
+static const uint32_t mockPortFormats[PortCount] = {SERIAL_8N1, SERIAL_8N1, SERIAL_8N1, SERIAL_9N1_RXINV_TXINV, SERIAL_8N1};
+// Buffer sizes of the Teensy core and AltSoftSerial. USB has flow control so the computer can't overrun us.
+static const int mockRxBufferSizes[PortCount] = {
+    1024, TEENSY_SERIAL1_RX_BUFFER_SIZE, ALTSS_RX_BUFFER_SIZE, TEENSY_SERIAL3_RX_BUFFER_SIZE, TEENSY_SERIAL2_RX_BUFFER_SIZE
+};
+static const int mockTxBufferSizes[PortCount] = {
+    64, TEENSY_SERIAL1_TX_BUFFER_SIZE, ALTSS_TX_BUFFER_SIZE, TEENSY_SERIAL3_TX_BUFFER_SIZE, TEENSY_SERIAL2_TX_BUFFER_SIZE
+};
+
+#endif
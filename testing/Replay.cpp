@@ -0,0 +1,192 @@
+//
+//  Replay.cpp
+//  Helm
+//
+//  Feeds a capture back into the Router and prints everything it sends, one section per port, so the output can be
+//  diffed against a golden file. Build and run with `make replay REPLAY_ARGS="capture.hlm --speed 10"`.
+//
+
+#include "Arduino.h"
+#include "../Router.h"
+#include "../Capture.h"
+#include "MockPorts.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// How often the replayed loop() runs, in simulated time
+#define REPLAY_POLL_MICROS 100
+// How long to keep polling after the last record so the TX queues drain
+#define REPLAY_DRAIN_MICROS 2000000
+
+//! Turns the bytes a port sent into lines of text, SeaTalk datagrams are printed like printSeaTalkMessage() does
+class Transcript
+{
+public:
+    void append(Port port, uint16_t data) {
+        std::string &line = _lines[port];
+        if (port == PortSeaTalk) {
+            if ((data & 0x100) && !line.empty()) {
+                _sections[port] += line + "\n";
+                line.clear();
+            }
+            char hex[5];
+            sprintf(hex, line.empty() ? "%03X" : " %02X", data);
+            line += hex;
+            return;
+        }
+        if (data == '\r') {
+            return;
+        }
+        if (data == '\n') {
+            _sections[port] += line + "\n";
+            line.clear();
+            return;
+        }
+        line += (char)data;
+    }
+    void print() {
+        for (int port = 0; port < PortCount; port++) {
+            if (!_lines[port].empty()) {
+                _sections[port] += _lines[port] + "\n";
+                _lines[port].clear();
+            }
+            printf("== %s\n%s", RoutingTable::portName((Port)port), _sections[port].c_str());
+        }
+    }
+private:
+    std::string _lines[PortCount];
+    std::string _sections[PortCount];
+};
+
+static void collectSent(MockSerial *serials, Transcript &transcript) {
+    for (int port = 0; port < PortCount; port++) {
+        std::vector<uint16_t> sent = serials[port].takeSent();
+        for (size_t i = 0; i < sent.size(); i++) {
+            transcript.append((Port)port, sent[i]);
+        }
+    }
+}
+
+static void runUntil(Router &router, MockSerial *serials, Transcript &transcript, uint32_t time) {
+    while ((int32_t)(time - micros()) > 0) {
+        mockAdvanceMicros(std::min((uint32_t)REPLAY_POLL_MICROS, time - micros()));
+        router.poll(millis());
+        collectSent(serials, transcript);
+    }
+}
+
+static bool readFile(const char *path, std::vector<uint8_t> *contents) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    uint8_t buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        contents->insert(contents->end(), buffer, buffer + length);
+    }
+    fclose(file);
+    return true;
+}
+
+static void printUsage() {
+    printf("Usage: replay CAPTURE [--speed N] [--captured]\n");
+    printf("  --speed N    Replay N times faster than real time, 0 for as fast as possible (default 1)\n");
+    printf("  --captured   Print what the device sent during the capture instead of replaying it\n");
+}
+
+int main(int argc, char **argv) {
+    const char *path = NULL;
+    double speed = 1;
+    bool printCaptured = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            speed = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--captured") == 0) {
+            printCaptured = true;
+        } else if (!path && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    std::vector<uint8_t> capture;
+    if (!path || speed < 0 || !readFile(path, &capture)) {
+        printUsage();
+        return 1;
+    }
+    CaptureReader reader(&capture[0], capture.size());
+    if (!reader.isValid()) {
+        fprintf(stderr, "%s is not a capture\n", path);
+        return 1;
+    }
+
+    Transcript transcript;
+    CaptureRecord record;
+    if (printCaptured) {
+        while (reader.next(&record)) {
+            if (record.lostCount) {
+                fprintf(stderr, "%u records lost at %u\n", record.lostCount, record.time);
+            }
+            for (int i = 0; record.direction == CaptureDirectionWrite && i < record.length; i++) {
+                transcript.append(record.port, record.data[i] | (i == 0 && record.command ? 0x100 : 0));
+            }
+        }
+        transcript.print();
+        return 0;
+    }
+
+    MockSerial serials[PortCount];
+    SerialPortAdapter<MockSerial> nmeaPorts[PortCount] = {serials[0], serials[1], serials[2], serials[3], serials[4]};
+    SerialPort9BitAdapter<MockSerial> seaTalkPort(serials[PortSeaTalk]);
+    Router router;
+    for (int port = 0; port < PortCount; port++) {
+        // As fast as possible means no time on the wire either
+        serials[port].begin(speed ? mockPortBauds[port] * speed : 0, mockPortFormats[port]);
+        serials[port].setBufferSizes(mockRxBufferSizes[port], mockTxBufferSizes[port]);
+        router.setPort((Port)port, port == PortSeaTalk ? (SerialPort *)&seaTalkPort : &nmeaPorts[port]);
+    }
+
+    mockSetMicros(0);
+    bool isFirstRecord = true;
+    uint32_t startTime = 0;
+    while (reader.next(&record)) {
+        if (record.lostCount) {
+            fprintf(stderr, "%u records lost at %u\n", record.lostCount, record.time);
+        }
+        if (record.port == PortCount || record.direction != CaptureDirectionRead) {
+            continue;
+        }
+        if (isFirstRecord) {
+            startTime = record.time;
+            isFirstRecord = false;
+        }
+        MockSerial &serial = serials[record.port];
+        if (speed) {
+            // Start injecting early enough that the last byte lands when the router originally read it
+            uint32_t readTime = (record.time - startTime) / speed;
+            uint32_t wireTime = record.length * serial.characterMicros();
+            runUntil(router, serials, transcript, readTime > wireTime ? readTime - wireTime : 0);
+        }
+        if (!speed) {
+            // Keep the clock in step with the capture, the echo filter depends on it
+            mockSetMicros(record.time - startTime);
+        }
+        for (int i = 0; i < record.length; i++) {
+            serial.inject9bit(record.data[i] | (i == 0 && record.command ? 0x100 : 0));
+        }
+        if (!speed) {
+            while (serial.available()) {
+                router.poll(millis());
+                collectSent(serials, transcript);
+            }
+        }
+    }
+    runUntil(router, serials, transcript, micros() + REPLAY_DRAIN_MICROS);
+    transcript.print();
+    return 0;
+}
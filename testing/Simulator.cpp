@@ -0,0 +1,565 @@
+//
+//  Simulator.cpp
+//  Helm
+//
+//  Runs the Router against a simulated boat network in simulated time and reports how well it keeps up.
+//  Build and run with `make simulate`, pass options with SIMULATOR_ARGS="--seconds 30 --gps-rate 10".
+//
+
+#include "Arduino.h"
+#include "../Router.h"
+#include "../NMEAMessage.h"
+#include "../Capture.h"
+#include "../StackPaint.h"
+#include "../MemoryBudget.h"
+#include "MockPorts.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <cstring>
+#include <string>
+#include <map>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+// How often the simulated loop() runs
+#define SIMULATOR_POLL_MICROS 100
+
+typedef struct {
+    double seconds;
+    int gpsRate;
+    bool gsvFlood;
+    bool ais;
+    int collisionPercent;
+    unsigned int seed;
+    const char *capturePath;
+    const char *tracePath;
+} SimulatorOptions;
+
+//! Latency from a message's last byte arriving at the router to its last byte leaving on another port
+class LatencyStats
+{
+public:
+    LatencyStats() : count(0), total(0), min(0xFFFFFFFF), max(0) { }
+    void add(uint32_t latency) {
+        count++;
+        total += latency;
+        min = latency < min ? latency : min;
+        max = latency > max ? latency : max;
+    }
+    uint32_t count;
+    uint64_t total;
+    uint32_t min;
+    uint32_t max;
+};
+
+/*!
+Matches what comes out of the router with what went in. Messages passed through or converted to/from $STSEA are matched
+exactly by content. Translations are matched to the most recent message that triggers them.
+*/
+class LatencyTracker
+{
+public:
+    void received(const std::string &key, const std::string &source, uint32_t time) {
+        std::deque<Arrival> &arrivals = _pending[key];
+        arrivals.push_back(Arrival(source, time));
+        // Messages that never come out (filtered, dropped) shouldn't pile up
+        while (arrivals.size() > 1 && time - arrivals.front().time > 1000000) {
+            arrivals.pop_front();
+        }
+    }
+    //! The same message can go to several ports, so each arrival is matched once per destination
+    void sent(const std::string &key, const std::string &destination, uint32_t time) {
+        std::map<std::string, std::deque<Arrival> >::iterator it = _pending.find(key);
+        if (it == _pending.end()) {
+            return;
+        }
+        std::deque<Arrival> &arrivals = it->second;
+        for (size_t i = 0; i < arrivals.size(); i++) {
+            std::vector<std::string> &matched = arrivals[i].matchedDestinations;
+            if (std::find(matched.begin(), matched.end(), destination) == matched.end()) {
+                matched.push_back(destination);
+                _routes[arrivals[i].source + " > " + destination].add(time - arrivals[i].time);
+                return;
+            }
+        }
+    }
+    std::map<std::string, LatencyStats> &routes() { return _routes; }
+private:
+    typedef struct Arrival {
+        Arrival(const std::string &source, uint32_t time) : source(source), time(time) { }
+        std::string source;
+        uint32_t time;
+        std::vector<std::string> matchedDestinations;
+    } Arrival;
+    std::map<std::string, std::deque<Arrival> > _pending;
+    std::map<std::string, LatencyStats> _routes;
+};
+
+static LatencyTracker latencyTracker;
+
+static std::string seaTalkKey(const uint8_t *message, int messageLength) {
+    char hex[SEATALK_MESSAGE_MAX_LENGTH * 2 + 1];
+    binaryToAsciiHex(message, messageLength, hex);
+    hex[messageLength * 2] = 0;
+    return std::string("SEA:") + hex;
+}
+
+//! Key for the output a translation produces, so it can be matched with its trigger
+static std::string translationKey(const char *name) {
+    return std::string("XLATE:") + name;
+}
+
+static uint32_t injectSentence(MockSerial &serial, const char *source, char *sentence) {
+    closeMessage(sentence);
+    uint32_t arrival = serial.inject(sentence);
+    // The parser has the sentence at its checksum, before the CR LF
+    arrival -= 2 * serial.characterMicros();
+    latencyTracker.received(sentence, source, arrival);
+    return arrival;
+}
+
+//! uBlox GPS on 9600 baud. Sends a fix at the configured rate and satellites in view once a second.
+class SimulatedGPS
+{
+public:
+    SimulatedGPS(MockSerial &serial, const SimulatorOptions &options) : _serial(serial), _options(options), _nextFix(0), _fixCount(0) { }
+    void step(uint32_t now) {
+        if ((int32_t)(now - _nextFix) < 0) {
+            return;
+        }
+        _nextFix += 1000000 / _options.gpsRate;
+        // A real receiver skips fixes it has no time to send
+        if (_serial.wireBacklog() > 0) {
+            return;
+        }
+        uint32_t tenths = _fixCount++ * 10 / _options.gpsRate;
+        int seconds = (tenths / 10) % 60;
+        char sentence[NMEA_MESSAGE_MAX_LENGTH];
+        sprintf(sentence, "$GPRMC,0454%02d.%d0,A,3751.%05d,N,12218.96980,W,5.%03d,%d.0,041114,13.5,E,D", seconds, tenths % 10, 98405 + (int)tenths, rand() % 1000, rand() % 360);
+        uint32_t arrival = injectSentence(_serial, "GPS", sentence);
+        latencyTracker.received(translationKey("SEATALK51"), "GPS RMC", arrival);
+        sprintf(sentence, "$GPGGA,0454%02d.%d0,3751.%05d,N,12218.96980,W,2,09,0.95,8.2,M,-25.6,M,,0000", seconds, tenths % 10, 98405 + (int)tenths);
+        injectSentence(_serial, "GPS", sentence);
+        sprintf(sentence, "$GPVTG,%d.0,T,,M,5.%03d,N,10.%03d,K,D", rand() % 360, rand() % 1000, rand() % 1000);
+        injectSentence(_serial, "GPS", sentence);
+        if (tenths % 10 == 0) {
+            sprintf(sentence, "$GPGSA,A,3,02,05,07,09,13,16,20,26,30,,,,1.73,0.95,1.45");
+            injectSentence(_serial, "GPS", sentence);
+            // All constellations, a uBlox does this at startup or when configured to
+            int gsvCount = _options.gsvFlood ? 4 : 1;
+            for (int i = 1; i <= gsvCount; i++) {
+                sprintf(sentence, "$GPGSV,%d,%d,16,%02d,67,054,%02d,%02d,12,314,%02d,%02d,41,253,%02d,%02d,22,084,%02d", gsvCount, i, i * 4, rand() % 50, i * 4 + 1, rand() % 50, i * 4 + 2, rand() % 50, i * 4 + 3, rand() % 50);
+                injectSentence(_serial, "GPS", sentence);
+            }
+        }
+    }
+private:
+    MockSerial &_serial;
+    const SimulatorOptions &_options;
+    uint32_t _nextFix;
+    uint32_t _fixCount;
+};
+
+//! AIS receiver on 38400 baud in a busy harbor, sending whenever the wire is free
+class SimulatedAIS
+{
+public:
+    SimulatedAIS(MockSerial &serial) : _serial(serial) { }
+    void step(uint32_t now) {
+        static const char *payloads[] = {
+            "13u?etPv2;0n:dDPwUM1U1Cb069D",
+            "13aEOK?P00PD2wVMdLDRhgvL289?",
+            "15MgK45P3@G?fl0E`JbR0OwT0@MS",
+            "403Ot`Qv0q3QJ:4Uev@5o?g00<0S",
+        };
+        if (_serial.wireBacklog() > 0) {
+            return;
+        }
+        char sentence[NMEA_MESSAGE_MAX_LENGTH];
+        sprintf(sentence, "!AIVDM,1,1,,%c,%s,0", rand() % 2 ? 'A' : 'B', payloads[rand() % 4]);
+        injectSentence(_serial, "NMEAHS", sentence);
+    }
+private:
+    MockSerial &_serial;
+};
+
+/*!
+The SeaTalk bus. Instruments talk when the bus is free. Everything the router transmits comes back to it, and the
+autopilot occasionally talks over the router, in which case the open collector bus ANDs the two datagrams together.
+*/
+class SimulatedSeaTalkBus
+{
+public:
+    SimulatedSeaTalkBus(MockSerial &serial, const SimulatorOptions &options) : _serial(serial), _options(options), _collisionCount(0), _bytes(0) {
+        for (int i = 0; i < TalkerCount; i++) {
+            _nextTalk[i] = i * 7919;
+        }
+    }
+    void step(uint32_t now) {
+        std::vector<uint16_t> sent = _serial.takeSent();
+        const std::vector<uint32_t> &sentTimes = _serial.sentTimes();
+        recordSent(sent, sentTimes);
+        bool routerTalking = !sent.empty() || _serial.txBacklog() > 0;
+        // A colliding datagram goes out on top of whatever the router is sending
+        size_t j = 0;
+        for (; j < sent.size() && !_collision.empty(); j++) {
+            sent[j] &= _collision.front();
+            _collision.pop_front();
+        }
+        if (!routerTalking) {
+            sent.insert(sent.end(), _collision.begin(), _collision.end());
+            _collision.clear();
+        }
+        for (int i = 0; i < TalkerCount; i++) {
+            if ((int32_t)(now - _nextTalk[i]) < 0) {
+                continue;
+            }
+            bool collides = i == TalkerAutopilot && routerTalking && _collision.empty() && rand() % 100 < _options.collisionPercent;
+            // Instruments wait for the bus to be free
+            if ((routerTalking || _serial.wireBacklog() > 0) && !collides) {
+                continue;
+            }
+            // Instruments have their own clocks, so they drift relative to each other and to us
+            _nextTalk[i] += talkerPeriods[i] - talkerPeriods[i] / 10 + rand() % (talkerPeriods[i] / 5);
+            uint8_t datagram[SEATALK_MESSAGE_MAX_LENGTH];
+            int datagramLength = talk((Talker)i, datagram);
+            if (collides) {
+                _collisionCount++;
+                for (int k = 0; k < datagramLength; k++) {
+                    _collision.push_back(datagram[k] | (k == 0 ? 0x100 : 0));
+                }
+                continue;
+            }
+            uint32_t arrival = 0;
+            for (int k = 0; k < datagramLength; k++) {
+                arrival = _serial.inject9bit(datagram[k] | (k == 0 ? 0x100 : 0));
+            }
+            latencyTracker.received(seaTalkKey(datagram, datagramLength), "SEATALK", arrival);
+            const char *translation = translationForCommand(datagram[0]);
+            if (translation) {
+                char source[16];
+                sprintf(source, "SEATALK %02X", datagram[0]);
+                latencyTracker.received(translationKey(translation), source, arrival);
+            }
+        }
+        // The echo of whatever the router put on the bus
+        for (size_t i = 0; i < sent.size(); i++) {
+            _serial.inject9bit(sent[i]);
+        }
+    }
+    int collisionCount() { return _collisionCount; }
+    uint32_t bytes() { return _bytes; }
+private:
+    typedef enum { TalkerCompass = 0, TalkerWindAngle, TalkerWindSpeed, TalkerDepth, TalkerSpeed, TalkerAutopilot, TalkerCount } Talker;
+    static const uint32_t talkerPeriods[TalkerCount];
+
+    static const char *translationForCommand(uint8_t command) {
+        switch (command) {
+            case 0x9C: return "HDM";
+            case 0x10: return "MWV";
+            case 0x00: return "DBT";
+            case 0x20: return "VHW";
+            default: return NULL;
+        }
+    }
+
+    int talk(Talker talker, uint8_t *datagram) {
+        int value = rand();
+        switch (talker) {
+            case TalkerCompass:
+                datagram[0] = 0x9C; datagram[1] = 0x01 | ((value & 3) << 4); datagram[2] = value >> 2 & 0x3F; datagram[3] = 0x00;
+                return 4;
+            case TalkerWindAngle:
+                datagram[0] = 0x10; datagram[1] = 0x01; datagram[2] = value >> 8 & 0x01; datagram[3] = value & 0xFF;
+                return 4;
+            case TalkerWindSpeed:
+                datagram[0] = 0x11; datagram[1] = 0x01; datagram[2] = value & 0x1F; datagram[3] = value >> 8 & 0x07;
+                return 4;
+            case TalkerDepth:
+                datagram[0] = 0x00; datagram[1] = 0x02; datagram[2] = 0x00; datagram[3] = value & 0xFF; datagram[4] = 0x00;
+                return 5;
+            case TalkerSpeed:
+                datagram[0] = 0x20; datagram[1] = 0x01; datagram[2] = value & 0x7F; datagram[3] = 0x00;
+                return 4;
+            default:
+                datagram[0] = 0x84; datagram[1] = 0x06 | ((value & 3) << 4); datagram[2] = value >> 2 & 0x3F; datagram[3] = 0x00;
+                datagram[4] = 0x00; datagram[5] = 0x00; datagram[6] = 0x00; datagram[7] = 0x00; datagram[8] = 0x00;
+                return 9;
+        }
+    }
+
+    void recordSent(const std::vector<uint16_t> &sent, const std::vector<uint32_t> &sentTimes) {
+        _bytes += sent.size();
+        for (size_t i = 0; i < sent.size(); i++) {
+            if ((sent[i] & 0x100) && _datagram.size()) {
+                latencyTracker.sent(seaTalkKey(&_datagram[0], _datagram.size()), "SEATALK", _datagramTime);
+                _datagram.clear();
+            }
+            _datagram.push_back(sent[i] & 0xFF);
+            _datagramTime = sentTimes[i];
+            if ((int)_datagram.size() >= 2 && (int)_datagram.size() == (_datagram[1] & 0x0F) + 3) {
+                latencyTracker.sent(seaTalkKey(&_datagram[0], _datagram.size()), "SEATALK", _datagramTime);
+                if (_datagram[0] == 0x51) {
+                    // Longitude is the first thing an RMC turns into
+                    latencyTracker.sent(translationKey("SEATALK51"), "SEATALK 51", _datagramTime);
+                }
+                _datagram.clear();
+            }
+        }
+    }
+
+    MockSerial &_serial;
+    const SimulatorOptions &_options;
+    uint32_t _nextTalk[TalkerCount];
+    int _collisionCount;
+    std::deque<uint16_t> _collision;
+    uint32_t _bytes;
+    std::vector<uint8_t> _datagram;
+    uint32_t _datagramTime;
+};
+
+// Compass at 10Hz like an ST4000, the rest at their usual rates
+const uint32_t SimulatedSeaTalkBus::talkerPeriods[TalkerCount] = {100000, 500000, 500000, 1000000, 500000, 500000};
+
+//! The computer running OpenCPN, following a route and sending the odd datagram
+class SimulatedComputer
+{
+public:
+    SimulatedComputer(MockSerial &serial) : _serial(serial), _nextSecond(250000) { }
+    void step(uint32_t now) {
+        if ((int32_t)(now - _nextSecond) < 0) {
+            return;
+        }
+        _nextSecond += 1000000;
+        char sentence[NMEA_MESSAGE_MAX_LENGTH];
+        sprintf(sentence, "$ECRMB,A,0.112,L,001,002,3751.200,N,12219.100,W,0.8,%d.0,5.2,V", rand() % 360);
+        injectSentence(_serial, "OUTPUT", sentence);
+        sprintf(sentence, "$ECAPB,A,A,0.10,R,N,V,V,%d.0,M,002,%d.0,M,%d.0,M", rand() % 360, rand() % 360, rand() % 360);
+        injectSentence(_serial, "OUTPUT", sentence);
+        uint8_t datagram[4] = {0x86, 0x11, 0x01, 0xFE};
+        NMEAMessageSEA sea = NMEAMessageSEA(datagram, 4);
+        uint32_t arrival = _serial.inject(sea.message()) - 2 * _serial.characterMicros();
+        latencyTracker.received(seaTalkKey(datagram, 4), "OUTPUT", arrival);
+    }
+private:
+    MockSerial &_serial;
+    uint32_t _nextSecond;
+};
+
+//! Splits what a port sent into sentences and matches them with what came in
+class NMEAOutput
+{
+public:
+    NMEAOutput(MockSerial &serial, const char *name) : _serial(serial), _name(name), _bytes(0) { }
+    void step() {
+        std::vector<uint16_t> sent = _serial.takeSent();
+        const std::vector<uint32_t> &sentTimes = _serial.sentTimes();
+        _bytes += sent.size();
+        for (size_t i = 0; i < sent.size(); i++) {
+            _line.push_back(sent[i]);
+            if (sent[i] != '\n') {
+                continue;
+            }
+            // Latency is to the checksum, same as on the way in
+            uint32_t time = sentTimes[i] - 2 * _serial.characterMicros();
+            latencyTracker.sent(_line, _name, time);
+            uint8_t datagram[SEATALK_MESSAGE_MAX_LENGTH];
+            if (_line.compare(0, 7, "$STSEA,") == 0) {
+                int datagramLength = NMEAMessageSEA::decodeSeaTalkMessage(_line.c_str(), datagram, sizeof(datagram));
+                latencyTracker.sent(seaTalkKey(datagram, datagramLength), _name, time);
+            } else if (_line.size() > 6) {
+                std::string type = _line.substr(3, 3);
+                latencyTracker.sent(translationKey(type.c_str()), _name + " " + type, time);
+            }
+            _line.clear();
+        }
+    }
+    uint32_t bytes() { return _bytes; }
+private:
+    MockSerial &_serial;
+    std::string _name;
+    std::string _line;
+    uint32_t _bytes;
+};
+
+static void printUsage() {
+    printf("Usage: simulator [--seconds N] [--gps-rate HZ] [--gsv-flood] [--no-ais] [--collisions PERCENT] [--seed N] [--capture FILE] [--trace FILE]\n");
+    printf("  --trace FILE   Write a $PHLM,TRACE dump of the end of the run, needs a HELM_TRACE build (make trace)\n");
+}
+
+static bool parseOptions(int argc, char **argv, SimulatorOptions *options) {
+    options->seconds = 10;
+    options->gpsRate = 1;
+    options->gsvFlood = false;
+    options->ais = true;
+    options->collisionPercent = 10;
+    options->seed = 1;
+    options->capturePath = NULL;
+    options->tracePath = NULL;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--seconds") == 0 && hasValue) {
+            options->seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--gps-rate") == 0 && hasValue) {
+            options->gpsRate = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--gsv-flood") == 0) {
+            options->gsvFlood = true;
+        } else if (strcmp(argv[i], "--no-ais") == 0) {
+            options->ais = false;
+        } else if (strcmp(argv[i], "--collisions") == 0 && hasValue) {
+            options->collisionPercent = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && hasValue) {
+            options->seed = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--capture") == 0 && hasValue) {
+            options->capturePath = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && hasValue) {
+            options->tracePath = argv[++i];
+        } else {
+            return false;
+        }
+    }
+    return options->gpsRate > 0 && options->seconds > 0;
+}
+
+int main(int argc, char **argv) {
+    SimulatorOptions options;
+    if (!parseOptions(argc, argv, &options)) {
+        printUsage();
+        return 1;
+    }
+    srand(options.seed);
+
+    MockSerial serials[PortCount];
+    for (int port = 0; port < PortCount; port++) {
+        serials[port].begin(mockPortBauds[port], mockPortFormats[port]);
+        serials[port].setBufferSizes(mockRxBufferSizes[port], mockTxBufferSizes[port]);
+    }
+    MockSerial &output = serials[PortOutput];
+    MockSerial &nmeaHighSpeed = serials[PortNMEAHighSpeed];
+    MockSerial &nmea = serials[PortNMEA];
+    MockSerial &seaTalk = serials[PortSeaTalk];
+    MockSerial &gps = serials[PortGPS];
+
+    SerialPortAdapter<MockSerial> outputPort(output);
+    SerialPortAdapter<MockSerial> nmeaHighSpeedPort(nmeaHighSpeed);
+    SerialPortErrorCountingAdapter<MockSerial> nmeaPort(nmea);
+    SerialPort9BitAdapter<MockSerial> seaTalkPort(seaTalk);
+    SerialPortAdapter<MockSerial> gpsPort(gps);
+    SerialPort *ports[PortCount] = {&outputPort, &nmeaHighSpeedPort, &nmeaPort, &seaTalkPort, &gpsPort};
+
+    // Everything the router reads and writes can be recorded for make replay
+    FILE *captureFile = NULL;
+    std::vector<uint8_t> captureBuffer(1 << 16);
+    CaptureWriter captureWriter(&captureBuffer[0], captureBuffer.size());
+    std::vector<CaptureSerialPort> capturePorts;
+    // Ports are handed to the router by pointer, so the vector must never reallocate
+    capturePorts.reserve(PortCount);
+    if (options.capturePath) {
+        captureFile = fopen(options.capturePath, "wb");
+        if (!captureFile) {
+            fprintf(stderr, "Can't write %s\n", options.capturePath);
+            return 1;
+        }
+        for (int port = 0; port < PortCount; port++) {
+            capturePorts.push_back(CaptureSerialPort(ports[port], (Port)port, &captureWriter));
+            ports[port] = &capturePorts.back();
+        }
+    }
+
+    Router router;
+    // Stack used by everything main() calls from here on, the simulation included
+    stackPaint();
+    for (int port = 0; port < PortCount; port++) {
+        router.setPort((Port)port, ports[port]);
+    }
+
+    SimulatedGPS simulatedGPS(gps, options);
+    SimulatedAIS simulatedAIS(nmeaHighSpeed);
+    SimulatedSeaTalkBus seaTalkBus(seaTalk, options);
+    SimulatedComputer computer(output);
+    NMEAOutput outputs[] = {NMEAOutput(output, "OUTPUT"), NMEAOutput(nmeaHighSpeed, "NMEAHS"), NMEAOutput(nmea, "NMEA")};
+
+    uint32_t duration = options.seconds * 1000000;
+    for (uint32_t now = 0; now < duration; now += SIMULATOR_POLL_MICROS) {
+        mockSetMicros(now);
+        simulatedGPS.step(now);
+        if (options.ais) {
+            simulatedAIS.step(now);
+        }
+        seaTalkBus.step(now);
+        computer.step(now);
+        router.poll(millis());
+        for (size_t i = 0; i < sizeof(outputs) / sizeof(outputs[0]); i++) {
+            outputs[i].step();
+        }
+        if (captureFile && (captureWriter.length() > captureBuffer.size() / 2 || now + SIMULATOR_POLL_MICROS >= duration)) {
+            for (size_t i = 0; now + SIMULATOR_POLL_MICROS >= duration && i < capturePorts.size(); i++) {
+                capturePorts[i].flush();
+            }
+            fwrite(captureWriter.data(), 1, captureWriter.length(), captureFile);
+            captureWriter.consume(captureWriter.length());
+        }
+    }
+    if (captureFile) {
+        fclose(captureFile);
+    }
+    if (options.tracePath) {
+        // The same sentences $PHLM,TRACE sends the computer
+        FILE *traceFile = fopen(options.tracePath, "w");
+        if (!traceFile) {
+            fprintf(stderr, "Can't write %s\n", options.tracePath);
+            return 1;
+        }
+        char sentence[NMEA_MESSAGE_MAX_LENGTH];
+        uint32_t offset = 0;
+        while (traceDumpSentence(&offset, sentence, sizeof(sentence) - 6)) {
+            closeMessage(sentence);
+            fputs(sentence, traceFile);
+        }
+        fclose(traceFile);
+    }
+
+    printf("Simulated %.1fs, GPS at %dHz%s, AIS %s, %d%% SeaTalk collisions\n\n", options.seconds, options.gpsRate, options.gsvFlood ? " with GSV flood" : "", options.ais ? "saturated" : "off", options.collisionPercent);
+    // RX bytes/s, high water and full passes are what the router sampled itself, as $PHLM,STATS reports them on the device
+    printf("%-8s %12s %8s %8s %12s %12s %12s\n", "Port", "RX bytes/s", "RX high", "RX full", "RX overruns", "TX bytes/s", "TX drops");
+    for (int port = 0; port < PortCount; port++) {
+        uint32_t txBytes = port < PortSeaTalk ? outputs[port].bytes() : (port == PortSeaTalk ? seaTalkBus.bytes() : 0);
+        const RouterPortStats *stats = router.portStats((Port)port);
+        printf("%-8s %12.0f %8u %8lu %12lu %12.0f %12lu\n", RoutingTable::portName((Port)port), stats->bytesRead / options.seconds, (unsigned)stats->highWater, (unsigned long)stats->fullPasses, (unsigned long)serials[port].overflowCount(), txBytes / options.seconds, (unsigned long)router.txDropCount((Port)port));
+    }
+    printf("\nSeaTalk collisions: %d, echoes filtered: %d\n\n", seaTalkBus.collisionCount(), router.seaTalkEchoFilter()->echoCount());
+
+    printf("%-24s %8s %10s %10s %10s\n", "Route", "Count", "Min us", "Avg us", "Max us");
+    std::map<std::string, LatencyStats> &routes = latencyTracker.routes();
+    for (std::map<std::string, LatencyStats>::iterator it = routes.begin(); it != routes.end(); ++it) {
+        LatencyStats &stats = it->second;
+        printf("%-24s %8lu %10lu %10lu %10lu\n", it->first.c_str(), (unsigned long)stats.count, (unsigned long)stats.min, (unsigned long)(stats.total / stats.count), (unsigned long)stats.max);
+    }
+
+    // What the router measured itself, as $PHLM,LATENCY reports it on the device
+    printf("\n%-24s %8s %10s %10s %10s\n", "Router probe", "Count", "p50 us", "p99 us", "Max us");
+    for (int i = 0; i < RouterLatencyRouteCount; i++) {
+        LatencyProbe *probe = router.latencyProbe((RouterLatencyRoute)i);
+        LatencyHistogram *histogram = probe->histogram();
+        printf("%-24s %8lu %10lu %10lu %10lu\n", probe->name(), (unsigned long)histogram->count(), (unsigned long)histogram->percentile(0.5), (unsigned long)histogram->percentile(0.99), (unsigned long)histogram->max());
+    }
+    printf("\nStack high water: %lu of %lu bytes painted\n", (unsigned long)stackHighWater(), (unsigned long)stackPaintedSize());
+
+    // What MemoryBudget.cpp checks at compile time, the same on the Teensy apart from pointer sizes
+    printf("\n%-24s %8s\n", "Static RAM", "Bytes");
+    for (int i = 0; i < memoryBudgetEntryCount; i++) {
+        if (memoryBudgetEntries[i].isRouterPart) {
+            continue;
+        }
+        printf("%-24s %8lu\n", memoryBudgetEntries[i].name, (unsigned long)memoryBudgetEntries[i].bytes);
+        // The Router's parts go under it
+        for (int j = 0; j < memoryBudgetEntryCount && strcmp(memoryBudgetEntries[i].name, "Router") == 0; j++) {
+            if (memoryBudgetEntries[j].isRouterPart) {
+                printf("  %-22s %8lu\n", memoryBudgetEntries[j].name, (unsigned long)memoryBudgetEntries[j].bytes);
+            }
+        }
+    }
+    printf("%-24s %8lu of %lu\n", "Total", (unsigned long)MEMORY_BUDGET_TOTAL_BYTES, (unsigned long)MEMORY_BUDGET_CEILING_BYTES);
+    return 0;
+}
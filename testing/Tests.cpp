@@ -3,6 +3,19 @@
 #include "../NMEAMessage.h"
 #include "../SeaTalkMessage.h"
 #include "../SeaTalkParser.h"
+#include "../NMEAParser.h"
+#include "../EchoFilter.h"
+#include "../MessageQueue.h"
+#include "../RoutingTable.h"
+#include "../Router.h"
+#include "../Capture.h"
+#include "../StackPaint.h"
+#include "../MemoryBudget.h"
+#include "Arduino.h"
+#include "AllocationCounter.h"
+#include "MockPorts.h"
+#include "AltSoftSerialHarness.h"
+#include <vector>
 
 
 void failForDifferingArrays(uint8_t *array, uint8_t *expectedArray, int length, const char *failureMessage) {
@@ -32,51 +45,92 @@ TEST_CASE( "NMEAMessageRMC is parsed properly" ) {
     NMEAMessageRMC rmc = NMEAMessageRMC("$GPRMC,045431.00,A,3751.98405,N,12218.96980,W,0.078,,041114,,,D*68\r\n");
     REQUIRE( rmc.time().hour == 4 );
     REQUIRE( rmc.time().minute == 54 );
-    REQUIRE( rmc.time().second == 31 );
-    REQUIRE( rmc.latitude() == 37.86640083333333 );
-    REQUIRE( rmc.longitude() == -122.31616333333334 );
-    REQUIRE( rmc.speedOverGround() == 0.078 );
+    REQUIRE( rmc.time().millisecond == 31000 );
+    REQUIRE( rmc.latitude() == 378664008 );
+    REQUIRE( rmc.longitude() == -1223161633 );
+    REQUIRE( rmc.speedOverGround() == 8 );
     REQUIRE( rmc.date().day == 4 );
     REQUIRE( rmc.date().month == 11 );
     REQUIRE( rmc.date().year == 14 );
 
     // Theoretical message including track made good and magnetic variation
     rmc = NMEAMessageRMC("$GPRMC,045431.00,A,3751.98405,N,12218.96980,W,0.078,45.2,041114,42.2,W,D*68\r\n");
-    REQUIRE( rmc.trackMadeGood().degrees == 45.2f );
-    REQUIRE( rmc.magneticVariation() == -42.2 );
+    REQUIRE( rmc.trackMadeGood().deciDegrees == 452 );
+    REQUIRE( rmc.magneticVariation() == -422 );
 }
 
 TEST_CASE( "NMEAMessageGLL is paresd properly" ) {
     // Actual message from a uBlox-6 GPS
     NMEAMessageGLL gll = NMEAMessageGLL("$GPGLL,3751.98415,N,12218.97005,W,045445.00,A,D*78\r\n");
-    REQUIRE( gll.latitude() == 37.8664025 );
-    REQUIRE( gll.longitude() == -122.3161675 );
+    REQUIRE( gll.latitude() == 378664025 );
+    REQUIRE( gll.longitude() == -1223161675 );
     REQUIRE( gll.time().hour == 4 );
     REQUIRE( gll.time().minute == 54 );
-    REQUIRE( gll.time().second == 45 );
+    REQUIRE( gll.time().millisecond == 45000 );
+}
+
+TEST_CASE( "Fixed point fields convert exactly" ) {
+    REQUIRE( fixedFromString("2.345", 2) == 235 );
+    REQUIRE( fixedFromString("-2.344", 2) == -234 );
+    REQUIRE( fixedFromString("12", 1) == 120 );
+    REQUIRE( fixedFromString("", 1) == 0 );
+    REQUIRE( fixedFromString("0.078,", 2) == 8 );
+
+    char string[16];
+    REQUIRE( fixedToString(3154, 1, string) == 5 );
+    REQUIRE( std::string(string) == "315.4" );
+    fixedToString(-5, 2, string);
+    REQUIRE( std::string(string) == "-0.05" );
+    fixedToString(7, 0, string);
+    REQUIRE( std::string(string) == "7" );
+
+    REQUIRE( coordinateFromString("3751.98405", 'N') == 378664008 );
+    REQUIRE( coordinateFromString("00000.00000", 'E') == 0 );
+    REQUIRE( coordinateFromString("17959.99999", 'W') == -1799999998 );
+    REQUIRE( coordinateFromString("", 'N') == 0 );
+
+    REQUIRE( divideRounded(15, 10) == 2 );
+    REQUIRE( divideRounded(-15, 10) == -2 );
+    REQUIRE( divideRounded(14, 10) == 1 );
+}
+
+TEST_CASE( "splitMessageIntoFragments points into the sentence" ) {
+    const char *sentence = "$GPGLL,3751.98415,N,,W*78";
+    NMEAFragment fragments[8];
+    int fragmentCount;
+    splitMessageIntoFragments(sentence, strlen(sentence), fragments, 8, &fragmentCount);
+    REQUIRE( fragmentCount == 5 );
+    REQUIRE( fragments[1].start == &sentence[7] );
+    REQUIRE( fragmentEquals(fragments[1], "3751.98415") );
+    REQUIRE( fragments[3].length == 0 );
+    REQUIRE( fragments[3].start[0] == ',' );
+    // Past the end of the sentence is empty
+    REQUIRE( fragments[6].length == 0 );
+    REQUIRE( fragments[6].start[0] == 0 );
+    REQUIRE( !fragmentEquals(fragments[2], "NE") );
 }
 
 TEST_CASE( "NMEAMessageWind is constructed properly" ) {
-    NMEAMessageWind mwv = NMEAMessageWind(315.4, 12.2);
+    NMEAMessageWind mwv = NMEAMessageWind(3154, 1220);
     REQUIRE( strlen(mwv.message()) == 28 );
     // Comparisons of char* don't work
     REQUIRE( std::string(mwv.message()) == std::string("$WIMWV,315.4,R,12.2,N,A*11\r\n") );
 }
 
 TEST_CASE( "NMEAMessageDBT is constructed properly" ) {
-    NMEAMessageDBT dbt = NMEAMessageDBT(24.3);
+    NMEAMessageDBT dbt = NMEAMessageDBT(243);
     REQUIRE( strlen(dbt.message()) == 24 );
     REQUIRE( std::string(dbt.message()) == std::string("$STDBT,24.3,f,,M,,F*23\r\n") );
 }
 
 TEST_CASE( "NMEAMessageVHW is constructed properly" ) {
-    NMEAMessageVHW vhw = NMEAMessageVHW(6.39);
+    NMEAMessageVHW vhw = NMEAMessageVHW(639);
     REQUIRE( strlen(vhw.message()) == 26);
     REQUIRE( std::string(vhw.message()) == std::string("$STVHW,,T,,M,6.4,N,,K*7E\r\n") );
 }
 
 TEST_CASE( "NMEAMessageHDM is constructed properly" ) {
-    NMEAMessageHDM hdm = NMEAMessageHDM(236.3);
+    NMEAMessageHDM hdm = NMEAMessageHDM(2363);
     REQUIRE( strlen(hdm.message()) == 19);
     REQUIRE( std::string(hdm.message()) == std::string("$STHDM,236.3,M*21\r\n") );
 }
@@ -84,31 +138,31 @@ TEST_CASE( "NMEAMessageHDM is constructed properly" ) {
 TEST_CASE( "NMEAMessageRMB is parsed properly" ) {
     NMEAMessageRMB rmb = NMEAMessageRMB("$ECRMB,A,0.000,L,tospace,001,3751.944,N,12219.721,W,0.596,266.197,0.055,V*37\r\n");
     REQUIRE( rmb.status() == StatusActive );
-    REQUIRE( rmb.xte() == 0.0 );
+    REQUIRE( rmb.xte() == 0 );
     REQUIRE( rmb.directionToSteer() == LateralityLeft );
-    REQUIRE( rmb.toWaypointID() == std::string("tospace") );
-    REQUIRE( rmb.fromWaypointID() == std::string("001") );
-    REQUIRE( rmb.destinationLatitude() == 37.86573333333333333);
-    REQUIRE( rmb.destinationLongitude() == -122.32868333333333);
-    REQUIRE( rmb.rangeToDestiation() == 0.596f );
-    REQUIRE( rmb.bearingToDestination().degrees == 266.197f);
-    REQUIRE( rmb.destinationClosingVelocity() == 0.055f);
+    REQUIRE( fragmentEquals(rmb.toWaypointID(), "tospace") );
+    REQUIRE( fragmentEquals(rmb.fromWaypointID(), "001") );
+    REQUIRE( rmb.destinationLatitude() == 378657333 );
+    REQUIRE( rmb.destinationLongitude() == -1223286833 );
+    REQUIRE( rmb.rangeToDestiation() == 60 );
+    REQUIRE( rmb.bearingToDestination().deciDegrees == 2662 );
+    REQUIRE( rmb.destinationClosingVelocity() == 6 );
 }
 
 TEST_CASE( "NMEAMessageAPB is parsed properly" ) {
     NMEAMessageAPB apb = NMEAMessageAPB("$ECAPB,A,A,2.345,L,N,V,V,266.243,T,001,266.197,T,266.197,T*35");
     REQUIRE( apb.isUnreliableFix() == false );
     REQUIRE( apb.isCycleLockWarning() == false );
-    REQUIRE( apb.xte() == 2.345f );
+    REQUIRE( apb.xte() == 235 );
     REQUIRE( apb.directionToSteer() == LateralityLeft );
     REQUIRE( apb.isArrived() == false );
     REQUIRE( apb.isPerpendicularPassed() == false );
-    REQUIRE( apb.bearingOriginToDestination().degrees == 266.243f );
+    REQUIRE( apb.bearingOriginToDestination().deciDegrees == 2662 );
     REQUIRE( apb.bearingOriginToDestination().isMagnetic == false );
-    REQUIRE( apb.destinationWaypointID() == std::string("001") );
-    REQUIRE( apb.bearingPresentToDestination().degrees == 266.197f );
+    REQUIRE( fragmentEquals(apb.destinationWaypointID(), "001") );
+    REQUIRE( apb.bearingPresentToDestination().deciDegrees == 2662 );
     REQUIRE( apb.bearingPresentToDestination().isMagnetic == false );
-    REQUIRE( apb.headingToSteerToWaypoint().degrees == 266.197f );
+    REQUIRE( apb.headingToSteerToWaypoint().deciDegrees == 2662 );
     REQUIRE( apb.headingToSteerToWaypoint().isMagnetic == false );
 }
 
@@ -127,6 +181,88 @@ TEST_CASE( "NMEAMessageSEA is parsed properly" ) {
     }
 }
 
+TEST_CASE( "NMEAMessageSEA decodes into a caller supplied buffer" ) {
+    uint8_t expected[4] = {0x10, 0x11, 0x02, 0x6E};
+    uint8_t message[4];
+    REQUIRE( NMEAMessageSEA::decodeSeaTalkMessage("$STSEA,1011026E*0C\r\n", message, sizeof(message)) == 4 );
+    if (!arraysAreEqual(message, expected, 4)) {
+        failForDifferingArrays(message, expected, 4, "decodeSeaTalkMessage generated incorrect byte string.");
+    }
+    // Too long for the buffer or an odd number of hex digits
+    REQUIRE( NMEAMessageSEA::decodeSeaTalkMessage("$STSEA,1011026E00*0C\r\n", message, sizeof(message)) == 0 );
+    REQUIRE( NMEAMessageSEA::decodeSeaTalkMessage("$STSEA,1011026*0C\r\n", message, sizeof(message)) == 0 );
+}
+
+TEST_CASE( "Hex codec round trips whole buffers" ) {
+    uint8_t binary[5] = {0x00, 0x9C, 0xA1, 0x1C, 0xFF};
+    char hex[11];
+    REQUIRE( binaryToAsciiHex(binary, 5, hex) == 10 );
+    hex[10] = 0;
+    REQUIRE( std::string(hex) == std::string("009CA11CFF") );
+    uint8_t decoded[5];
+    REQUIRE( asciiHexToBinary("009ca11cFF", 10, decoded) == 5 );
+    if (!arraysAreEqual(decoded, binary, 5)) {
+        failForDifferingArrays(decoded, binary, 5, "asciiHexToBinary generated incorrect byte string.");
+    }
+    // Stops at the first char that isn't hex
+    REQUIRE( asciiHexToBinary("009CZ1", 6, decoded) == 2 );
+}
+
+TEST_CASE( "NMEAParser bulk parse stops after each sentence" ) {
+    NMEAParser parser = NMEAParser();
+    // Starts with the tail of a sentence we missed the beginning of
+    const char *stream = "45*68\r\n$GPGLL,3751.98415,N,12218.97005,W,045445.00,A,D*78\r\n$STSEA,1011026E*0C\r\n";
+    int length = strlen(stream);
+    bool complete;
+    int offset = parser.parse(stream, length, &complete);
+    REQUIRE( complete == true );
+    REQUIRE( offset == 57 );
+    REQUIRE( std::string(parser.message()) == std::string("$GPGLL,3751.98415,N,12218.97005,W,045445.00,A,D*78\r\n") );
+    offset += parser.parse(&stream[offset], length - offset, &complete);
+    REQUIRE( complete == true );
+    REQUIRE( std::string(parser.message()) == std::string("$STSEA,1011026E*0C\r\n") );
+    offset += parser.parse(&stream[offset], length - offset, &complete);
+    REQUIRE( complete == false );
+    REQUIRE( offset == length );
+}
+
+TEST_CASE( "NMEAParser starts AIS sentences at '!'" ) {
+    REQUIRE( nmeaIsSentenceStart('$') );
+    REQUIRE( nmeaIsSentenceStart('!') );
+    REQUIRE( nmeaIsSentenceStart('A') == false );
+    NMEAParser parser = NMEAParser();
+    const char *stream = "KH,0*5C\r\n!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C\r\n";
+    bool complete;
+    parser.parse(stream, strlen(stream), &complete);
+    REQUIRE( complete == true );
+    REQUIRE( std::string(parser.message()) == std::string("!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C\r\n") );
+}
+
+TEST_CASE( "SizedNMEAParser keeps sentences that fit and drops the rest" ) {
+    // 20 chars with the line ending, so it needs 21 for the NULL terminator
+    const char *sentence = "$STSEA,1011026E*0C\r\n";
+    SizedNMEAParser<21> fits;
+    bool complete;
+    fits.parse(sentence, strlen(sentence), &complete);
+    REQUIRE( complete == true );
+    REQUIRE( std::string(fits.message()) == sentence );
+
+    struct {
+        SizedNMEAParser<20> parser;
+        char guard[8];
+    } tooShort;
+    memset(tooShort.guard, 0x5A, sizeof(tooShort.guard));
+    REQUIRE( tooShort.parser.capacity() == 20 );
+    tooShort.parser.parse(sentence, strlen(sentence), &complete);
+    REQUIRE( complete == false );
+    for (const char *c = sentence; *c; c++) {
+        REQUIRE( tooShort.parser.parse(*c) == false );
+    }
+    for (size_t i = 0; i < sizeof(tooShort.guard); i++) {
+        REQUIRE( tooShort.guard[i] == 0x5A );
+    }
+}
+
 TEST_CASE( "SeaTalkParser" ) {
     SeaTalkParser parser = SeaTalkParser();
     bool completed;
@@ -139,16 +275,84 @@ TEST_CASE( "SeaTalkParser" ) {
     REQUIRE( parser.messageLength() == 3 );
 }
 
+TEST_CASE( "SeaTalkParser rejects messages with the wrong length for their command" ) {
+    SeaTalkParser parser = SeaTalkParser();
+    // Wind angle is always 4 bytes, this one claims 5
+    REQUIRE( parser.parse(0x110) == false );
+    REQUIRE( parser.parse(0x02) == false );
+    REQUIRE( parser.parse(0x01) == false );
+    REQUIRE( parser.parse(0x6E) == false );
+    REQUIRE( parser.invalidMessageCount() == 1 );
+    REQUIRE( parser.discardedByteCount() == 2 );
+    // And resyncs on the next command byte
+    REQUIRE( parser.parse(0x199) == false );
+    REQUIRE( parser.parse(0x00) == false );
+    REQUIRE( parser.parse(0xF3) == true );
+    REQUIRE( parser.messagesParsedCount() == 1 );
+}
+
+TEST_CASE( "SeaTalkParser checks redundancy bytes" ) {
+    SeaTalkParser parser = SeaTalkParser();
+    uint16_t corrupt[8] = {0x182, 0x05, 0x00, 0xFF, 0x00, 0xFE, 0x04, 0xFB};
+    bool completed = false;
+    for (int i = 0; i < 8; i++) {
+        completed = parser.parse(corrupt[i]);
+    }
+    REQUIRE( completed == false );
+    REQUIRE( parser.invalidMessageCount() == 1 );
+
+    uint16_t valid[8] = {0x182, 0x05, 0x00, 0xFF, 0x00, 0xFF, 0x04, 0xFB};
+    for (int i = 0; i < 8; i++) {
+        completed = parser.parse(valid[i]);
+    }
+    REQUIRE( completed == true );
+    REQUIRE( parser.messageLength() == 8 );
+}
+
+TEST_CASE( "SeaTalkParser counts messages cut short by a command byte" ) {
+    SeaTalkParser parser = SeaTalkParser();
+    parser.parse(0x100);
+    parser.parse(0x02);
+    parser.parse(0x00);
+    REQUIRE( parser.parse(0x199) == false );
+    REQUIRE( parser.truncatedMessageCount() == 1 );
+    REQUIRE( parser.invalidMessageCount() == 0 );
+}
+
+TEST_CASE( "seaTalkMessageIsValid" ) {
+    uint8_t nav[9] = {0x85, 0x56, 0x10, 0x42, 0x16, 0x20, 0x17, 0x00, 0xE8};
+    REQUIRE( seaTalkMessageIsValid(nav, 9) == true );
+    nav[8] = 0xE9;
+    REQUIRE( seaTalkMessageIsValid(nav, 9) == false );
+    uint8_t unknown[5] = {0xF0, 0x02, 0x00, 0x00, 0x00};
+    REQUIRE( seaTalkMessageIsValid(unknown, 5) == true );
+    REQUIRE( seaTalkMessageIsValid(unknown, 4) == false );
+}
+
+TEST_CASE( "seaTalkMessageIsValid checks TRACK keystrokes" ) {
+    uint8_t track[4] = {0x55, 0x11, 0x01, 0xFE};
+    REQUIRE( seaTalkMessageIsValid(track, 4) == true );
+    track[3] = 0xFF;
+    REQUIRE( seaTalkMessageIsValid(track, 4) == false );
+}
+
+TEST_CASE( "seaTalkMessageIsValid checks code lock data" ) {
+    uint8_t codeLock[4] = {0x38, 0x01, 0x5A, 0xA5};
+    REQUIRE( seaTalkMessageIsValid(codeLock, 4) == true );
+    codeLock[2] = 0x5B;
+    REQUIRE( seaTalkMessageIsValid(codeLock, 4) == false );
+}
+
 TEST_CASE( "SeaTalkMessageWindAngle is parsed properly" ) {
     uint8_t message[4] = {0x10, 0x11, 0x02, 0x6E};
     SeaTalkMessageWindAngle windAngle = SeaTalkMessageWindAngle(message);
-    REQUIRE( windAngle.windAngle() == 311.0 );
+    REQUIRE( windAngle.windAngle() == 3110 );
 }
 
 TEST_CASE( "SeaTalkMessageWindSpeed is parsed properly" ) {
     uint8_t message[4] = {0x11, 0x11, 0x02, 0x03};
     SeaTalkMessageWindSpeed windSpeed = SeaTalkMessageWindSpeed(message);
-    REQUIRE( windSpeed.windSpeed() == 2.3f );
+    REQUIRE( windSpeed.windSpeed() == 230 );
 }
 
 void assertEqualSeaTalkMessages(BaseSeaTalkMessage *seaTalkMessage, uint8_t *expected, int expectedLength) {
@@ -167,7 +371,7 @@ TEST_CASE( "SeaTalkMessageLampIntensity is generated properly ") {
 }
 
 TEST_CASE( "SeaTalkMessageLatitude is generated properly" ) {
-    SeaTalkMessageLatitude lat = SeaTalkMessageLatitude(37.866384);
+    SeaTalkMessageLatitude lat = SeaTalkMessageLatitude(378663840);
     uint8_t expected[5] = {0x50, 0x02, 0x25, 0x4E, 0x14};
     assertEqualSeaTalkMessages(&lat, expected, 5);
     //$GPRMC,045547.00,A,3751.98304,N,12218.97136,W,0.016,,041114,,,D*62
@@ -175,7 +379,7 @@ TEST_CASE( "SeaTalkMessageLatitude is generated properly" ) {
 }
 
 TEST_CASE( "SeaTalkMessageLongitude is generated properly" ) {
-    SeaTalkMessageLongitude lon = SeaTalkMessageLongitude(-122.316189333);
+    SeaTalkMessageLongitude lon = SeaTalkMessageLongitude(-1223161893);
     uint8_t expected[5] = {0x51, 0x02, 0x7A, 0x69, 0x07};
     assertEqualSeaTalkMessages(&lon, expected, 5);
     //$GPRMC,045547.00,A,3751.98304,N,12218.97136,W,0.016,,041114,,,D*62
@@ -190,26 +394,26 @@ TEST_CASE( "SeaTalkMessageSpeedOverGround is generated properly" ) {
 }
 
 TEST_CASE( "SeaTalkMessageMagneticCourse is generated properly" ) {
-    SeaTalkMessageMagneticCourse mc = SeaTalkMessageMagneticCourse(149.9);
+    SeaTalkMessageMagneticCourse mc = SeaTalkMessageMagneticCourse(1499);
     uint8_t expected[3] = {0x53, 0x10, 0x1e};
     assertEqualSeaTalkMessages(&mc, expected, sizeof(expected));
 }
 
 TEST_CASE( "SeaTalkMessageMagneticCourse rounding" ) {
-    SeaTalkMessageMagneticCourse mc = SeaTalkMessageMagneticCourse(159.9);
-    REQUIRE( mc.course() == 160.0f );
+    SeaTalkMessageMagneticCourse mc = SeaTalkMessageMagneticCourse(1599);
+    REQUIRE( mc.course() == 1600 );
 
-    mc = SeaTalkMessageMagneticCourse(149.9);
-    REQUIRE( mc.course() == 150.0f );
+    mc = SeaTalkMessageMagneticCourse(1499);
+    REQUIRE( mc.course() == 1500 );
 
-    mc = SeaTalkMessageMagneticCourse(149.6);
-    REQUIRE( mc.course() == 149.5f );
+    mc = SeaTalkMessageMagneticCourse(1496);
+    REQUIRE( mc.course() == 1495 );
 
-    mc = SeaTalkMessageMagneticCourse(249.4);
-    REQUIRE( mc.course() == 249.5f );
+    mc = SeaTalkMessageMagneticCourse(2494);
+    REQUIRE( mc.course() == 2495 );
 
-    mc = SeaTalkMessageMagneticCourse(349.2);
-    REQUIRE( mc.course() == 349.0f );
+    mc = SeaTalkMessageMagneticCourse(3492);
+    REQUIRE( mc.course() == 3490 );
 }
 
 TEST_CASE( "SeaTalkMessageTime is generated properly" ) {
@@ -219,14 +423,14 @@ TEST_CASE( "SeaTalkMessageTime is generated properly" ) {
     Time time;
     time.hour = 4;
     time.minute = 54;
-    time.second = 43;
+    time.millisecond = 43000;
     SeaTalkMessageTime sttime = SeaTalkMessageTime(time);
     uint8_t expected[4] = {0x54, 0xB1, 0xDA, 0x04};
     assertEqualSeaTalkMessages(&sttime, expected, 4);
 }
 
 TEST_CASE( "SeaTalkMessageDepth is generated properly" ) {
-    SeaTalkMessageDepth depth = SeaTalkMessageDepth(12.36);
+    SeaTalkMessageDepth depth = SeaTalkMessageDepth(124);
     uint8_t expected[5] = {0x00, 0x02, 0x00, 0x7C, 0x00};
     assertEqualSeaTalkMessages(&depth, expected, 5);
 }
@@ -234,11 +438,11 @@ TEST_CASE( "SeaTalkMessageDepth is generated properly" ) {
 TEST_CASE( "SeaTalkMessageDepth is parsed properly" ) {
     uint8_t message[5] = {0x00, 0x42, 0x30, 0x46, 0x05};
     SeaTalkMessageDepth depth = SeaTalkMessageDepth(message);
-    REQUIRE( depth.depth() == 135 );
+    REQUIRE( depth.depth() == 1350 );
 }
 
 TEST_CASE( "SeaTalkMessageSpeedThroughWater is generated properly" ) {
-    SeaTalkMessageSpeedThroughWater stw = SeaTalkMessageSpeedThroughWater(5.3);
+    SeaTalkMessageSpeedThroughWater stw = SeaTalkMessageSpeedThroughWater(530);
     uint8_t expected[4] = {0x20, 0x01, 0x35, 0x00};
     assertEqualSeaTalkMessages(&stw, expected, 4);
 }
@@ -246,7 +450,7 @@ TEST_CASE( "SeaTalkMessageSpeedThroughWater is generated properly" ) {
 TEST_CASE( "SeaTalkMessageSpeedThroughWater is parsed properly" ) {
     uint8_t message[4] = {0x20, 0x41, 0x35, 0x00};
     SeaTalkMessageSpeedThroughWater stw = SeaTalkMessageSpeedThroughWater(message);
-    REQUIRE( stw.speed() == 5.3 );
+    REQUIRE( stw.speed() == 530 );
 }
 
 TEST_CASE( "SeaTalkMessageTargetWaypointName is parsed properly" ) {
@@ -261,6 +465,15 @@ TEST_CASE( "SeaTalkMessageTargetWaypointName is generated properly" ) {
     assertEqualSeaTalkMessages(&twn, expected, sizeof(expected));
 }
 
+TEST_CASE( "SeaTalkMessageTargetWaypointName takes names that aren't NULL terminated" ) {
+    SeaTalkMessageTargetWaypointName terminated = SeaTalkMessageTargetWaypointName("001");
+    SeaTalkMessageTargetWaypointName fragment = SeaTalkMessageTargetWaypointName("001,T*35", 3);
+    assertEqualSeaTalkMessages(&fragment, terminated.message(), terminated.messageLength());
+    SeaTalkMessageArrivalInfo arrivalTerminated = SeaTalkMessageArrivalInfo(true, false, "tospace");
+    SeaTalkMessageArrivalInfo arrivalFragment = SeaTalkMessageArrivalInfo(true, false, "tospace,001", 7);
+    assertEqualSeaTalkMessages(&arrivalFragment, arrivalTerminated.message(), arrivalTerminated.messageLength());
+}
+
 TEST_CASE( "SeaTalkMessageTargetWaypointName loopback test" ) {
     SeaTalkMessageTargetWaypointName twn = SeaTalkMessageTargetWaypointName("asDf");
     SeaTalkMessageTargetWaypointName twn2 = SeaTalkMessageTargetWaypointName(twn.message());
@@ -281,9 +494,9 @@ TEST_CASE( "SeaTalkMessageNavigationToWaypoint is generated properly" ) {
     // Created from the examples in the Knauf doc
     uint8_t expected[9] = {0x85, 0x56, 0x10, 0x42, 0x16, 0x20, 0x17, 0x00, 0xE8};
     Heading bearingToDestination;
-    bearingToDestination.degrees = 230;
+    bearingToDestination.deciDegrees = 2300;
     bearingToDestination.isMagnetic = true;
-    SeaTalkMessageNavigationToWaypoint nav = SeaTalkMessageNavigationToWaypoint(2.61, bearingToDestination, 5.13, LateralityLeft, 0x7);
+    SeaTalkMessageNavigationToWaypoint nav = SeaTalkMessageNavigationToWaypoint(261, bearingToDestination, 513, LateralityLeft, 0x7);
     assertEqualSeaTalkMessages(&nav, expected, sizeof(expected));
 }
 
@@ -291,10 +504,10 @@ TEST_CASE( "SeaTalkMessageNavigationToWaypoint is parsed properly" ) {
     // Created from the examples in the Knauf doc
     uint8_t message[9] = {0x85, 0x56, 0x10, 0x42, 0x16, 0x20, 0x17, 0x00, 0xE8};
     SeaTalkMessageNavigationToWaypoint nav = SeaTalkMessageNavigationToWaypoint(message);
-    REQUIRE( nav.xte() == 2.61f );
-    REQUIRE( nav.bearingToDestination().degrees == 230 );
+    REQUIRE( nav.xte() == 261 );
+    REQUIRE( nav.bearingToDestination().deciDegrees == 2300 );
     REQUIRE( nav.bearingToDestination().isMagnetic == true );
-    REQUIRE( nav.distanceToDestination() == 5.13f );
+    REQUIRE( nav.distanceToDestination() == 513 );
     REQUIRE( nav.directionToSteer() == LateralityLeft );
     REQUIRE( nav.trackControlMode() == 0x7 );
 }
@@ -343,3 +556,838 @@ TEST_CASE( "SeaTalkMessageDeviceQuery is generated properly" ) {
     SeaTalkMessageDeviceQuery dq = SeaTalkMessageDeviceQuery();
     assertEqualSeaTalkMessages(&dq, expected, sizeof(expected));
 }
+
+TEST_CASE( "EchoFilter recognizes echoes of transmitted messages" ) {
+    EchoFilter filter = EchoFilter();
+    uint8_t sent[4] = {0x52, 0x01, 0x35, 0x00};
+    uint8_t other[4] = {0x52, 0x01, 0x36, 0x00};
+    filter.transmitted(sent, 4, PortGPS, 1000);
+    REQUIRE( filter.isEcho(other, 4, 1010) == false );
+    Port origin = PortCount;
+    REQUIRE( filter.isEcho(sent, 4, 1040, &origin) == true );
+    REQUIRE( origin == PortGPS );
+    // Each transmission only echoes once
+    REQUIRE( filter.isEcho(sent, 4, 1050) == false );
+    REQUIRE( filter.echoCount() == 1 );
+    REQUIRE( filter.echoCount(PortGPS) == 1 );
+    REQUIRE( filter.echoCount(PortOutput) == 0 );
+}
+
+TEST_CASE( "EchoFilter forgets old transmissions" ) {
+    EchoFilter filter = EchoFilter();
+    uint8_t sent[3] = {0x99, 0x00, 0xF3};
+    filter.transmitted(sent, 3, PortOutput, 1000);
+    REQUIRE( filter.isEcho(sent, 3, 1000 + ECHO_FILTER_TIMEOUT_MS + 1) == false );
+}
+
+TEST_CASE( "MessageQueue queues whole messages in order" ) {
+    MessageQueue<4, 2> queue;
+    uint8_t first[3] = {0x99, 0x00, 0xF3};
+    REQUIRE( queue.push(first, 3, PortGPS) == true );
+    uint8_t *slot = queue.reserve();
+    REQUIRE( slot != NULL );
+    slot[0] = 0x30;
+    slot[1] = 0x00;
+    slot[2] = 0x0C;
+    REQUIRE( queue.commit(3, PortOutput) == true );
+    // Full, a reserved message is only dropped once it's committed
+    queue.reserve()[0] = 0x52;
+    REQUIRE( queue.dropCount() == 0 );
+    REQUIRE( queue.commit(3, PortOutput) == false );
+    REQUIRE( queue.dropCount() == 1 );
+    REQUIRE( queue.push(first, 3, PortGPS) == false );
+
+    REQUIRE( queue.frontLength() == 3 );
+    REQUIRE( queue.front()[0] == 0x99 );
+    REQUIRE( queue.frontOrigin() == PortGPS );
+    queue.pop();
+    REQUIRE( queue.front()[0] == 0x30 );
+    REQUIRE( queue.frontOrigin() == PortOutput );
+    queue.pop();
+    REQUIRE( queue.isEmpty() );
+}
+
+TEST_CASE( "MessageQueue drop policies" ) {
+    uint8_t first[2] = {0x10, 0x01};
+    uint8_t second[2] = {0x20, 0x02};
+    uint8_t third[2] = {0x10, 0x03};
+
+    MessageQueue<4, 2> dropOldest(MessageQueueDropOldest);
+    dropOldest.push(first, 2, PortGPS);
+    dropOldest.push(second, 2, PortGPS);
+    REQUIRE( dropOldest.push(third, 2, PortGPS) == true );
+    REQUIRE( dropOldest.dropCount() == 1 );
+    REQUIRE( dropOldest.front()[1] == 0x02 );
+
+    // The front has started transmitting, so the message behind it goes instead
+    dropOldest.consumeFront(1);
+    REQUIRE( dropOldest.push(first, 2, PortGPS) == true );
+    REQUIRE( dropOldest.frontOffset() == 1 );
+    REQUIRE( dropOldest.front()[1] == 0x02 );
+    dropOldest.consumeFront(1);
+    REQUIRE( dropOldest.count() == 1 );
+    REQUIRE( dropOldest.front()[1] == 0x01 );
+
+    MessageQueue<4, 2> replace(MessageQueueReplaceSameType);
+    replace.push(first, 2, PortSeaTalk, first[0]);
+    replace.push(second, 2, PortSeaTalk, second[0]);
+    REQUIRE( replace.push(third, 2, PortGPS, third[0]) == true );
+    REQUIRE( replace.count() == 2 );
+    REQUIRE( replace.front()[1] == 0x03 );
+    REQUIRE( replace.frontOrigin() == PortGPS );
+    uint8_t other[2] = {0x30, 0x04};
+    REQUIRE( replace.push(other, 2, PortGPS, other[0]) == false );
+    REQUIRE( replace.dropCount() == 2 );
+}
+
+TEST_CASE( "MessageQueue reserve changes nothing until commit" ) {
+    uint8_t first[2] = {0x10, 0x01};
+    uint8_t second[2] = {0x20, 0x02};
+
+    MessageQueue<4, 2> dropOldest(MessageQueueDropOldest);
+    dropOldest.push(first, 2, PortGPS);
+    dropOldest.push(second, 2, PortGPS);
+    // Reserved and abandoned, like a $STSEA that doesn't decode
+    dropOldest.reserve()[0] = 0x30;
+    REQUIRE( dropOldest.count() == 2 );
+    REQUIRE( dropOldest.dropCount() == 0 );
+    REQUIRE( dropOldest.front()[0] == 0x10 );
+
+    MessageQueue<4, 2> replace(MessageQueueReplaceSameType);
+    replace.push(first, 2, PortSeaTalk, first[0]);
+    replace.push(second, 2, PortSeaTalk, second[0]);
+    uint8_t *slot = replace.reserve();
+    slot[0] = 0x20;
+    slot[1] = 0x05;
+    REQUIRE( replace.commit(2, PortOutput, slot[0]) == true );
+    REQUIRE( replace.count() == 2 );
+    replace.pop();
+    REQUIRE( replace.front()[1] == 0x05 );
+    REQUIRE( replace.frontOrigin() == PortOutput );
+}
+
+TEST_CASE( "MessageQueue never replaces some types" ) {
+    uint8_t plusOne[4] = {0x86, 0x11, 0x07, 0xF8};
+    uint8_t wind[4] = {0x10, 0x01, 0x00, 0x5A};
+    MessageQueue<4, 2> queue(MessageQueueReplaceSameType);
+    queue.setNeverReplacedType(0x86);
+    queue.push(plusOne, 4, PortOutput, plusOne[0]);
+    queue.push(wind, 4, PortSeaTalk, wind[0]);
+    // A second press is dropped rather than merged into the first
+    REQUIRE( queue.push(plusOne, 4, PortOutput, plusOne[0]) == false );
+    REQUIRE( queue.count() == 2 );
+    REQUIRE( queue.dropCount() == 1 );
+    queue.pop();
+    queue.push(plusOne, 4, PortOutput, plusOne[0]);
+    REQUIRE( queue.front()[0] == 0x10 );
+    queue.pop();
+    REQUIRE( queue.front()[0] == 0x86 );
+}
+
+TEST_CASE( "RoutingTable dispatches the default routes" ) {
+    RoutingTable table = RoutingTable();
+    const RouteDispatch *dispatch = table.dispatch(PortGPS, nmeaMessageType("$GPRMC"));
+    REQUIRE( dispatch->actionCount == 2 );
+    REQUIRE( dispatch->actions[0].transform == RouteTransformNone );
+    REQUIRE( dispatch->actions[0].destinations == (PORT_MASK(PortOutput) | PORT_MASK(PortNMEAHighSpeed)) );
+    REQUIRE( dispatch->actions[1].transform == RouteTransformRMCToSeaTalk );
+
+    dispatch = table.dispatch(PortGPS, nmeaMessageType("$GPGSV"));
+    REQUIRE( dispatch->actionCount == 1 );
+    REQUIRE( dispatch->actions[0].transform == RouteTransformNone );
+
+    dispatch = table.dispatch(PortSeaTalk, 0x9C);
+    REQUIRE( dispatch->actionCount == 2 );
+    REQUIRE( dispatch->actions[1].transform == RouteTransformHeadingToHDM );
+
+    // Nothing but commands comes from the computer unless a route asks for it
+    dispatch = table.dispatch(PortOutput, nmeaMessageType("$GPGGA"));
+    REQUIRE( dispatch->actionCount == 0 );
+    REQUIRE( table.isSourceUsed(PortNMEA) == false );
+    REQUIRE( (table.transformsInUse() & (1 << RouteTransformRMCToSeaTalk)) != 0 );
+}
+
+TEST_CASE( "RoutingTable merges routes sharing a transform and honors exclusions" ) {
+    RoutingTable table = RoutingTable();
+    table.clear();
+    table.addRoute(PortGPS, RouteFilterAll, 0, RouteTransformNone, PORT_MASK(PortOutput));
+    table.addRoute(PortGPS, RouteFilterAllExcept, nmeaMessageType("$GPGSV"), RouteTransformNone, PORT_MASK(PortNMEA));
+    const RouteDispatch *dispatch = table.dispatch(PortGPS, nmeaMessageType("$GPRMC"));
+    REQUIRE( dispatch->actionCount == 1 );
+    REQUIRE( dispatch->actions[0].destinations == (PORT_MASK(PortOutput) | PORT_MASK(PortNMEA)) );
+    dispatch = table.dispatch(PortGPS, nmeaMessageType("$GPGSV"));
+    REQUIRE( dispatch->actions[0].destinations == PORT_MASK(PortOutput) );
+    // SeaTalk can't be forwarded to NMEA ports untouched
+    REQUIRE( table.addRoute(PortSeaTalk, RouteFilterAll, 0, RouteTransformNone, PORT_MASK(PortOutput)) == -1 );
+}
+
+TEST_CASE( "RoutingTable applies route commands" ) {
+    RoutingTable table = RoutingTable();
+    table.clear();
+    REQUIRE( table.applyCommand("$PHLM,ROUTE,ADD,SEATALK,9C,HEADINGTOHDM,OUTPUT+NMEA*00\r\n") == true );
+    REQUIRE( table.applyCommand("$PHLM,ROUTE,ADD,GPS,!GSV,NONE,NMEA*00\r\n") == true );
+    REQUIRE( table.applyCommand("$PHLM,ROUTE,ADD,GPS,RMC,BOGUS,NMEA*00\r\n") == false );
+    REQUIRE( table.routeCount() == 2 );
+    const RouteDispatch *dispatch = table.dispatch(PortSeaTalk, 0x9C);
+    REQUIRE( dispatch->actionCount == 1 );
+    REQUIRE( dispatch->actions[0].destinations == (PORT_MASK(PortOutput) | PORT_MASK(PortNMEA)) );
+
+    char description[100];
+    table.describeRoute(1, description, sizeof(description));
+    REQUIRE( std::string(description).substr(0, 34) == std::string("$PHLM,ROUTE,1,GPS,!GSV,NONE,NMEA,1") );
+
+    REQUIRE( table.applyCommand("$PHLM,ROUTE,OFF,0*00\r\n") == true );
+    REQUIRE( table.dispatch(PortSeaTalk, 0x9C)->actionCount == 0 );
+    REQUIRE( table.applyCommand("$PHLM,ROUTE,DEL,0*00\r\n") == true );
+    REQUIRE( table.routeCount() == 1 );
+}
+
+static_assert(ROUTE_MAX_ACTIONS < 6, "make test sets ROUTE_MAX_ACTIONS below the 6 NMEA transforms so a dispatch can be filled");
+
+TEST_CASE( "RoutingTable rejects a route that overflows a dispatch" ) {
+    RouteTransform transforms[6] = {RouteTransformNone, RouteTransformRMCToSeaTalk, RouteTransformRMBToSeaTalk, RouteTransformAPBToSeaTalk, RouteTransformRMCToVariation, RouteTransformSEAToSeaTalk};
+    RoutingTable table = RoutingTable();
+    table.clear();
+    for (int i = 0; i < ROUTE_MAX_ACTIONS; i++) {
+        REQUIRE( table.addRoute(PortGPS, RouteFilterType, NMEA_TYPE('R', 'M', 'C'), transforms[i], PORT_MASK(PortOutput) | PORT_MASK(PortSeaTalk)) == i );
+    }
+    // Everything from GPS matches RMC too, so that dispatch is already full
+    REQUIRE( table.applyCommand("$PHLM,ROUTE,ADD,GPS,*,SEATOSEATALK,SEATALK*00\r\n") == false );
+    REQUIRE( table.routeCount() == ROUTE_MAX_ACTIONS );
+    REQUIRE( table.dispatch(PortGPS, NMEA_TYPE('R', 'M', 'C'))->actionCount == ROUTE_MAX_ACTIONS );
+    REQUIRE( table.compile() == true );
+
+    // Re-enabling a route that no longer fits is refused as well
+    REQUIRE( table.setRouteEnabled(0, false) == true );
+    REQUIRE( table.addRoute(PortGPS, RouteFilterAll, 0, RouteTransformSEAToSeaTalk, PORT_MASK(PortSeaTalk)) == ROUTE_MAX_ACTIONS );
+    REQUIRE( table.setRouteEnabled(0, true) == false );
+    REQUIRE( table.route(0)->enabled == false );
+}
+
+//! Wires a MockSerial to a Router port
+class MockPort
+{
+public:
+    MockPort(Router &router, Port port, uint32_t baud, uint32_t format = SERIAL_8N1) : adapter(serial) {
+        serial.begin(baud, format);
+        router.setPort(port, &adapter);
+    }
+    std::string sentString() {
+        std::vector<uint16_t> sent = serial.takeSent();
+        return std::string(sent.begin(), sent.end());
+    }
+    MockSerial serial;
+    SerialPortErrorCountingAdapter<MockSerial> adapter;
+};
+
+class MockSeaTalkPort
+{
+public:
+    MockSeaTalkPort(Router &router) : adapter(serial) {
+        serial.begin(4800, SERIAL_9N1_RXINV_TXINV);
+        router.setPort(PortSeaTalk, &adapter);
+    }
+    MockSerial serial;
+    SerialPort9BitAdapter<MockSerial> adapter;
+};
+
+//! Polls the router every 100us of simulated time
+void runRouter(Router &router, uint32_t micros) {
+    for (uint32_t elapsed = 0; elapsed < micros; elapsed += 100) {
+        mockAdvanceMicros(100);
+        router.poll(millis());
+    }
+}
+
+TEST_CASE( "Router routes GPS sentences to the computer and SeaTalk" ) {
+    Router router = Router();
+    MockPort output(router, PortOutput, 0);
+    MockPort nmeaHighSpeed(router, PortNMEAHighSpeed, 38400);
+    MockSeaTalkPort seaTalk(router);
+    MockPort gps(router, PortGPS, 9600);
+
+    const char *rmc = "$GPRMC,045430.00,A,3751.98405,N,12218.96980,W,0.078,,041114,,,D*69\r\n";
+    gps.serial.inject(rmc);
+    REQUIRE( router.poll(millis()) == false );
+    runRouter(router, 200000);
+    REQUIRE( output.sentString() == std::string(rmc) );
+    REQUIRE( nmeaHighSpeed.sentString() == std::string(rmc) );
+    // Latitude, longitude, speed, course and time, each starting with a command byte
+    std::vector<uint16_t> seaTalkSent = seaTalk.serial.takeSent();
+    int commandCount = 0;
+    for (size_t i = 0; i < seaTalkSent.size(); i++) {
+        commandCount += seaTalkSent[i] >> 8;
+    }
+    REQUIRE( commandCount == 5 );
+    REQUIRE( seaTalkSent[0] == 0x151 );
+}
+
+TEST_CASE( "Router forwards GPS at line rate with bounded latency" ) {
+    Router router = Router();
+    MockPort output(router, PortOutput, 0);
+    MockPort gps(router, PortGPS, 9600);
+
+    const char *rmc = "$GPRMC,045431.00,A,3751.98405,N,12218.96980,W,0.078,,041114,,,D*68\r\n";
+    uint32_t start = micros();
+    for (int i = 0; i < 10; i++) {
+        gps.serial.inject(rmc);
+    }
+    uint32_t lastByteArrives = start + 10 * strlen(rmc) * gps.serial.characterMicros();
+    // Sentences are complete at the checksum, before the CR LF arrives
+    uint32_t lastChecksumArrives = lastByteArrives - 2 * gps.serial.characterMicros();
+    runRouter(router, lastByteArrives - start + 10000);
+    REQUIRE( output.sentString().size() == 10 * strlen(rmc) );
+    REQUIRE( gps.serial.overflowCount() == 0 );
+    // The last sentence leaves within a couple of polls of its last byte arriving
+    uint32_t latency = output.serial.sentTimes().back() - lastChecksumArrives;
+    REQUIRE( latency < 1000 );
+}
+
+TEST_CASE( "Router translates SeaTalk and ignores its own echoes" ) {
+    Router router = Router();
+    MockPort output(router, PortOutput, 0);
+    MockSeaTalkPort seaTalk(router);
+
+    uint16_t heading[4] = {0x19C, 0x01, 0x00, 0x00};
+    for (int i = 0; i < 4; i++) {
+        seaTalk.serial.inject9bit(heading[i]);
+    }
+    runRouter(router, 10000);
+    std::string sent = output.sentString();
+    REQUIRE( sent.find("$STSEA,9C01") != std::string::npos );
+    REQUIRE( sent.find("HDM") != std::string::npos );
+
+    // The computer sends a datagram, which comes right back to us off the bus
+    output.serial.inject("$STSEA,9C010000*07\r\n");
+    runRouter(router, 10000);
+    std::vector<uint16_t> seaTalkSent = seaTalk.serial.takeSent();
+    REQUIRE( seaTalkSent.size() == 4 );
+    REQUIRE( seaTalkSent[0] == 0x19C );
+    for (size_t i = 0; i < seaTalkSent.size(); i++) {
+        seaTalk.serial.inject9bit(seaTalkSent[i]);
+    }
+    runRouter(router, 10000);
+    REQUIRE( output.sentString().empty() );
+    REQUIRE( router.seaTalkEchoFilter()->echoCount() == 1 );
+    REQUIRE( router.seaTalkEchoFilter()->echoCount(PortOutput) == 1 );
+    output.serial.inject("$PHLM,STATS*74\r\n");
+    runRouter(router, 10000);
+    REQUIRE( output.sentString().find("$PHLM,STATS,ECHOES,1,0,0,0,0*") != std::string::npos );
+}
+
+TEST_CASE( "Router answers commands from the computer" ) {
+    Router router = Router();
+    MockPort output(router, PortOutput, 0);
+    output.serial.inject("$PHLM,STATS*74\r\n");
+    router.poll(millis());
+    std::string sent = output.sentString();
+    REQUIRE( sent.substr(0, 20) == std::string("$PHLM,STATS,TXDROPS,") );
+    REQUIRE( sent.find("$PHLM,STATS,STACK,") != std::string::npos );
+}
+
+TEST_CASE( "Router reports serial errors in its stats" ) {
+    Router router = Router();
+    MockPort output(router, PortOutput, 0);
+    MockPort nmea(router, PortNMEA, 4800);
+    nmea.serial.setBufferSizes(16, 64);
+    // Nothing reads the port while the sentence arrives, so all but 16 characters are lost
+    uint32_t lastByteArrives = nmea.serial.inject("$IIMWV,214.8,R,0.1,K,A*28\r\n");
+    mockAdvanceMicros(lastByteArrives - micros());
+    output.serial.inject("$PHLM,STATS*74\r\n");
+    runRouter(router, 10000);
+    std::string sent = output.sentString();
+    REQUIRE( sent.find("$PHLM,STATS,ERRORS,OUTPUT,0,0,0*") != std::string::npos );
+    REQUIRE( sent.find("$PHLM,STATS,ERRORS,NMEA,0,11,0*") != std::string::npos );
+    REQUIRE( sent.find("$PHLM,STATS,ERRORS,GPS,") == std::string::npos );
+}
+
+TEST_CASE( "Router replies to a route it can't add" ) {
+    Router router = Router();
+    MockPort output(router, PortOutput, 0);
+    // RMC from the GPS already goes out untouched and to SeaTalk, these two fill its dispatch
+    output.serial.inject("$PHLM,ROUTE,ADD,GPS,RMC,RMBTOSEATALK,SEATALK*5F\r\n");
+    runRouter(router, 10000);
+    output.serial.inject("$PHLM,ROUTE,ADD,GPS,RMC,APBTOSEATALK,SEATALK*51\r\n");
+    runRouter(router, 10000);
+    REQUIRE( output.sentString() == "" );
+    int routeCount = router.routingTable()->routeCount();
+    output.serial.inject("$PHLM,ROUTE,ADD,GPS,RMC,RMCVARIATION,SEATALK*51\r\n");
+    runRouter(router, 10000);
+    REQUIRE( output.sentString().find("ERROR: Route rejected: $PHLM,ROUTE,ADD,GPS,RMC,RMCVARIATION,SEATALK*51") == 0 );
+    REQUIRE( router.routingTable()->routeCount() == routeCount );
+}
+
+TEST_CASE( "Router reports SeaTalk bus health in its stats" ) {
+    Router router = Router();
+    MockPort output(router, PortOutput, 0);
+    MockSeaTalkPort seaTalk(router);
+    // Bad redundancy bytes, a datagram cut short by the next one, and two bytes after it with no command byte
+    uint16_t datagrams[16] = {0x182, 0x05, 0x00, 0xFF, 0x00, 0xFE, 0x04, 0xFB, 0x100, 0x02, 0x00, 0x199, 0x00, 0xF3, 0x05, 0x06};
+    for (int i = 0; i < 16; i++) {
+        seaTalk.serial.inject9bit(datagrams[i]);
+    }
+    runRouter(router, 50000);
+    output.sentString();
+    output.serial.inject("$PHLM,STATS*74\r\n");
+    runRouter(router, 10000);
+    std::string sent = output.sentString();
+    REQUIRE( sent.find("$PHLM,STATS,SEATALK,1,1,2*") != std::string::npos );
+}
+
+TEST_CASE( "Router samples each port's RX buffer" ) {
+    Router router = Router();
+    MockPort output(router, PortOutput, 0);
+    MockPort gps(router, PortGPS, 9600);
+    const char *rmc = "$GPRMC,045430.00,A,3751.98405,N,12218.96980,W,0.078,,041114,,,D*69\r\n";
+    // Read as it arrives, a few bytes at a time
+    runRouter(router, gps.serial.inject(rmc) - micros() + 1000);
+    const RouterPortStats *stats = router.portStats(PortGPS);
+    REQUIRE( stats->bytesRead == strlen(rmc) );
+    REQUIRE( stats->highWater > 0 );
+    REQUIRE( stats->highWater < 8 );
+    REQUIRE( stats->fullPasses == 0 );
+
+    // Nothing reads while three arrive, the 64 byte buffer fills
+    uint32_t lastByteArrives = 0;
+    for (int i = 0; i < 3; i++) {
+        lastByteArrives = gps.serial.inject(rmc);
+    }
+    mockAdvanceMicros(lastByteArrives - micros());
+    output.serial.inject("$PHLM,STATS*74\r\n");
+    runRouter(router, 10000);
+    REQUIRE( stats->highWater == 64 );
+    REQUIRE( stats->fullPasses == 1 );
+    REQUIRE( stats->bytesRead == strlen(rmc) + 64 );
+    std::string sent = output.sentString();
+    REQUIRE( sent.find("$PHLM,STATS,RX,GPS,132,64,1*") != std::string::npos );
+}
+
+TEST_CASE( "Router drains and counts a full RX buffer by its size" ) {
+    Router router = Router();
+    MockPort nmea(router, PortNMEA, 4800);
+    // Half the AltSoftSerial buffer the build sets
+    int size = mockRxBufferSizes[PortNMEA] / 2;
+    nmea.serial.setBufferSizes(size, mockTxBufferSizes[PortNMEA]);
+    router.setRxBufferSize(PortNMEA, size);
+
+    const char *rmc = "$GPRMC,045430.00,A,3751.98405,N,12218.96980,W,0.078,,041114,,,D*69\r\n";
+    mockAdvanceMicros(nmea.serial.inject(rmc) - micros());
+    router.poll(millis());
+    const RouterPortStats *stats = router.portStats(PortNMEA);
+    REQUIRE( stats->highWater == size );
+    REQUIRE( stats->fullPasses == 1 );
+    // Full is more than half full, so it's all read in one pass instead of the port's usual budget
+    REQUIRE( stats->bytesRead == (uint32_t)size );
+    router.poll(millis());
+    REQUIRE( stats->fullPasses == 1 );
+}
+
+// End to end latency budgets, from the first byte arriving to the last byte of the translation on the wire
+// 9 byte datagram at 4800 baud, 11 bits a character, is 20.6ms on the wire. The sentence arrives instantly over USB.
+#define LATENCY_BUDGET_RMB_TO_SEATALK_MICROS 25000
+// The rest of the 4 byte datagram, 6.9ms, then USB
+#define LATENCY_BUDGET_WIND_TO_MWV_MICROS 8000
+
+TEST_CASE( "Router latency stays within budget" ) {
+    Router router = Router();
+    MockPort output(router, PortOutput, 0);
+    MockSeaTalkPort seaTalk(router);
+    // USB has flow control, the sentence doesn't fit in the default RX buffer
+    output.serial.setBufferSizes(1024, 64);
+
+    for (int i = 0; i < 10; i++) {
+        output.serial.inject("$GPRMB,A,0.66,L,003,004,4917.24,N,12309.57,W,001.3,052.5,000.5,V*20\r\n");
+        uint16_t windAngle[4] = {0x110, 0x01, 0x00, 0x5A};
+        for (int j = 0; j < 4; j++) {
+            seaTalk.serial.inject9bit(windAngle[j]);
+        }
+        runRouter(router, 100000);
+        seaTalk.serial.takeSent();
+    }
+    LatencyHistogram *rmb = router.latencyProbe(RouterLatencyRMBToSeaTalk)->histogram();
+    REQUIRE( rmb->count() == 10 );
+    REQUIRE( rmb->max() > 20000 );
+    REQUIRE( rmb->max() < LATENCY_BUDGET_RMB_TO_SEATALK_MICROS );
+    LatencyHistogram *wind = router.latencyProbe(RouterLatencyWindToMWV)->histogram();
+    REQUIRE( wind->count() == 10 );
+    REQUIRE( wind->max() < LATENCY_BUDGET_WIND_TO_MWV_MICROS );
+
+    output.sentString();
+    output.serial.inject("$PHLM,LATENCY*7D\r\n");
+    runRouter(router, 1000);
+    REQUIRE( output.sentString().find("$PHLM,LATENCY,RMB>SEATALK,10,") != std::string::npos );
+}
+
+#ifndef HELM_TRACE
+#error "make test builds with HELM_TRACE so the trace dump tests have events to dump"
+#endif
+
+TEST_CASE( "traceDumpSentence writes recorded events oldest first" ) {
+    TraceEntry entries[2] = {
+        {0x12345678, TraceEventRoute, TracePhaseBegin, PortGPS},
+        {0x1234567A, TraceEventRoute, TracePhaseEnd, PortGPS}
+    };
+    traceRing[0] = entries[0];
+    traceRing[1] = entries[1];
+    traceCount = 2;
+    char sentence[NMEA_MESSAGE_MAX_LENGTH];
+    uint32_t offset = 0;
+    REQUIRE( traceDumpSentence(&offset, sentence, sizeof(sentence)) );
+    REQUIRE( std::string(sentence) == "$PHLM,TRACE,BEGIN,2,1000" );
+    // Recording is paused during the dump
+    TRACE_BEGIN(TraceEventWrite, PortOutput);
+    REQUIRE( traceDumpSentence(&offset, sentence, sizeof(sentence)) );
+    REQUIRE( std::string(sentence) == "$PHLM,TRACE,1234567803041234567A0314" );
+    REQUIRE( traceDumpSentence(&offset, sentence, sizeof(sentence)) );
+    REQUIRE( std::string(sentence) == "$PHLM,TRACE,END" );
+    REQUIRE( traceDumpSentence(&offset, sentence, sizeof(sentence)) == false );
+    REQUIRE( traceCount == 0 );
+}
+
+TEST_CASE( "Router dumps the trace ring" ) {
+    Router router = Router();
+    MockPort output(router, PortOutput, 0);
+    MockPort gps(router, PortGPS, 9600);
+    runRouter(router, gps.serial.inject("$GPGLL,3751.98405,N,12218.96980,W,045430.00,A,D*7E\r\n") - micros() + 1000);
+    output.sentString();
+    output.serial.inject("$PHLM,TRACE*74\r\n");
+    runRouter(router, 100000);
+    std::string sent = output.sentString();
+    REQUIRE( sent.find("$PHLM,TRACE,BEGIN,") == 0 );
+    REQUIRE( sent.find("$PHLM,TRACE,BEGIN,0,") == std::string::npos );
+    REQUIRE( sent.find("$PHLM,TRACE,END*") != std::string::npos );
+    // Routing the GLL from the GPS began somewhere in the dump, a ROUTE event with GPS as its arg
+    char routeBegin[5];
+    snprintf(routeBegin, sizeof(routeBegin), "%02X%X%X", TraceEventRoute, TracePhaseBegin, PortGPS);
+    bool found = false;
+    // Past BEGIN, END is too short to hold an event
+    for (size_t start = sent.find("$PHLM,TRACE,", 1); start != std::string::npos && !found; start = sent.find("$PHLM,TRACE,", start + 1)) {
+        size_t end = sent.find('*', start);
+        std::string events = sent.substr(start + 12, end - start - 12);
+        for (size_t i = 0; i + 12 <= events.size(); i += 12) {
+            if (events.substr(i + 8, 4) == routeBegin) {
+                found = true;
+            }
+        }
+    }
+    REQUIRE( found );
+}
+
+TEST_CASE( "Hot paths stay within their allocation budgets" ) {
+    const char *rmc = "$GPRMC,045430.00,A,3751.98405,N,12218.96980,W,0.078,,041114,,,D*69";
+    NMEAFragment fragments[20];
+    int fragmentCount;
+    REQUIRE_ALLOCATIONS_AT_MOST(0, 0, splitMessageIntoFragments(rmc, strlen(rmc), fragments, 20, &fragmentCount));
+    REQUIRE_ALLOCATIONS_AT_MOST(0, 0, NMEAMessageRMC message(rmc));
+    REQUIRE_ALLOCATIONS_AT_MOST(0, 0, NMEAMessageRMB message("$ECRMB,A,0.000,L,tospace,001,3751.944,N,12219.721,W,0.596,266.197,0.055,V*48"));
+    REQUIRE_ALLOCATIONS_AT_MOST(0, 0, NMEAMessageAPB message("$ECAPB,A,A,2.345,L,N,V,V,266.243,T,001,266.197,T,266.197,T*35"));
+    uint8_t heading[4] = {0x9C, 0x01, 0x00, 0x00};
+    REQUIRE_ALLOCATIONS_AT_MOST(1, sizeof(SeaTalkMessageCompassHeadingAutopilotCourseRudderPosition), delete newSeaTalkMessage(heading, 4));
+    REQUIRE_NO_LEAKS(delete newSeaTalkMessage(heading, 4));
+
+    // Routing doesn't hold on to anything once the messages are out. The mock serial ports keep what they allocate
+    // for their buffers, so that has settled down before counting.
+    Router router = Router();
+    MockPort output(router, PortOutput, 0);
+    MockSeaTalkPort seaTalk(router);
+    MockPort gps(router, PortGPS, 9600);
+    for (int round = 0; round < 3; round++) {
+        AllocationScope routing;
+        gps.serial.inject("$GPRMC,045430.00,A,3751.98405,N,12218.96980,W,0.078,,041114,,,D*69\r\n");
+        for (int i = 0; i < 4; i++) {
+            seaTalk.serial.inject9bit(heading[i] | (i ? 0 : 0x100));
+        }
+        runRouter(router, 200000);
+        output.sentString();
+        seaTalk.serial.takeSent();
+        AllocationStats allocations = routing.stats();
+        if (round == 2) {
+            REQUIRE( allocations.count > 0 );
+            REQUIRE( allocations.frees == allocations.count );
+        }
+    }
+}
+
+// Host stack used routing a bit of everything, from the caller of stackPaint(). gcc uses about 5K at -O0 and -O2.
+#define STACK_BUDGET_ROUTER_HOST_BYTES 8192
+
+TEST_CASE( "Router stays within its stack budget" ) {
+    Router router = Router();
+    MockPort output(router, PortOutput, 0);
+    MockSeaTalkPort seaTalk(router);
+    MockPort gps(router, PortGPS, 9600);
+    output.serial.setBufferSizes(1024, 64);
+
+    stackPaint();
+    REQUIRE( stackHighWater() < 1024 );
+    gps.serial.inject("$GPRMC,045430.00,A,3751.98405,N,12218.96980,W,0.078,,041114,,,D*69\r\n");
+    output.serial.inject("$GPRMB,A,0.66,L,003,004,4917.24,N,12309.57,W,001.3,052.5,000.5,V*20\r\n");
+    output.serial.inject("$ECAPB,A,A,2.345,L,N,V,V,266.243,T,001,266.197,T,266.197,T*35\r\n");
+    uint16_t windAngle[4] = {0x110, 0x01, 0x00, 0x5A};
+    for (int i = 0; i < 4; i++) {
+        seaTalk.serial.inject9bit(windAngle[i]);
+    }
+    runRouter(router, 200000);
+    REQUIRE( stackPaintedSize() > STACK_PAINT_HOST_SIZE );
+    INFO( "Stack high water " << stackHighWater() );
+    REQUIRE( stackHighWater() > 1024 );
+    REQUIRE( stackHighWater() < STACK_BUDGET_ROUTER_HOST_BYTES );
+}
+
+TEST_CASE( "Memory budget adds up" ) {
+    uint32_t total = 0;
+    uint32_t routerParts = 0;
+    for (int i = 0; i < memoryBudgetEntryCount; i++) {
+        if (memoryBudgetEntries[i].isRouterPart) {
+            routerParts += memoryBudgetEntries[i].bytes;
+        } else {
+            total += memoryBudgetEntries[i].bytes;
+        }
+    }
+    REQUIRE( memoryBudgetEntries[0].bytes == sizeof(Router) );
+    REQUIRE( total == MEMORY_BUDGET_TOTAL_BYTES );
+    REQUIRE( routerParts <= sizeof(Router) );
+    REQUIRE( total <= MEMORY_BUDGET_CEILING_BYTES );
+}
+
+TEST_CASE( "Router streams a capture to the computer" ) {
+    Router router = Router();
+    MockPort output(router, PortOutput, 0);
+    MockPort gps(router, PortGPS, 9600);
+
+    output.serial.inject("$PHLM,CAPTURE,ON*5C\r\n");
+    runRouter(router, 1000);
+    REQUIRE( router.captureMode() == RouterCaptureOn );
+    const char *rmc = "$GPRMC,045430.00,A,3751.98405,N,12218.96980,W,0.078,,041114,,,D*69\r\n";
+    gps.serial.inject(rmc);
+    runRouter(router, 100000);
+    output.serial.inject("$PHLM,CAPTURE,OFF*12\r\n");
+    runRouter(router, 1000);
+    REQUIRE( router.captureMode() == RouterCaptureOff );
+
+    // The GPS sentence comes in and goes out to the computer, inside the capture
+    std::vector<uint16_t> sent = output.serial.takeSent();
+    std::vector<uint8_t> stream(sent.begin(), sent.end());
+    CaptureReader reader(&stream[0], stream.size());
+    REQUIRE( reader.isValid() );
+    std::string read, written;
+    CaptureRecord record;
+    while (reader.next(&record)) {
+        if (record.port == PortGPS && record.direction == CaptureDirectionRead) {
+            read.append((const char *)record.data, record.length);
+        }
+        if (record.port == PortOutput && record.direction == CaptureDirectionWrite) {
+            written.append((const char *)record.data, record.length);
+        }
+    }
+    REQUIRE( read == std::string(rmc) );
+    REQUIRE( written == std::string(rmc) );
+    // After the end record the usual output resumes
+    std::string text(stream.begin(), stream.end());
+    REQUIRE( text.substr(text.size() - 25) == std::string("$PHLM,CAPTURE,LOST,0*45\r\n") );
+}
+
+TEST_CASE( "Capture records round trip" ) {
+    uint8_t buffer[64];
+    CaptureWriter writer(buffer, sizeof(buffer));
+    const uint8_t sentence[] = "$GPRMC";
+    const uint8_t datagram[] = {0x9C, 0x01, 0x00, 0x00};
+    REQUIRE( writer.write(1000, PortGPS, CaptureDirectionRead, false, sentence, 6) );
+    REQUIRE( writer.write(1000 + 300000, PortSeaTalk, CaptureDirectionWrite, true, datagram, 4) );
+    // 4 byte header, 4 byte record header + 6, 5 byte record header + 4
+    REQUIRE( writer.length() == 23 );
+    uint8_t big[60] = {0};
+    REQUIRE( writer.write(400000, PortOutput, CaptureDirectionRead, false, big, sizeof(big)) == false );
+    REQUIRE( writer.droppedCount() == 1 );
+
+    CaptureReader reader(writer.data(), writer.length());
+    REQUIRE( reader.isValid() );
+    CaptureRecord record;
+    REQUIRE( reader.next(&record) );
+    REQUIRE( record.time == 1000 );
+    REQUIRE( record.port == PortGPS );
+    REQUIRE( record.direction == CaptureDirectionRead );
+    REQUIRE( record.length == 6 );
+    REQUIRE( memcmp(record.data, sentence, 6) == 0 );
+    REQUIRE( reader.next(&record) );
+    REQUIRE( record.time == 301000 );
+    REQUIRE( record.port == PortSeaTalk );
+    REQUIRE( record.direction == CaptureDirectionWrite );
+    REQUIRE( record.command == true );
+    REQUIRE( record.data[0] == 0x9C );
+    REQUIRE( reader.next(&record) == false );
+
+    // Truncated captures end cleanly
+    CaptureReader truncated(writer.data(), writer.length() - 1);
+    REQUIRE( truncated.next(&record) );
+    REQUIRE( truncated.next(&record) == false );
+}
+
+TEST_CASE( "CaptureSerialPort records what passes through it" ) {
+    uint8_t buffer[128];
+    CaptureWriter writer(buffer, sizeof(buffer));
+    MockSerial serial;
+    serial.begin(0, SERIAL_9N1);
+    SerialPort9BitAdapter<MockSerial> adapter(serial);
+    CaptureSerialPort port(&adapter, PortSeaTalk, &writer);
+
+    uint16_t datagrams[8] = {0x19C, 0x01, 0x00, 0x00, 0x110, 0x01, 0x00, 0x20};
+    for (int i = 0; i < 8; i++) {
+        serial.inject9bit(datagrams[i]);
+    }
+    while (port.available()) {
+        port.read();
+    }
+    port.write9bit(0x186);
+    const uint8_t rest[3] = {0x11, 0x01, 0xFE};
+    port.write(rest, 3);
+    port.flush();
+
+    CaptureReader reader(writer.data(), writer.length());
+    CaptureRecord record;
+    // A new record at every command byte
+    REQUIRE( reader.next(&record) );
+    REQUIRE( record.command == true );
+    REQUIRE( record.length == 4 );
+    REQUIRE( record.data[0] == 0x9C );
+    REQUIRE( reader.next(&record) );
+    REQUIRE( record.data[0] == 0x10 );
+    REQUIRE( reader.next(&record) );
+    REQUIRE( record.direction == CaptureDirectionWrite );
+    REQUIRE( record.command == true );
+    REQUIRE( record.length == 4 );
+    REQUIRE( record.data[3] == 0xFE );
+    REQUIRE( reader.next(&record) == false );
+    REQUIRE( serial.takeSent().size() == 4 );
+}
+
+static const std::string ALTSS_TEST_SENTENCE = "$IIVHW,,T,,M,06.12,N,11.33,K*50\r\n";
+// ASCII ends in a 0 data bit, so the edge into the stop bit ends each character. These rely on the RX timeout instead.
+static const std::string ALTSS_TEST_HIGH_BYTES = "\xC1\xFF\x80\xA5\xC1\xFF\x80\xA5\xC1\xFF\x80\xA5";
+
+//! Sends and receives payload, reading every readMicros like loop() would. Returns whether both came through intact.
+static bool altSoftSerialRoundTrip(AltSoftSerialHarness &harness, uint32_t baud, const std::string &payload, double readMicros = 1000) {
+    AltSoftSerial serial;
+    serial.begin(baud);
+    std::string received;
+    double lastByteArrives = harness.inject((const uint8_t *)payload.data(), payload.size(), baud);
+    serial.write((const uint8_t *)payload.data(), payload.size());
+    while (harness.micros() < lastByteArrives + 10000) {
+        harness.run(readMicros);
+        while (serial.available()) {
+            received += (char)serial.read();
+        }
+    }
+    std::vector<uint8_t> sent = harness.takeSent(baud);
+    return received == payload && std::string(sent.begin(), sent.end()) == payload;
+}
+
+TEST_CASE( "AltSoftSerial sends and receives at 4800 and 9600 baud" ) {
+    uint32_t bauds[2] = {4800, 9600};
+    for (int i = 0; i < 2; i++) {
+        INFO( "Baud " << bauds[i] );
+        AltSoftSerialHarness harness;
+        harness.setEdgeJitter(2);
+        harness.setInterruptLatency(0, 20);
+        REQUIRE( altSoftSerialRoundTrip(harness, bauds[i], ALTSS_TEST_SENTENCE) );
+        REQUIRE( altSoftSerialRoundTrip(harness, bauds[i], ALTSS_TEST_HIGH_BYTES) );
+        REQUIRE( AltSoftSerial::latencyOverrunCount() == 0 );
+        REQUIRE( AltSoftSerial::overflowCount() == 0 );
+        REQUIRE( AltSoftSerial::framingErrorCount() == 0 );
+        REQUIRE( harness.sentFramingErrors() == 0 );
+    }
+}
+
+TEST_CASE( "AltSoftSerial copes with interrupt latency up to half a bit" ) {
+    // A bit is 208us at 4800 baud and 104us at 9600
+    uint32_t bauds[2] = {4800, 9600};
+    for (int i = 0; i < 2; i++) {
+        INFO( "Baud " << bauds[i] );
+        double bitMicros = 1000000.0 / bauds[i];
+        AltSoftSerialHarness harness;
+        harness.setEdgeJitter(2);
+        harness.setInterruptLatency(bitMicros / 4, bitMicros / 2);
+        REQUIRE( altSoftSerialRoundTrip(harness, bauds[i], ALTSS_TEST_SENTENCE) );
+        REQUIRE( altSoftSerialRoundTrip(harness, bauds[i], ALTSS_TEST_HIGH_BYTES) );
+        REQUIRE( AltSoftSerial::latencyOverrunCount() == 0 );
+    }
+}
+
+TEST_CASE( "AltSoftSerial counts interrupts that run too late" ) {
+    // TX has to set up each edge within a bit of the last one
+    AltSoftSerialHarness harness;
+    harness.setInterruptLatency(100, 180);
+    REQUIRE_FALSE( altSoftSerialRoundTrip(harness, 9600, ALTSS_TEST_SENTENCE) );
+    REQUIRE( AltSoftSerial::latencyOverrunCount() > 0 );
+    REQUIRE( AltSoftSerial::timing_error );
+
+    // The RX timeout fires a quarter bit before the stop bit ends. Any later than that and the next start bit is lost.
+    harness.setInterruptLatency(170, 200);
+    AltSoftSerial serial;
+    serial.begin(4800);
+    harness.run(harness.inject((const uint8_t *)ALTSS_TEST_HIGH_BYTES.data(), ALTSS_TEST_HIGH_BYTES.size(), 4800) - harness.micros() + 1000);
+    REQUIRE( serial.available() < (int)ALTSS_TEST_HIGH_BYTES.size() );
+    REQUIRE( AltSoftSerial::latencyOverrunCount() > 0 );
+}
+
+TEST_CASE( "AltSoftSerial counts RX overflows and framing errors" ) {
+    AltSoftSerialHarness harness;
+    AltSoftSerial serial;
+    serial.begin(4800);
+    // Nobody reads while 100 characters arrive, one slot of the ring is always empty
+    uint8_t characters[100];
+    memset(characters, 'A', sizeof(characters));
+    harness.run(harness.inject(characters, sizeof(characters), 4800) - harness.micros() + 1000);
+    REQUIRE( serial.available() == ALTSS_RX_BUFFER_SIZE - 1 );
+    REQUIRE( AltSoftSerial::overflowCount() == sizeof(characters) - (ALTSS_RX_BUFFER_SIZE - 1) );
+    REQUIRE( AltSoftSerial::framingErrorCount() == 0 );
+    serial.flushInput();
+
+    // Whether the last data bit is high or low, the stop bit going low is caught
+    uint8_t lastBitLow = 'A';
+    uint8_t lastBitHigh = 0xC1;
+    harness.inject(&lastBitLow, 1, 4800, true);
+    harness.run(harness.inject(&lastBitHigh, 1, 4800, true) - harness.micros() + 1000);
+    REQUIRE( AltSoftSerial::framingErrorCount() == 2 );
+    REQUIRE( serial.read() == 'A' );
+    REQUIRE( serial.read() == 0xC1 );
+    REQUIRE( AltSoftSerial::latencyOverrunCount() == 0 );
+}
+
+TEST_CASE( "AltSoftSerial tryWrite takes what fits and never waits" ) {
+    AltSoftSerialHarness harness;
+    AltSoftSerial serial;
+    serial.begin(4800);
+    uint8_t characters[200];
+    for (size_t i = 0; i < sizeof(characters); i++) {
+        characters[i] = i;
+    }
+    // One goes straight to the shift register, and one slot of the ring is always empty
+    size_t accepted = AltSoftSerial::tryWrite(characters, sizeof(characters));
+    REQUIRE( accepted == ALTSS_TX_BUFFER_SIZE );
+    REQUIRE( serial.availableForWrite() == 0 );
+    REQUIRE( AltSoftSerial::tryWrite(characters, 1) == 0 );
+    REQUIRE( harness.micros() == 0 );
+
+    // 10 bits a character at 4800 baud
+    harness.run(accepted * 10 * 1000000.0 / 4800 + 1000);
+    std::vector<uint8_t> sent = harness.takeSent(4800);
+    REQUIRE( sent == std::vector<uint8_t>(characters, characters + accepted) );
+    REQUIRE( serial.availableForWrite() == ALTSS_TX_BUFFER_SIZE - 1 );
+}
+
+TEST_CASE( "AltSoftSerial write waits for room for the rest" ) {
+    AltSoftSerialHarness harness;
+    AltSoftSerial serial;
+    serial.begin(4800);
+    uint8_t characters[ALTSS_TX_BUFFER_SIZE * 2];
+    for (size_t i = 0; i < sizeof(characters); i++) {
+        characters[i] = i;
+    }
+    REQUIRE( serial.write(characters, sizeof(characters)) == sizeof(characters) );
+    // It returned once the last of them fit, so all but about a buffer's worth has gone out
+    REQUIRE( harness.micros() > (sizeof(characters) - ALTSS_TX_BUFFER_SIZE - 1) * 10 * 1000000.0 / 4800 );
+    harness.run(ALTSS_TX_BUFFER_SIZE * 10 * 1000000.0 / 4800 + 1000);
+    std::vector<uint8_t> sent = harness.takeSent(4800);
+    REQUIRE( sent == std::vector<uint8_t>(characters, characters + sizeof(characters)) );
+}
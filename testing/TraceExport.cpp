@@ -0,0 +1,97 @@
+//
+//  TraceExport.cpp
+//  Helm
+//
+//  Turns a $PHLM,TRACE dump into Chrome trace JSON, which chrome://tracing and ui.perfetto.dev open. The input can be a
+//  whole log of what the device sent, other lines are skipped. Build and run with
+//  `make trace-export TRACE_EXPORT_ARGS="dump.txt" > trace.json`.
+//
+
+#include "../Trace.h"
+#include "../RoutingTable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <cstring>
+
+// Longest line we expect in a log
+#define TRACE_EXPORT_LINE_LENGTH 256
+
+static uint32_t parseHex(const char *hex, int length) {
+    char digits[9];
+    memcpy(digits, hex, length);
+    digits[length] = '\0';
+    return strtoul(digits, NULL, 16);
+}
+
+static void printUsage() {
+    printf("Usage: traceexport DUMP\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        printUsage();
+        return 1;
+    }
+    FILE *file = fopen(argv[1], "r");
+    if (!file) {
+        fprintf(stderr, "Can't read %s\n", argv[1]);
+        return 1;
+    }
+
+    char line[TRACE_EXPORT_LINE_LENGTH];
+    uint32_t ticksPerMicro = 1;
+    bool hasFirstTimestamp = false;
+    uint32_t lastTimestamp = 0;
+    // Time since the first event, kept in 64 bits so the 32 bit counter can wrap
+    uint64_t ticks = 0;
+    // B/E events have to nest, drop ends whose begin was overwritten in the ring
+    int depth = 0;
+    int eventCount = 0;
+    printf("{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    while (fgets(line, sizeof(line), file)) {
+        const char *prefix = strstr(line, "$PHLM,TRACE,");
+        if (!prefix) {
+            continue;
+        }
+        const char *fields = prefix + strlen("$PHLM,TRACE,");
+        char *checksum = strchr((char *)fields, '*');
+        if (checksum) {
+            *checksum = '\0';
+        }
+        if (strncmp(fields, "BEGIN,", 6) == 0) {
+            const char *ticksField = strchr(fields + 6, ',');
+            ticksPerMicro = ticksField ? strtoul(ticksField + 1, NULL, 10) : 1;
+            ticksPerMicro = ticksPerMicro ? ticksPerMicro : 1;
+            continue;
+        }
+        if (strncmp(fields, "END", 3) == 0) {
+            continue;
+        }
+        for (const char *event = fields; strlen(event) >= 12; event += 12) {
+            uint32_t timestamp = parseHex(event, 8);
+            TraceEvent type = (TraceEvent)parseHex(&event[8], 2);
+            TracePhase phase = (TracePhase)parseHex(&event[10], 1);
+            int arg = parseHex(&event[11], 1);
+            if (hasFirstTimestamp) {
+                ticks += (uint32_t)(timestamp - lastTimestamp);
+            }
+            hasFirstTimestamp = true;
+            lastTimestamp = timestamp;
+            if (phase == TracePhaseEnd && depth == 0) {
+                continue;
+            }
+            depth += phase == TracePhaseBegin ? 1 : -1;
+            bool hasPort = type == TraceEventRead || type == TraceEventRoute || type == TraceEventWrite;
+            printf("%s{\"name\": \"%s\", \"ph\": \"%s\", \"ts\": %.3f, \"pid\": 1, \"tid\": 1", eventCount ? ",\n" : "", traceEventName(type), phase == TracePhaseBegin ? "B" : "E", (double)ticks / ticksPerMicro);
+            if (hasPort && arg < PortCount) {
+                printf(", \"args\": {\"port\": \"%s\"}", RoutingTable::portName((Port)arg));
+            }
+            printf("}");
+            eventCount++;
+        }
+    }
+    fclose(file);
+    printf("\n]}\n");
+    fprintf(stderr, "%d events\n", eventCount);
+    return 0;
+}
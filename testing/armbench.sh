@@ -0,0 +1,40 @@
+#!/bin/sh
+
+# Counts the instructions each benchmark in testing/ArmBench.cpp takes per op, running the Cortex-M4 build under
+# qemu-arm with its insn plugin. Usage: testing/armbench.sh armbench.elf [OPS]
+
+# Configure these for your system, or set them in the environment
+QEMU=${QEMU:-qemu-arm}
+# Built along with QEMU when it's configured with --enable-plugins, in build/tests/plugin or build/contrib/plugins
+QEMU_PLUGIN=${QEMU_PLUGIN:-/usr/local/lib/qemu/plugins/libinsn.so}
+# Cycles per instruction used for the estimate. The M4 retires most instructions in one cycle, but loads, taken
+# branches and flash wait states at 96MHz add up to roughly this on this kind of code.
+CPI=${CPI:-1.4}
+F_CPU_MHZ=${F_CPU_MHZ:-96}
+
+ELF=$1
+OPS=${2:-200}
+if [ -z "$ELF" ]; then
+    echo "Usage: $0 armbench.elf [OPS]"
+    exit 1
+fi
+if [ ! -f "$QEMU_PLUGIN" ]; then
+    echo "Can't find the QEMU insn plugin at $QEMU_PLUGIN, set QEMU_PLUGIN to its path"
+    exit 1
+fi
+
+instructions() {
+    $QEMU -cpu cortex-m4 -plugin "$QEMU_PLUGIN" -d plugin "$ELF" "$1" "$2" 2>&1 | sed -n 's/.*insns: *\([0-9]*\).*/\1/p' | tail -n 1
+}
+
+printf "%-36s %12s %12s %10s\n" "Benchmark" "insns/op" "cycles/op" "us/op"
+$QEMU -cpu cortex-m4 "$ELF" --list | while read -r NAME; do
+    BASE=$(instructions "$NAME" 0)
+    TOTAL=$(instructions "$NAME" "$OPS")
+    if [ -z "$BASE" ] || [ -z "$TOTAL" ]; then
+        echo "$NAME: no instruction count from $QEMU"
+        continue
+    fi
+    echo "$NAME $BASE $TOTAL" | awk -v ops="$OPS" -v cpi="$CPI" -v mhz="$F_CPU_MHZ" \
+        '{ insns = ($3 - $2) / ops; printf "%-36s %12.0f %12.0f %10.1f\n", $1, insns, insns * cpi, insns * cpi / mhz }'
+done